@@ -0,0 +1,150 @@
+// DNS response parsing cost per message. Parses every file in corpus_dir (one raw response per
+// file, e.g. fuzz/corpus/dns_message or responses saved from a capture) or, without one, a
+// built-in set: A with EDNS0, AAAA, a compressed CNAME chain, NXDOMAIN with SOA and a
+// truncated reply. The old rcode-only check is timed alongside for reference.
+//
+//   bench_dns_parse [corpus_dir] [rounds]
+#include <dirent.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "probes/dns_message.hpp"
+
+using namespace irr;
+
+namespace {
+using Bytes = std::vector<uint8_t>;
+
+double now_s() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void put16(Bytes& b, uint16_t v) {
+    b.push_back(static_cast<uint8_t>(v >> 8));
+    b.push_back(static_cast<uint8_t>(v & 0xff));
+}
+
+void put32(Bytes& b, uint32_t v) {
+    put16(b, static_cast<uint16_t>(v >> 16));
+    put16(b, static_cast<uint16_t>(v & 0xffff));
+}
+
+Bytes message(uint16_t flags, uint16_t an, uint16_t ns, uint16_t ar, uint16_t qtype) {
+    Bytes b;
+    for (uint16_t v : {uint16_t{0x1234}, flags, uint16_t{1}, an, ns, ar}) put16(b, v);
+    const char name[] = "\3www\7example\3com";
+    b.insert(b.end(), name, name + sizeof(name));
+    put16(b, qtype);
+    put16(b, 1);
+    return b;
+}
+
+void record(Bytes& b, size_t owner, uint16_t type, uint32_t ttl, const Bytes& rdata) {
+    put16(b, static_cast<uint16_t>(0xc000 | owner));
+    put16(b, type);
+    put16(b, 1);
+    put32(b, ttl);
+    put16(b, static_cast<uint16_t>(rdata.size()));
+    b.insert(b.end(), rdata.begin(), rdata.end());
+}
+
+void opt(Bytes& b) {
+    b.push_back(0);
+    for (uint16_t v : {uint16_t{41}, uint16_t{1232}, uint16_t{0}, uint16_t{0}, uint16_t{0}})
+        put16(b, v);
+}
+
+std::vector<Bytes> builtin_corpus() {
+    std::vector<Bytes> out;
+    Bytes a = message(0x8180, 2, 0, 1, 1);
+    record(a, 12, 1, 300, {93, 184, 216, 34});
+    record(a, 12, 1, 280, {93, 184, 216, 35});
+    opt(a);
+    out.push_back(a);
+
+    Bytes aaaa = message(0x8180, 1, 0, 1, 28);
+    record(aaaa, 12, 28, 60, Bytes(16, 0x20));
+    opt(aaaa);
+    out.push_back(aaaa);
+
+    Bytes cname = message(0x8180, 4, 0, 1, 1);
+    size_t target = cname.size() + 12;
+    record(cname, 12, 5, 600, {3, 'c', 'd', 'n', 0xc0, 16});
+    size_t edge = cname.size() + 12;
+    record(cname, target, 5, 600, {4, 'e', 'd', 'g', 'e', 0xc0, static_cast<uint8_t>(target)});
+    record(cname, edge, 1, 20, {192, 0, 2, 1});
+    record(cname, edge, 1, 20, {192, 0, 2, 2});
+    opt(cname);
+    out.push_back(cname);
+
+    Bytes nx = message(0x8183, 0, 1, 1, 1);
+    Bytes soa = {2, 'n', 's', 0xc0, 16, 4, 'h', 'o', 's', 't', 0xc0, 16};
+    for (uint32_t v : {2024010101u, 7200u, 900u, 1209600u, 300u}) put32(soa, v);
+    record(nx, 16, 6, 3600, soa);
+    opt(nx);
+    out.push_back(nx);
+
+    out.push_back(message(0x8380, 0, 0, 0, 1));  // TC, question only
+    return out;
+}
+
+std::vector<Bytes> load_corpus(const std::string& dir) {
+    std::vector<Bytes> out;
+    DIR* d = ::opendir(dir.c_str());
+    if (!d) return out;
+    while (dirent* e = ::readdir(d)) {
+        if (e->d_name[0] == '.') continue;
+        std::FILE* f = std::fopen((dir + "/" + e->d_name).c_str(), "rb");
+        if (!f) continue;
+        Bytes b(65535);
+        b.resize(std::fread(b.data(), 1, b.size(), f));
+        std::fclose(f);
+        if (!b.empty()) out.push_back(std::move(b));
+    }
+    ::closedir(d);
+    return out;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::vector<Bytes> corpus = argc > 1 ? load_corpus(argv[1]) : builtin_corpus();
+    size_t rounds = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200000;
+    if (corpus.empty()) {
+        std::fprintf(stderr, "no responses in %s\n", argv[1]);
+        return 1;
+    }
+    size_t bytes = 0;
+    for (const auto& m : corpus) bytes += m.size();
+    std::printf("%zu responses (%zu bytes), %zu rounds\n", corpus.size(), bytes, rounds);
+
+    uint64_t sink = 0;
+    double t0 = now_s();
+    for (size_t r = 0; r < rounds; ++r) {
+        for (const auto& m : corpus) sink += m.size() >= 4 ? (m[3] & 0x0f) : 0;
+    }
+    double rcode_s = now_s() - t0;
+
+    DnsMessage msg;
+    size_t parsed = 0;
+    t0 = now_s();
+    for (size_t r = 0; r < rounds; ++r) {
+        for (const auto& m : corpus) {
+            parsed += parse_dns_message(m.data(), m.size(), msg);
+            sink += msg.addr_count + static_cast<uint64_t>(msg.min_ttl + 1);
+        }
+    }
+    double parse_s = now_s() - t0;
+
+    double n = static_cast<double>(rounds * corpus.size());
+    std::printf("  rcode byte only:  %7.1f ns/message\n", rcode_s * 1e9 / n);
+    std::printf("  full parse:       %7.1f ns/message  %7.1f MB/s  (%zu of %zu parse)\n",
+                parse_s * 1e9 / n, static_cast<double>(bytes * rounds) / parse_s / 1e6,
+                parsed / rounds, corpus.size());
+    return sink == 0 ? 1 : 0;
+}
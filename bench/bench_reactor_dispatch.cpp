@@ -0,0 +1,137 @@
+// Reactor dispatch cost per ready event and per add_fd/del_fd pair, compared against the
+// previous design (unordered_map<int, std::function> looked up by data.fd, fixed 32-event
+// epoll_wait batch), which is reproduced here as LegacyReactor.
+//
+//   bench_reactor_dispatch [fds] [rounds]
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "core/reactor.hpp"
+
+using namespace irr;
+
+namespace {
+class LegacyReactor {
+   public:
+    LegacyReactor() : epoll_fd_(::epoll_create1(EPOLL_CLOEXEC)) {}
+    ~LegacyReactor() {
+        ::close(epoll_fd_);
+    }
+    bool add_fd(int fd, uint32_t events, const std::function<void(uint32_t)>& cb) {
+        struct epoll_event ev {};
+        ev.events = events;
+        ev.data.fd = fd;
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) return false;
+        handlers_[fd] = cb;
+        return true;
+    }
+    void del_fd(int fd) {
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        handlers_.erase(fd);
+    }
+    void loop_once(int timeout_ms) {
+        struct epoll_event evs[32];
+        int n = ::epoll_wait(epoll_fd_, evs, 32, timeout_ms);
+        if (n < 0) return;
+        for (int i = 0; i < n; ++i) {
+            auto it = handlers_.find(evs[i].data.fd);
+            if (it != handlers_.end()) it->second(evs[i].events);
+        }
+    }
+
+   private:
+    int epoll_fd_;
+    std::unordered_map<int, std::function<void(uint32_t)>> handlers_;
+};
+
+double now_s() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Every fd is an eventfd holding a non-zero count, so it stays readable (level-triggered)
+// and each loop_once() call returns a full batch.
+std::vector<int> make_ready_fds(size_t n) {
+    std::vector<int> fds;
+    for (size_t i = 0; i < n; ++i) {
+        int fd = ::eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (fd < 0) break;
+        fds.push_back(fd);
+    }
+    return fds;
+}
+
+// Mirrors the probes' handler shape: [this, fd] calling a member.
+struct Counter {
+    uint64_t hits{0};
+    uint64_t fd_sum{0};
+    void on(int fd, uint32_t) {
+        ++hits;
+        fd_sum += static_cast<uint64_t>(fd);
+    }
+};
+
+template <typename R>
+double dispatch_ns(R& r, const std::vector<int>& fds, size_t rounds, Counter& c) {
+    for (int fd : fds) r.add_fd(fd, EPOLLIN, [&c, fd](uint32_t ev) { c.on(fd, ev); });
+    uint64_t before = c.hits;
+    double t0 = now_s();
+    for (size_t i = 0; i < rounds; ++i) r.loop_once(0);
+    double dt = now_s() - t0;
+    uint64_t events = c.hits - before;
+    for (int fd : fds) r.del_fd(fd);
+    return events ? dt * 1e9 / static_cast<double>(events) : 0.0;
+}
+
+template <typename R>
+double churn_ns(R& r, int fd, size_t iterations, Counter& c) {
+    double t0 = now_s();
+    for (size_t i = 0; i < iterations; ++i) {
+        r.add_fd(fd, EPOLLIN, [&c, fd](uint32_t ev) { c.on(fd, ev); });
+        r.del_fd(fd);
+    }
+    return (now_s() - t0) * 1e9 / static_cast<double>(iterations);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    size_t nfds = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000;
+    size_t rounds = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20000;
+    auto fds = make_ready_fds(nfds);
+    if (fds.empty()) {
+        std::fprintf(stderr, "eventfd failed\n");
+        return 1;
+    }
+    Counter c;
+    std::printf("%zu ready fds, %zu loop_once rounds\n", fds.size(), rounds);
+    {
+        LegacyReactor r;
+        std::printf("  legacy map+std::function, batch 32:  %7.1f ns/event\n",
+                    dispatch_ns(r, fds, rounds, c));
+    }
+    for (int batch : {32, 128, 512}) {
+        Reactor r(batch);
+        std::printf("  slab+InlineFunction,       batch %-4d %7.1f ns/event\n", batch,
+                    dispatch_ns(r, fds, rounds, c));
+    }
+    {
+        LegacyReactor r;
+        std::printf("  legacy add_fd+del_fd:                %7.1f ns/pair\n",
+                    churn_ns(r, fds[0], 200000, c));
+    }
+    {
+        Reactor r;
+        std::printf("  slab add_fd+del_fd:                  %7.1f ns/pair\n",
+                    churn_ns(r, fds[0], 200000, c));
+    }
+    for (int fd : fds) ::close(fd);
+    return c.fd_sum == 0 ? 1 : 0;
+}
@@ -0,0 +1,176 @@
+// JSONL report loading throughput: the previous getline + per-key find/substr/stod parser,
+// reproduced here as legacy_parse, against JsonlFileReader + scan_event_line with each block
+// classifier the CPU supports, then aggregate_jsonl over the mapped file with 1, 2, 4, ...
+// threads up to the core count. Without a file argument a bundle of synthetic events is
+// written through JsonlStore first.
+//
+//   bench_report_scan [events.jsonl | event_count]
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include "core/event.hpp"
+#include "core/store_jsonl.hpp"
+#include "core/symbols.hpp"
+#include "report/jsonl_scan.hpp"
+#include "report/report_gen.hpp"
+
+using namespace irr;
+
+namespace {
+double now_s() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+bool legacy_string(const std::string& line, const std::string& key, std::string& out) {
+    auto pos = line.find("\"" + key + "\":\"");
+    if (pos == std::string::npos) return false;
+    size_t start = pos + key.size() + 4;
+    size_t end = line.find('"', start);
+    if (end == std::string::npos) return false;
+    out = line.substr(start, end - start);
+    return true;
+}
+
+bool legacy_double(const std::string& line, const std::string& key, double& out) {
+    auto pos = line.find("\"" + key + "\":");
+    if (pos == std::string::npos) return false;
+    pos += key.size() + 3;
+    size_t end = pos;
+    while (end < line.size() && ((line[end] >= '0' && line[end] <= '9') || line[end] == '.' ||
+                                 line[end] == '-'))
+        ++end;
+    try {
+        out = std::stod(line.substr(pos, end - pos));
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+// The old parse_event_line: one find per key plus substr copies.
+bool legacy_parse(const std::string& line, std::string& type, std::string& name, bool& ok,
+                  double& metric) {
+    if (!legacy_string(line, "type", type)) return false;
+    ok = line.find("\"ok\":true") != std::string::npos;
+    bool has_metric = legacy_double(line, "metric_ms", metric);
+    auto pos = line.find("\"target\":{");
+    if (pos != std::string::npos) {
+        auto end = line.find('}', pos);
+        if (end != std::string::npos)
+            legacy_string(line.substr(pos, end - pos + 1), "name", name);
+    }
+    return has_metric;
+}
+
+void write_synthetic(const std::string& path, size_t count) {
+    ::unlink(path.c_str());
+    CommitPolicy policy;
+    policy.max_events = 4096;
+    JsonlStore store(path, policy);
+    const char* names[] = {"cloudflare", "google", "quad9", "root-dns"};
+    const char* types_ip[] = {"1.1.1.1", "8.8.8.8", "9.9.9.9", "192.0.2.53"};
+    Event ev;
+    ev.run_id = symbols().intern("8b5b2c1e-5a36-4d7f-9a3e-0c1f2d3e4f50");
+    ev.target_family = symbols().intern("inet");
+    for (size_t i = 0; i < count; ++i) {
+        ev.ts_monotonic_ns = 1000000000ULL + i * 250000000ULL;
+        ev.ts_wall_ns = 1700000000000000000ULL + i * 250000000ULL;
+        ev.type = i % 4 == 3 ? EventType::DnsResult : EventType::TcpConnect;
+        ev.target_name = symbols().intern(names[i % 4]);
+        ev.target_ip = symbols().intern(types_ip[i % 4]);
+        ev.interval_ms = 1000;
+        ev.timeout_ms = 2000;
+        ev.ok = i % 50 != 0;
+        ev.metric_ms = ev.ok ? 8.0 + static_cast<double>(i % 997) * 0.131 : 2000.0;
+        ev.error = ev.ok ? ErrorCode::None : ErrorCode::Timeout;
+        store.on_event(ev);
+    }
+}
+
+double file_size(const std::string& path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    return static_cast<double>(in.tellg());
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string path = "/tmp/irr_bench_report_scan.jsonl";
+    bool synthetic = true;
+    size_t count = 2000000;
+    if (argc > 1) {
+        char* end = nullptr;
+        unsigned long n = std::strtoul(argv[1], &end, 10);
+        if (end && *end == '\0' && n > 0) {
+            count = n;
+        } else {
+            path = argv[1];
+            synthetic = false;
+        }
+    }
+    if (synthetic) write_synthetic(path, count);
+    double bytes = file_size(path);
+    std::printf("%s: %.1f MB\n", path.c_str(), bytes / 1e6);
+
+    double sum = 0;
+    size_t lines = 0;
+    {
+        std::ifstream in(path);
+        std::string line, type, name;
+        bool ok = false;
+        double metric = 0;
+        double t0 = now_s();
+        while (std::getline(in, line)) {
+            if (!legacy_parse(line, type, name, ok, metric)) continue;
+            sum += metric;
+            ++lines;
+        }
+        double dt = now_s() - t0;
+        std::printf("  legacy getline+find:  %6.2f GB/s  %6.1f ns/line  (%zu lines)\n",
+                    bytes / dt / 1e9, dt * 1e9 / static_cast<double>(lines), lines);
+    }
+    const char* isa_names[] = {"scalar", "sse2", "avx2"};
+    for (auto isa : {JsonlScanIsa::Scalar, JsonlScanIsa::Sse2, JsonlScanIsa::Avx2}) {
+        if (!set_jsonl_scan_isa(isa)) continue;
+        JsonlFileReader in;
+        if (!in.open(path)) return 1;
+        std::string_view line;
+        std::string scratch;
+        JsonlFields f;
+        lines = 0;
+        double t0 = now_s();
+        while (in.next(line)) {
+            if (!scan_event_line(line, f, scratch)) continue;
+            sum += f.metric_ms + static_cast<double>(f.target_name.size());
+            ++lines;
+        }
+        double dt = now_s() - t0;
+        std::printf("  scanner %-6s         %6.2f GB/s  %6.1f ns/line  (%zu lines)\n",
+                    isa_names[static_cast<int>(isa)], bytes / dt / 1e9,
+                    dt * 1e9 / static_cast<double>(lines), lines);
+    }
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    double serial_dt = 0;
+    for (unsigned threads = 1;; threads = std::min(threads * 2, cores)) {
+        ReportOptions opts;
+        opts.threads = threads;
+        ReportStats stats;
+        double t0 = now_s();
+        if (!aggregate_jsonl(path, opts, stats)) return 1;
+        double dt = now_s() - t0;
+        if (threads == 1) serial_dt = dt;
+        sum += static_cast<double>(stats.total);
+        std::printf("  aggregate %2u threads  %6.2f GB/s  %5.2fx  (%zu events)\n", threads,
+                    bytes / dt / 1e9, serial_dt / dt, stats.total);
+        if (threads == cores) break;
+    }
+    if (synthetic) ::unlink(path.c_str());
+    return sum == 0 ? 1 : 0;
+}
@@ -0,0 +1,23 @@
+// libFuzzer entry point for the DNS response parser. Any input must be rejected or parsed
+// without reading outside [data, data + size); build with -DIRR_BUILD_FUZZ=ON and run under
+// ASan/UBSan, e.g.
+//
+//   fuzz_dns_message -max_len=1500 fuzz/corpus/dns_message
+#include <cstddef>
+#include <cstdint>
+
+#include "probes/dns_message.hpp"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    irr::DnsMessage msg;
+    if (irr::parse_dns_message(data, size, msg)) {
+        // Whatever parsed must be self-consistent.
+        if (msg.question_off + msg.question_len > size) __builtin_trap();
+        if (msg.min_ttl < -1 || msg.min_ttl > 0x7fffffff) __builtin_trap();
+    }
+    for (size_t off = 0; off < size && off < 64; ++off) {
+        size_t end = irr::dns_skip_name(data, size, off);
+        if (end != 0 && (end <= off || end > size)) __builtin_trap();
+    }
+    return 0;
+}
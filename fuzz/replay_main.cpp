@@ -0,0 +1,53 @@
+// Stand-in for libFuzzer's driver on toolchains without -fsanitize=fuzzer: feeds every file
+// named on the command line (directories are walked one level deep) to the fuzz target once,
+// which is enough to replay a corpus or a crash under the sanitizers.
+//
+//   fuzz_dns_message <file|dir>...
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+namespace {
+bool run_file(const std::string& path) {
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    std::vector<uint8_t> buf;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), f)) > 0)
+        buf.insert(buf.end(), chunk, chunk + n);
+    std::fclose(f);
+    LLVMFuzzerTestOneInput(buf.data(), buf.size());
+    return true;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    size_t runs = 0;
+    for (int i = 1; i < argc; ++i) {
+        struct stat st {};
+        if (::stat(argv[i], &st) != 0) {
+            std::fprintf(stderr, "%s: not found\n", argv[i]);
+            return 1;
+        }
+        if (!S_ISDIR(st.st_mode)) {
+            runs += run_file(argv[i]);
+            continue;
+        }
+        DIR* d = ::opendir(argv[i]);
+        if (!d) continue;
+        while (dirent* e = ::readdir(d)) {
+            if (e->d_name[0] == '.') continue;
+            runs += run_file(std::string(argv[i]) + "/" + e->d_name);
+        }
+        ::closedir(d);
+    }
+    std::printf("replayed %zu inputs\n", runs);
+    return 0;
+}
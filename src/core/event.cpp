@@ -0,0 +1,102 @@
+#include "event.hpp"
+
+#include <arpa/inet.h>
+
+#include <cstdio>
+#include <cstring>
+
+namespace irr {
+namespace {
+size_t clamp_len(int n, size_t cap) {
+    if (n < 0 || cap == 0) return 0;
+    return static_cast<size_t>(n) < cap ? static_cast<size_t>(n) : cap - 1;
+}
+}  // namespace
+
+const char* event_type_name(EventType type) {
+    switch (type) {
+        case EventType::TcpConnect:
+            return "probe.tcp.connect";
+        case EventType::DnsResult:
+            return "probe.dns.result";
+        case EventType::DnsTimeout:
+            return "probe.dns.timeout";
+        case EventType::IcmpRtt:
+            return "probe.icmp.rtt";
+        case EventType::IcmpTimeout:
+            return "probe.icmp.timeout";
+        case EventType::PmtuResult:
+            return "probe.pmtu.result";
+        case EventType::LinkChange:
+            return "sys.netlink.link_change";
+        case EventType::RouteChange:
+            return "sys.netlink.route_change";
+        case EventType::ResolveResult:
+            return "probe.resolve";
+        case EventType::TcpFirstSuccess:
+            return "probe.tcp.first_success";
+        case EventType::DnsFirstAnswer:
+            return "probe.dns.first_answer";
+    }
+    return "unknown";
+}
+
+size_t format_error_category(const Event& ev, char* buf, size_t cap) {
+    const char* name = "";
+    switch (ev.error) {
+        case ErrorCode::None:
+            break;
+        case ErrorCode::DnsFailure:
+            name = "dns_failure";
+            break;
+        case ErrorCode::ConnectImmediateFail:
+            name = "connect_immediate_fail";
+            break;
+        case ErrorCode::SoError:
+            return clamp_len(std::snprintf(buf, cap, "so_error_%d", ev.error_detail), cap);
+        case ErrorCode::DnsRcode:
+            return clamp_len(std::snprintf(buf, cap, "dns_rcode_rcode_%d", ev.error_detail), cap);
+        case ErrorCode::SendFail:
+            name = "send_fail";
+            break;
+        case ErrorCode::Timeout:
+            name = "timeout";
+            break;
+        case ErrorCode::TcpFallbackSuccess:
+            name = "tcp_fallback_success";
+            break;
+        case ErrorCode::LinkUp:
+            name = "link_up";
+            break;
+        case ErrorCode::LinkDown:
+            name = "link_down";
+            break;
+        case ErrorCode::RouteAdd:
+            name = "route_add";
+            break;
+        case ErrorCode::RouteDel:
+            name = "route_del";
+            break;
+        case ErrorCode::Emsgsize:
+            name = "emsgsize";
+            break;
+        case ErrorCode::ConfidenceHigh:
+            name = "confidence_high";
+            break;
+        case ErrorCode::ConfidenceMedium:
+            name = "confidence_medium";
+            break;
+        case ErrorCode::ConfidenceLow:
+            name = "confidence_low";
+            break;
+    }
+    return clamp_len(std::snprintf(buf, cap, "%s", name), cap);
+}
+
+size_t format_answer_ip(const Event& ev, char* buf, size_t cap) {
+    if (ev.answer_family == 0 || cap == 0) return 0;
+    if (!::inet_ntop(ev.answer_family, ev.answer_addr, buf, static_cast<socklen_t>(cap)))
+        return 0;
+    return std::strlen(buf);
+}
+}  // namespace irr
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "symbols.hpp"
+
+namespace irr {
+enum class EventType : uint8_t {
+    TcpConnect,
+    DnsResult,
+    DnsTimeout,
+    IcmpRtt,
+    IcmpTimeout,
+    PmtuResult,
+    LinkChange,
+    RouteChange,
+    ResolveResult,
+    TcpFirstSuccess,
+    DnsFirstAnswer,
+};
+
+// Error categories; some carry a numeric detail (errno, rcode) in Event::error_detail.
+enum class ErrorCode : uint8_t {
+    None,
+    DnsFailure,
+    ConnectImmediateFail,
+    SoError,
+    DnsRcode,
+    SendFail,
+    Timeout,
+    TcpFallbackSuccess,
+    LinkUp,
+    LinkDown,
+    RouteAdd,
+    RouteDel,
+    Emsgsize,
+    ConfidenceHigh,
+    ConfidenceMedium,
+    ConfidenceLow,
+};
+
+// Compact, trivially-copyable probe record. Strings are interned through symbols() so
+// emitting an event never touches the heap.
+struct Event {
+    SymbolId run_id{};
+    uint64_t ts_monotonic_ns{};
+    uint64_t ts_wall_ns{};
+    EventType type{};
+    SymbolId target_name{};
+    SymbolId target_ip{};
+    SymbolId target_family{};
+    int interval_ms{};
+    int timeout_ms{};
+    bool ok{};
+    double metric_ms{};
+    // RTT from kernel timestamps (--kernel-timestamps), free of reactor dispatch delay; < 0
+    // when not measured.
+    double kernel_ms{-1.0};
+    ErrorCode error{};
+    int32_t error_detail{};
+    // DNS replies: A/AAAA records in the answer, their lowest TTL (or the negative-caching TTL
+    // of an NXDOMAIN/NODATA; -1 if none) and the first address. The address is kept inline
+    // rather than interned: rotating CDN answers would grow the symbol table without bound.
+    uint16_t answer_count{};
+    int32_t min_ttl{-1};
+    uint8_t answer_family{};  // AF_INET, AF_INET6, or 0 without an address
+    uint8_t answer_addr[16]{};
+};
+static_assert(std::is_trivially_copyable<Event>::value, "Event must stay trivially copyable");
+
+// Wire name used in events.jsonl, e.g. "probe.tcp.connect".
+const char* event_type_name(EventType type);
+// Renders the error_category string ("", "timeout", "so_error_111", ...) into buf and returns
+// its length (truncated to cap - 1).
+size_t format_error_category(const Event& ev, char* buf, size_t cap);
+// Renders answer_addr as text into buf (cap >= INET6_ADDRSTRLEN) and returns its length; 0
+// without an address.
+size_t format_answer_ip(const Event& ev, char* buf, size_t cap);
+}  // namespace irr
@@ -1 +1,35 @@
 #include "event_bus.hpp"
+
+#include "sink_worker.hpp"
+
+namespace irr {
+EventBus::EventBus() = default;
+
+EventBus::~EventBus() {
+    stop_async();
+}
+
+bool EventBus::start_async(const AsyncBusOptions& opts) {
+    if (ring_) return true;
+    auto ring = std::make_unique<EventRing>(opts.capacity, opts.overflow);
+    auto worker = std::make_unique<SinkWorker>(std::vector<EventRing*>{ring.get()}, sinks_);
+    if (!worker->start()) return false;
+    worker_ = std::move(worker);
+    owned_ring_ = std::move(ring);
+    ring_ = owned_ring_.get();
+    return true;
+}
+
+void EventBus::stop_async() {
+    if (!worker_) return;
+    worker_->stop();
+    worker_.reset();
+    last_stats_ = ring_->stats();
+    ring_ = nullptr;
+    owned_ring_.reset();
+}
+
+RingStats EventBus::stats() const {
+    return ring_ ? ring_->stats() : last_stats_;
+}
+}  // namespace irr
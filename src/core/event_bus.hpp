@@ -1,41 +1,89 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "event.hpp"
+#include "event_ring.hpp"
+
 namespace irr {
-struct Event {
-    std::string run_id;
-    uint64_t ts_monotonic_ns{};
-    std::string ts_wall;
-    std::string type;
-    std::string target_name;
-    std::string target_ip;
-    std::string target_family;
-    int interval_ms{};
-    int timeout_ms{};
-    bool ok{};
-    double metric_ms{};
-    std::string error_category;
+class SinkWorker;
+
+// Read-only view over a contiguous run of events (std::span is C++20).
+struct EventSpan {
+    const Event* data{nullptr};
+    size_t size{0};
+    const Event* begin() const {
+        return data;
+    }
+    const Event* end() const {
+        return data + size;
+    }
 };
 
 class EventSink {
    public:
     virtual ~EventSink() = default;
     virtual void on_event(const Event& ev) = 0;
+    // Batch entry point used by the async drain; sinks that can amortise I/O override it.
+    virtual void on_events(EventSpan events) {
+        for (const auto& ev : events) on_event(ev);
+    }
+    // Called periodically while no events arrive so time-based commit policies can fire.
+    virtual void on_idle() {}
+};
+
+struct AsyncBusOptions {
+    size_t capacity{8192};
+    // A full ring stalls the probe thread rather than lose a measurement; dropping is opt-in.
+    OverflowPolicy overflow{OverflowPolicy::Block};
 };
 
 class EventBus {
    public:
+    EventBus();
+    ~EventBus();
     void add_sink(EventSink* sink) {
         sinks_.push_back(sink);
     }
+    // Switches to asynchronous delivery: emit() pushes into a bounded lock-free ring and a
+    // dedicated thread drains it into the sinks. Add all sinks before calling.
+    bool start_async(const AsyncBusOptions& opts);
+    // Flushes the ring and joins the sink thread; later emits are delivered synchronously.
+    void stop_async();
+    // Shard mode: emit() pushes into a ring that the caller owns and drains (one SinkWorker
+    // serving every shard), so shards never contend on a shared queue or lock.
+    void attach_ring(EventRing* ring) {
+        ring_ = ring;
+    }
+    bool is_async() const {
+        return ring_ != nullptr;
+    }
+    // Queue depth and drop counters; the final values are kept after stop_async().
+    RingStats stats() const;
+
+    // Lets sinks run time-based work in synchronous mode; the sink thread does it when async.
+    void idle() {
+        if (ring_) return;
+        for (auto* s : sinks_) s->on_idle();
+    }
+
     void emit(const Event& ev) {
+        if (ring_) {
+            ring_->push(ev);
+            return;
+        }
         for (auto* s : sinks_) s->on_event(ev);
     }
 
    private:
     std::vector<EventSink*> sinks_;
+    EventRing* ring_{nullptr};
+    std::unique_ptr<EventRing> owned_ring_;
+    std::unique_ptr<SinkWorker> worker_;
+    RingStats last_stats_;
 };
 }  // namespace irr
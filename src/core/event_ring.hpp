@@ -0,0 +1,198 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "event.hpp"
+
+namespace irr {
+// What a producer does when the ring is full.
+enum class OverflowPolicy { Block, DropOldest, DropNewest };
+
+inline bool parse_overflow_policy(const std::string& s, OverflowPolicy& out) {
+    if (s == "block")
+        out = OverflowPolicy::Block;
+    else if (s == "drop-oldest")
+        out = OverflowPolicy::DropOldest;
+    else if (s == "drop-newest")
+        out = OverflowPolicy::DropNewest;
+    else
+        return false;
+    return true;
+}
+
+// Wakes a consumer thread sleeping on empty rings. Producers only take the mutex when the
+// consumer has announced that it is about to sleep.
+class Doorbell {
+   public:
+    void ring() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!sleeping_.load(std::memory_order_seq_cst)) return;
+        std::lock_guard<std::mutex> lock(mu_);
+        cv_.notify_one();
+    }
+    template <typename Pred>
+    void wait(Pred has_work, int timeout_ms) {
+        std::unique_lock<std::mutex> lock(mu_);
+        sleeping_.store(true, std::memory_order_seq_cst);
+        if (!has_work()) cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms));
+        sleeping_.store(false, std::memory_order_relaxed);
+    }
+    void wake_all() {
+        std::lock_guard<std::mutex> lock(mu_);
+        cv_.notify_all();
+    }
+
+   private:
+    std::atomic<bool> sleeping_{false};
+    std::mutex mu_;
+    std::condition_variable cv_;
+};
+
+struct RingStats {
+    size_t capacity{0};
+    size_t depth{0};
+    size_t max_depth{0};
+    uint64_t pushed{0};
+    uint64_t dropped{0};
+};
+
+// Bounded lock-free MPMC queue of Events (Vyukov's sequence-numbered cells). Probes push from
+// reactor threads; a SinkWorker pops. Multi-consumer safety is what lets DropOldest evict the
+// head from the producer side.
+class EventRing {
+   public:
+    explicit EventRing(size_t capacity, OverflowPolicy policy = OverflowPolicy::Block)
+        : policy_(policy) {
+        size_t cap = 2;
+        while (cap < capacity) cap <<= 1;
+        mask_ = cap - 1;
+        cells_.reset(new Cell[cap]);
+        for (size_t i = 0; i < cap; ++i) cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+    EventRing(const EventRing&) = delete;
+    EventRing& operator=(const EventRing&) = delete;
+
+    void set_doorbell(Doorbell* bell) {
+        bell_ = bell;
+    }
+
+    // Applies the overflow policy; returns false if the event was dropped.
+    bool push(const Event& ev) {
+        while (!try_push(ev)) {
+            switch (policy_) {
+                case OverflowPolicy::DropNewest:
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                case OverflowPolicy::DropOldest: {
+                    Event victim;
+                    if (try_pop(victim)) dropped_.fetch_add(1, std::memory_order_relaxed);
+                    break;
+                }
+                case OverflowPolicy::Block:
+                    if (bell_) bell_->ring();
+                    std::this_thread::yield();
+                    break;
+            }
+        }
+        pushed_.fetch_add(1, std::memory_order_relaxed);
+        size_t d = depth();
+        if (d > max_depth_.load(std::memory_order_relaxed))
+            max_depth_.store(d, std::memory_order_relaxed);
+        if (bell_) bell_->ring();
+        return true;
+    }
+
+    bool try_push(const Event& ev) {
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            auto dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (dif == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->ev = ev;
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(Event& out) {
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            auto dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (dif == 0) {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        out = cell->ev;
+        cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t pop_batch(Event* out, size_t max) {
+        size_t n = 0;
+        while (n < max && try_pop(out[n])) ++n;
+        return n;
+    }
+
+    size_t depth() const {
+        size_t tail = enqueue_pos_.load(std::memory_order_relaxed);
+        size_t head = dequeue_pos_.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+    bool empty() const {
+        return depth() == 0;
+    }
+    size_t capacity() const {
+        return mask_ + 1;
+    }
+
+    RingStats stats() const {
+        RingStats s;
+        s.capacity = capacity();
+        s.depth = depth();
+        s.max_depth = max_depth_.load(std::memory_order_relaxed);
+        s.pushed = pushed_.load(std::memory_order_relaxed);
+        s.dropped = dropped_.load(std::memory_order_relaxed);
+        return s;
+    }
+
+   private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        Event ev;
+    };
+
+    OverflowPolicy policy_;
+    size_t mask_{0};
+    std::unique_ptr<Cell[]> cells_;
+    Doorbell* bell_{nullptr};
+    alignas(64) std::atomic<size_t> enqueue_pos_{0};
+    alignas(64) std::atomic<size_t> dequeue_pos_{0};
+    alignas(64) std::atomic<size_t> max_depth_{0};
+    std::atomic<uint64_t> pushed_{0};
+    std::atomic<uint64_t> dropped_{0};
+};
+}  // namespace irr
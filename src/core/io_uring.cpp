@@ -0,0 +1,128 @@
+#include "io_uring.hpp"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+namespace irr {
+namespace {
+int sys_setup(unsigned entries, io_uring_params* p) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+int sys_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void* arg,
+              size_t argsz) {
+    return static_cast<int>(
+        ::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz));
+}
+}  // namespace
+
+IoUring::~IoUring() {
+    if (sqes_) ::munmap(sqes_, sqes_size_);
+    if (ring_ptr_) ::munmap(ring_ptr_, ring_size_);
+    if (ring_fd_ >= 0) ::close(ring_fd_);
+}
+
+bool IoUring::init(unsigned entries) {
+    io_uring_params p{};
+    int fd = sys_setup(entries, &p);
+    if (fd < 0) return false;
+    ring_fd_ = fd;
+    const unsigned needed = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+    if ((p.features & needed) != needed) return false;
+
+    size_t sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    ring_size_ = sq_size > cq_size ? sq_size : cq_size;
+    void* ring = ::mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        fd, IORING_OFF_SQ_RING);
+    if (ring == MAP_FAILED) return false;
+    ring_ptr_ = ring;
+    sqes_size_ = p.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) return false;
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    auto* base = static_cast<uint8_t*>(ring);
+    sq_head_ = reinterpret_cast<unsigned*>(base + p.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(base + p.sq_off.tail);
+    sq_array_ = reinterpret_cast<unsigned*>(base + p.sq_off.array);
+    sq_mask_ = *reinterpret_cast<unsigned*>(base + p.sq_off.ring_mask);
+    sq_entries_ = p.sq_entries;
+    sq_local_tail_ = *sq_tail_;
+    cq_head_ = reinterpret_cast<unsigned*>(base + p.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(base + p.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(base + p.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(base + p.cq_off.cqes);
+    return true;
+}
+
+io_uring_sqe* IoUring::get_sqe() {
+    unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (sq_local_tail_ - head >= sq_entries_) {
+        if (!enter(false, 0)) return nullptr;
+        head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        if (sq_local_tail_ - head >= sq_entries_) return nullptr;
+    }
+    unsigned idx = sq_local_tail_ & sq_mask_;
+    io_uring_sqe* sqe = &sqes_[idx];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[idx] = idx;
+    ++sq_local_tail_;
+    ++to_submit_;
+    // Publish the new tail now; the kernel only consumes entries when we call enter().
+    __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+    return sqe;
+}
+
+bool IoUring::enter(bool wait, int timeout_ms) {
+    unsigned flags = 0;
+    unsigned min_complete = 0;
+    io_uring_getevents_arg arg{};
+    __kernel_timespec ts{};
+    if (wait && !has_completions()) {
+        flags |= IORING_ENTER_GETEVENTS;
+        min_complete = 1;
+        if (timeout_ms >= 0) {
+            ts.tv_sec = timeout_ms / 1000;
+            ts.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000;
+            arg.ts = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(&ts));
+            flags |= IORING_ENTER_EXT_ARG;
+        }
+    }
+    if (to_submit_ == 0 && min_complete == 0) return true;
+    void* argp = (flags & IORING_ENTER_EXT_ARG) ? &arg : nullptr;
+    size_t argsz = argp ? sizeof(arg) : 0;
+    ++enters_;
+    int rc = sys_enter(ring_fd_, to_submit_, min_complete, flags, argp, argsz);
+    if (rc < 0) {
+        if (errno == ETIME || errno == EINTR || errno == EBUSY) return true;
+        return false;
+    }
+    auto done = static_cast<unsigned>(rc);
+    to_submit_ = done >= to_submit_ ? 0 : to_submit_ - done;
+    return true;
+}
+
+bool IoUring::has_completions() const {
+    return __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE) != *cq_head_;
+}
+
+size_t IoUring::reap(UringCompletion* out, size_t cap) {
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    size_t n = 0;
+    while (head != tail && n < cap) {
+        const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+        out[n++] = {cqe.user_data, cqe.res};
+        ++head;
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    return n;
+}
+}  // namespace irr
@@ -0,0 +1,67 @@
+#pragma once
+#include <linux/io_uring.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace irr {
+struct UringCompletion {
+    uint64_t user_data;
+    int32_t res;
+};
+
+// Minimal io_uring wrapper over the raw syscalls (no liburing dependency). One submission
+// ring, one completion ring; callers fill SQEs from get_sqe() and everything queued goes to
+// the kernel in the next enter().
+class IoUring {
+   public:
+    IoUring() = default;
+    ~IoUring();
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // False when the kernel has no io_uring (or it is blocked) or lacks the features the
+    // reactor relies on (single mmap, no-drop completions, timeout via enter's ext arg).
+    bool init(unsigned entries);
+    int fd() const {
+        return ring_fd_;
+    }
+
+    // Next free SQE, zeroed; when the ring is full the queued entries are submitted first.
+    // Returns nullptr only if that submission fails.
+    io_uring_sqe* get_sqe();
+    // Submits queued SQEs and, when wait is set, blocks until at least one completion is
+    // available or timeout_ms passes (-1 waits forever). Returns false on error other than
+    // timeout/interrupt.
+    bool enter(bool wait, int timeout_ms);
+    // Copies up to cap completions into out and releases them; returns the number copied.
+    size_t reap(UringCompletion* out, size_t cap);
+    bool has_completions() const;
+
+    uint64_t enters() const {
+        return enters_;
+    }
+
+   private:
+    int ring_fd_{-1};
+    void* ring_ptr_{nullptr};
+    size_t ring_size_{0};
+    io_uring_sqe* sqes_{nullptr};
+    size_t sqes_size_{0};
+
+    unsigned* sq_head_{nullptr};
+    unsigned* sq_tail_{nullptr};
+    unsigned* sq_array_{nullptr};
+    unsigned sq_mask_{0};
+    unsigned sq_entries_{0};
+    unsigned sq_local_tail_{0};
+    unsigned to_submit_{0};
+
+    unsigned* cq_head_{nullptr};
+    unsigned* cq_tail_{nullptr};
+    unsigned cq_mask_{0};
+    io_uring_cqe* cqes_{nullptr};
+
+    uint64_t enters_{0};
+};
+}  // namespace irr
@@ -0,0 +1,48 @@
+#include "latency_sink.hpp"
+
+#include <algorithm>
+
+namespace irr {
+namespace {
+bool is_latency(const Event& ev) {
+    switch (ev.type) {
+        case EventType::TcpConnect:
+        case EventType::DnsResult:
+        case EventType::IcmpRtt:
+            return ev.ok;
+        default:
+            return false;
+    }
+}
+}  // namespace
+
+void LatencySink::add(const Event& ev) {
+    if (!is_latency(ev)) return;
+    auto it = per_target_.find(ev.target_name);
+    if (it == per_target_.end())
+        it = per_target_.emplace(ev.target_name, QuantileSketch(relative_error_)).first;
+    it->second.add(ev.metric_ms);
+}
+
+void LatencySink::on_event(const Event& ev) {
+    std::lock_guard<std::mutex> lock(mu_);
+    add(ev);
+}
+
+void LatencySink::on_events(EventSpan events) {
+    std::lock_guard<std::mutex> lock(mu_);
+    for (const auto& ev : events) add(ev);
+}
+
+std::vector<std::pair<std::string, QuantileSketch>> LatencySink::snapshot() const {
+    std::vector<std::pair<std::string, QuantileSketch>> out;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        out.reserve(per_target_.size());
+        for (const auto& kv : per_target_) out.emplace_back(symbols().name(kv.first), kv.second);
+    }
+    std::sort(out.begin(), out.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+    return out;
+}
+}  // namespace irr
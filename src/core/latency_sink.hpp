@@ -0,0 +1,32 @@
+#pragma once
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../util/quantile_sketch.hpp"
+#include "event_bus.hpp"
+#include "symbols.hpp"
+
+namespace irr {
+// Live per-target latency quantiles for the running capture. Successful probe results are
+// added to one QuantileSketch per target, so memory stays bounded however long the run is,
+// and the sketches merge with the report's.
+class LatencySink : public EventSink {
+   public:
+    explicit LatencySink(double relative_error = QuantileSketch::kDefaultRelativeError)
+        : relative_error_(relative_error) {}
+    void on_event(const Event& ev) override;
+    void on_events(EventSpan events) override;
+    // Copy of the current sketches sorted by target name; safe from any thread.
+    std::vector<std::pair<std::string, QuantileSketch>> snapshot() const;
+
+   private:
+    double relative_error_;
+    mutable std::mutex mu_;
+    std::unordered_map<SymbolId, QuantileSketch> per_target_;
+
+    void add(const Event& ev);
+};
+}  // namespace irr
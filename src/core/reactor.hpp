@@ -1,27 +1,102 @@
 #pragma once
+#include <sys/epoll.h>
+
 #include <cstdint>
-#include <functional>
-#include <unordered_map>
+#include <deque>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "../util/inline_function.hpp"
 #include "fd.hpp"
+#include "timer_wheel.hpp"
 
 namespace irr {
-using FdHandler = std::function<void(uint32_t)>;
+// Non-allocating; captures are limited to 32 bytes (e.g. `this` plus an fd).
+using FdHandler = InlineFunction<void(uint32_t), 32>;
+
+class IoUring;
+struct UringCompletion;
+
+// Readiness backend. IoUring registers interest with batched one-shot POLL_ADD submissions
+// (re-armed after each dispatch, so it behaves like level-triggered epoll) and waits with a
+// single io_uring_enter per loop; add_fd/del_fd cost no syscall of their own.
+enum class ReactorBackend { Epoll, IoUring };
+bool parse_reactor_backend(const std::string& s, ReactorBackend& out);
+const char* reactor_backend_name(ReactorBackend b);
 
 class Reactor {
    public:
-    Reactor();
+    static constexpr int kDefaultBatch = 32;
+
+    // max_events is the epoll_wait (or completion reap) batch size. Asking for IoUring on a
+    // kernel without it logs a warning and falls back to epoll.
+    explicit Reactor(int max_events = kDefaultBatch,
+                     ReactorBackend backend = ReactorBackend::Epoll);
     ~Reactor();
-    bool add_fd(int fd, uint32_t events, const FdHandler& cb);
+    bool add_fd(int fd, uint32_t events, FdHandler cb);
     bool mod_fd(int fd, uint32_t events);
     void del_fd(int fd);
     void loop_once(int timeout_ms);
-    int fd() const {
-        return epoll_fd_;
+    ReactorBackend backend() const {
+        return uring_ ? ReactorBackend::IoUring : ReactorBackend::Epoll;
+    }
+    // Syscalls issued by the reactor itself (epoll_ctl/epoll_wait or io_uring_enter, plus its
+    // timerfd); used by the backend benchmark.
+    uint64_t syscalls() const;
+
+    // One-shot timer on the shared wheel; fires from loop_once() at deadline_ns
+    // (CLOCK_MONOTONIC, see monotonic_ns()) with 1 ms resolution.
+    TimerId add_timer(uint64_t deadline_ns, TimerCallback cb);
+    bool cancel_timer(TimerId id);
+    size_t pending_timers() const {
+        return timers_.size();
+    }
+    // Runs cb once at the end of the current loop_once(), after every handler and timer in
+    // the batch; lets a probe coalesce work queued by several callbacks (e.g. one sendmmsg
+    // for all queries fired in the same tick). Outside the loop it runs on the next
+    // loop_once(), which then does not block.
+    void post(TimerCallback cb) {
+        posted_.push_back(std::move(cb));
     }
 
    private:
+    // Handler slab indexed by fd. The generation is bumped on every add/del and travels in
+    // epoll_event.data, so an event that was queued for a closed fd is not delivered to a new
+    // registration that reused the number within the same batch. A deque so that growing it
+    // from inside a handler never moves the handler that is running.
+    struct Slot {
+        FdHandler fn;
+        uint32_t generation{0};
+        uint32_t events{0};
+        uint32_t poll_errors{0};  // io_uring: consecutive failed POLL_ADDs
+    };
+
     int epoll_fd_{-1};
-    std::unordered_map<int, FdHandler> handlers_;
+    std::deque<Slot> handlers_;
+    std::vector<epoll_event> events_;
+    std::unique_ptr<IoUring> uring_;
+    std::vector<UringCompletion> completions_;
+    // io_uring: (fd, generation) whose POLL_ADD could not be queued or failed; retried at the
+    // start of the next loop.
+    std::vector<std::pair<int, uint32_t>> uring_rearm_;
+    uint64_t syscalls_{0};
+    Fd timer_fd_;
+    TimerWheel timers_;
+    uint64_t armed_deadline_ns_{UINT64_MAX};
+    bool advancing_{false};
+    std::vector<TimerCallback> posted_;
+    std::vector<TimerCallback> running_;
+    void run_posted();
+    void on_timerfd();
+    void rearm_timerfd(uint64_t deadline_ns);
+    Slot* slot_for(int fd);
+
+    // io_uring backend (reactor_uring.cpp).
+    bool uring_init(size_t batch);
+    void uring_poll(int fd, const Slot& slot);
+    void uring_remove(int fd, uint32_t generation);
+    void uring_loop_once(int timeout_ms);
 };
 }  // namespace irr
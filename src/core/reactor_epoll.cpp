@@ -1,50 +1,174 @@
 #include <sys/epoll.h>
+#include <sys/timerfd.h>
 #include <unistd.h>
 
+#include "io_uring.hpp"
 #include "logger.hpp"
 #include "reactor.hpp"
+#include "time_utils.hpp"
 
 namespace irr {
-Reactor::Reactor() {
-    epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
-    if (epoll_fd_ < 0) log(LogLevel::ERROR, "epoll_create1 failed");
+namespace {
+uint64_t token(int fd, uint32_t generation) {
+    return (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fd);
+}
+}  // namespace
+
+bool parse_reactor_backend(const std::string& s, ReactorBackend& out) {
+    if (s == "epoll") {
+        out = ReactorBackend::Epoll;
+        return true;
+    }
+    if (s == "io_uring" || s == "uring") {
+        out = ReactorBackend::IoUring;
+        return true;
+    }
+    return false;
+}
+
+const char* reactor_backend_name(ReactorBackend b) {
+    return b == ReactorBackend::IoUring ? "io_uring" : "epoll";
+}
+
+Reactor::Reactor(int max_events, ReactorBackend backend)
+    : events_(static_cast<size_t>(max_events > 0 ? max_events : kDefaultBatch)),
+      timers_(monotonic_ns()) {
+    if (backend == ReactorBackend::IoUring && !uring_init(events_.size())) {
+        log(LogLevel::WARN, "io_uring unavailable; falling back to epoll");
+    }
+    if (!uring_) {
+        epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd_ < 0) log(LogLevel::ERROR, "epoll_create1 failed");
+    }
+    timer_fd_.reset(::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC));
+    if (!timer_fd_ || !add_fd(timer_fd_.get(), EPOLLIN, [this](uint32_t) { on_timerfd(); }))
+        log(LogLevel::ERROR, "timer wheel timerfd unavailable");
 }
 
 Reactor::~Reactor() {
     if (epoll_fd_ >= 0) ::close(epoll_fd_);
 }
 
-bool Reactor::add_fd(int fd, uint32_t events, const FdHandler& cb) {
-    struct epoll_event ev {};
-    ev.events = events;
-    ev.data.fd = fd;
-    if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) return false;
-    handlers_[fd] = cb;
+uint64_t Reactor::syscalls() const {
+    return syscalls_ + (uring_ ? uring_->enters() : 0);
+}
+
+Reactor::Slot* Reactor::slot_for(int fd) {
+    if (fd < 0 || static_cast<size_t>(fd) >= handlers_.size()) return nullptr;
+    return &handlers_[fd];
+}
+
+bool Reactor::add_fd(int fd, uint32_t events, FdHandler cb) {
+    if (fd < 0) return false;
+    if (static_cast<size_t>(fd) >= handlers_.size()) handlers_.resize(static_cast<size_t>(fd) + 1);
+    Slot& slot = handlers_[fd];
+    if (uring_) {
+        if (slot.fn) uring_remove(fd, slot.generation);
+    } else {
+        struct epoll_event ev {};
+        ev.events = events;
+        ev.data.u64 = token(fd, slot.generation + 1);
+        ++syscalls_;
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) return false;
+    }
+    ++slot.generation;
+    slot.events = events;
+    slot.poll_errors = 0;
+    slot.fn = std::move(cb);
+    if (uring_) uring_poll(fd, slot);
     return true;
 }
 
 bool Reactor::mod_fd(int fd, uint32_t events) {
+    Slot* slot = slot_for(fd);
+    if (!slot || !slot->fn) return false;
+    if (uring_) {
+        uring_remove(fd, slot->generation);
+        ++slot->generation;
+        slot->events = events;
+        slot->poll_errors = 0;
+        uring_poll(fd, *slot);
+        return true;
+    }
     struct epoll_event ev {};
     ev.events = events;
-    ev.data.fd = fd;
-    return ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev) == 0;
+    ev.data.u64 = token(fd, slot->generation);
+    ++syscalls_;
+    if (::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev) < 0) return false;
+    slot->events = events;
+    return true;
 }
 
 void Reactor::del_fd(int fd) {
-    ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
-    handlers_.erase(fd);
+    Slot* slot = slot_for(fd);
+    if (!uring_) {
+        ++syscalls_;
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    }
+    if (!slot || !slot->fn) return;
+    if (uring_) uring_remove(fd, slot->generation);
+    ++slot->generation;
+    slot->fn.reset();
+}
+
+TimerId Reactor::add_timer(uint64_t deadline_ns, TimerCallback cb) {
+    TimerId id = timers_.arm(deadline_ns, std::move(cb));
+    if (!advancing_ && deadline_ns < armed_deadline_ns_) rearm_timerfd(timers_.next_deadline_ns());
+    return id;
+}
+
+bool Reactor::cancel_timer(TimerId id) {
+    // The timerfd is left armed; a spurious wakeup just re-arms for the next deadline.
+    return timers_.cancel(id);
+}
+
+void Reactor::rearm_timerfd(uint64_t deadline_ns) {
+    if (!timer_fd_) return;
+    itimerspec its{};
+    if (deadline_ns != UINT64_MAX) {
+        // A zero it_value would disarm; deadlines at or before the epoch are not a concern.
+        its.it_value.tv_sec = static_cast<time_t>(deadline_ns / 1000000000ULL);
+        its.it_value.tv_nsec = static_cast<long>(deadline_ns % 1000000000ULL);
+    }
+    ++syscalls_;
+    if (::timerfd_settime(timer_fd_.get(), TFD_TIMER_ABSTIME, &its, nullptr) == 0)
+        armed_deadline_ns_ = deadline_ns;
+}
+
+void Reactor::on_timerfd() {
+    uint64_t expirations;
+    ++syscalls_;
+    (void)::read(timer_fd_.get(), &expirations, sizeof(expirations));
+    armed_deadline_ns_ = UINT64_MAX;
+    advancing_ = true;
+    timers_.advance(monotonic_ns());
+    advancing_ = false;
+    rearm_timerfd(timers_.next_deadline_ns());
+}
+
+void Reactor::run_posted() {
+    // Callbacks posted while these run wait for the next loop_once().
+    running_.swap(posted_);
+    for (auto& cb : running_) cb();
+    running_.clear();
 }
 
 void Reactor::loop_once(int timeout_ms) {
-    struct epoll_event evs[32];
-    int n = ::epoll_wait(epoll_fd_, evs, 32, timeout_ms);
-    if (n < 0) return;
+    if (!posted_.empty()) timeout_ms = 0;
+    if (uring_) {
+        uring_loop_once(timeout_ms);
+        run_posted();
+        return;
+    }
+    ++syscalls_;
+    int n = ::epoll_wait(epoll_fd_, events_.data(), static_cast<int>(events_.size()), timeout_ms);
     for (int i = 0; i < n; ++i) {
-        int fd = evs[i].data.fd;
-        auto it = handlers_.find(fd);
-        if (it != handlers_.end()) {
-            it->second(evs[i].events);
-        }
+        uint64_t tok = events_[i].data.u64;
+        auto fd = static_cast<uint32_t>(tok);
+        Slot& slot = handlers_[fd];
+        if (slot.generation == static_cast<uint32_t>(tok >> 32) && slot.fn)
+            slot.fn(events_[i].events);
     }
+    run_posted();
 }
 }  // namespace irr
@@ -0,0 +1,127 @@
+#include <poll.h>
+#include <sys/epoll.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include "io_uring.hpp"
+#include "logger.hpp"
+#include "reactor.hpp"
+#include "time_utils.hpp"
+
+namespace irr {
+namespace {
+// user_data for POLL_REMOVE submissions, whose completions carry nothing to dispatch.
+constexpr uint64_t kIgnore = UINT64_MAX;
+// Failed POLL_ADDs on a live registration are retried this many times in a row before the
+// handler is told the fd is broken. From then on each further failure is reported again and
+// the retry waits kErrorBackoffNs, doubling up to kMaxErrorBackoffNs, so a persistent error
+// cannot spin the loop and an fd the handler keeps registered is never silently dropped.
+constexpr uint32_t kMaxPollErrors = 3;
+constexpr uint64_t kErrorBackoffNs = 10'000'000;
+constexpr uint64_t kMaxErrorBackoffNs = 5'000'000'000;
+
+uint64_t error_backoff_ns(uint32_t poll_errors) {
+    uint32_t doublings = poll_errors - kMaxPollErrors;
+    if (doublings >= 9) return kMaxErrorBackoffNs;
+    return std::min(kErrorBackoffNs << doublings, kMaxErrorBackoffNs);
+}
+
+uint64_t token(int fd, uint32_t generation) {
+    return (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fd);
+}
+
+static_assert(EPOLLIN == POLLIN && EPOLLOUT == POLLOUT && EPOLLERR == POLLERR &&
+                  EPOLLHUP == POLLHUP && EPOLLPRI == POLLPRI,
+              "poll and epoll masks are used interchangeably");
+}  // namespace
+
+bool Reactor::uring_init(size_t batch) {
+    auto ring = std::make_unique<IoUring>();
+    // Room for a full batch of re-arms plus the adds/removes handlers queue meanwhile;
+    // get_sqe() submits early if it ever fills.
+    unsigned entries = 64;
+    while (entries < batch * 4 && entries < 4096) entries <<= 1;
+    if (!ring->init(entries)) return false;
+    uring_ = std::move(ring);
+    completions_.resize(batch);
+    return true;
+}
+
+void Reactor::uring_poll(int fd, const Slot& slot) {
+    io_uring_sqe* sqe = uring_->get_sqe();
+    if (!sqe) {
+        // Submission queue full and the early submit failed: try again next loop.
+        uring_rearm_.emplace_back(fd, slot.generation);
+        return;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = slot.events;  // little-endian layout, as on every target we ship
+    sqe->user_data = token(fd, slot.generation);
+}
+
+void Reactor::uring_remove(int fd, uint32_t generation) {
+    io_uring_sqe* sqe = uring_->get_sqe();
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = token(fd, generation);
+    sqe->user_data = kIgnore;
+}
+
+void Reactor::uring_loop_once(int timeout_ms) {
+    if (!uring_rearm_.empty()) {
+        std::vector<std::pair<int, uint32_t>> rearm;
+        rearm.swap(uring_rearm_);
+        for (const auto& [fd, gen] : rearm) {
+            Slot* slot = slot_for(fd);
+            if (slot && slot->generation == gen && slot->fn) uring_poll(fd, *slot);
+        }
+    }
+    if (!uring_->enter(true, timeout_ms)) return;
+    size_t n = uring_->reap(completions_.data(), completions_.size());
+    for (size_t i = 0; i < n; ++i) {
+        const UringCompletion& c = completions_[i];
+        // Removes, and polls they cancelled.
+        if (c.user_data == kIgnore || c.res == -ECANCELED) continue;
+        auto fd = static_cast<uint32_t>(c.user_data);
+        auto gen = static_cast<uint32_t>(c.user_data >> 32);
+        if (fd >= handlers_.size()) continue;
+        Slot& slot = handlers_[fd];
+        // Stale polls, including errors on fds closed before their remove landed.
+        if (slot.generation != gen || !slot.fn) continue;
+        if (c.res < 0) {
+            if (++slot.poll_errors < kMaxPollErrors) {
+                log(LogLevel::WARN, "io_uring poll on fd " + std::to_string(fd) +
+                                        " failed: " + std::strerror(-c.res));
+                uring_rearm_.emplace_back(static_cast<int>(fd), gen);
+                continue;
+            }
+            // Report it the way epoll reports a broken fd and let the handler decide; if it
+            // keeps the registration, poll again after a backoff.
+            if (slot.poll_errors == kMaxPollErrors)
+                log(LogLevel::ERROR, "io_uring poll on fd " + std::to_string(fd) + " failed: " +
+                                         std::strerror(-c.res) +
+                                         "; reporting it as broken and retrying with backoff");
+            uint64_t backoff = error_backoff_ns(slot.poll_errors);
+            slot.fn(EPOLLERR);
+            if (slot.generation != gen || !slot.fn) continue;
+            int rearm_fd = static_cast<int>(fd);
+            add_timer(monotonic_ns() + backoff, [this, rearm_fd, gen] {
+                Slot* s = slot_for(rearm_fd);
+                if (s && s->generation == gen && s->fn) uring_poll(rearm_fd, *s);
+            });
+            continue;
+        }
+        if (slot.poll_errors >= kMaxPollErrors)
+            log(LogLevel::INFO, "io_uring poll on fd " + std::to_string(fd) + " recovered");
+        slot.poll_errors = 0;
+        slot.fn(static_cast<uint32_t>(c.res));
+        // One-shot poll: re-arm unless the handler removed or re-registered the fd.
+        if (slot.generation == gen && slot.fn) uring_poll(static_cast<int>(fd), slot);
+    }
+}
+}  // namespace irr
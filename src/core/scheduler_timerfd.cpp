@@ -2,42 +2,158 @@
 
 #include <sys/epoll.h>
 #include <sys/timerfd.h>
+#include <unistd.h>
 
-#include <cstring>
+#include <algorithm>
+#include <cstdio>
 
 #include "logger.hpp"
+#include "time_utils.hpp"
 
 namespace irr {
-TimerScheduler::TimerScheduler() = default;
-TimerScheduler::~TimerScheduler() {
+namespace {
+uint64_t fnv1a(std::string_view s) {
+    uint64_t h = 1469598103934665603ULL;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+std::string ms_string(uint64_t ns) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.1f", ns / 1e6);
+    return buf;
+}
+}  // namespace
+
+PeriodicScheduler::PeriodicScheduler(uint64_t origin_ns)
+    : origin_ns_(origin_ns), now_(origin_ns) {}
+PeriodicScheduler::PeriodicScheduler() : PeriodicScheduler(monotonic_ns()) {}
+PeriodicScheduler::~PeriodicScheduler() {
     stop();
 }
 
-bool TimerScheduler::start(Reactor& r, int interval_ms, const std::function<void()>& cb) {
-    cb_ = cb;
+JobId PeriodicScheduler::add(std::string_view key, int interval_ms, std::function<void()> cb) {
+    Job j;
+    j.key = std::string(key);
+    j.interval_ns = static_cast<uint64_t>(std::max(interval_ms, 1)) * 1000000ULL;
+    j.phase_ns = fnv1a(key) % j.interval_ns;
+    j.active = true;
+    j.cb = std::move(cb);
+    // First slot on this job's grid that is not already in the past.
+    uint64_t due = origin_ns_ + j.phase_ns;
+    if (due < now_) due += (now_ - due + j.interval_ns - 1) / j.interval_ns * j.interval_ns;
+    auto id = static_cast<JobId>(jobs_.size());
+    jobs_.push_back(std::move(j));
+    heap_.push({due, id});
+    if (reactor_ && !running_jobs_ && due < armed_ns_) rearm();
+    return id;
+}
+
+void PeriodicScheduler::cancel(JobId id) {
+    if (id < jobs_.size()) jobs_[id].active = false;  // heap entry is dropped when it surfaces
+}
+
+bool PeriodicScheduler::start(Reactor& r) {
     int fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
     if (fd < 0) {
         log(LogLevel::ERROR, "timerfd_create failed");
         return false;
     }
     tfd_.reset(fd);
-    itimerspec its{};
-    its.it_interval.tv_sec = interval_ms / 1000;
-    its.it_interval.tv_nsec = (interval_ms % 1000) * 1000000;
-    its.it_value = its.it_interval;
-    if (::timerfd_settime(fd, 0, &its, nullptr) < 0) {
-        log(LogLevel::ERROR, "timerfd_settime failed");
+    if (!r.add_fd(fd, EPOLLIN, [this](uint32_t) { on_timer(); })) {
+        log(LogLevel::ERROR, "scheduler timerfd registration failed");
+        tfd_.reset();
         return false;
     }
-    r.add_fd(fd, EPOLLIN, [this](uint32_t) {
-        uint64_t expirations;
-        (void)::read(tfd_.get(), &expirations, sizeof(expirations));
-        if (cb_) cb_();
-    });
+    reactor_ = &r;
+    rearm();
     return true;
 }
 
-void TimerScheduler::stop() {
-    if (tfd_) tfd_.reset();
+void PeriodicScheduler::stop() {
+    if (reactor_ && tfd_) reactor_->del_fd(tfd_.get());
+    reactor_ = nullptr;
+    tfd_.reset();
+    armed_ns_ = UINT64_MAX;
+}
+
+size_t PeriodicScheduler::run_due(uint64_t now_ns) {
+    now_ = std::max(now_, now_ns);
+    running_jobs_ = true;
+    size_t ran = 0;
+    while (!heap_.empty() && heap_.top().at_ns <= now_ns) {
+        Due d = heap_.top();
+        heap_.pop();
+        Job& j = jobs_[d.id];
+        if (!j.active) continue;
+        uint64_t lag = now_ns - d.at_ns;
+        uint64_t skipped = lag / j.interval_ns;
+        j.stats.fires++;
+        j.stats.missed += skipped;
+        j.stats.lag_total_ns += lag;
+        j.stats.lag_max_ns = std::max(j.stats.lag_max_ns, lag);
+        heap_.push({d.at_ns + (skipped + 1) * j.interval_ns, d.id});
+        ++ran;
+        // jobs_ is a deque, so j stays valid if the callback adds jobs.
+        if (j.cb) j.cb();
+    }
+    running_jobs_ = false;
+    return ran;
+}
+
+uint64_t PeriodicScheduler::next_due_ns() const {
+    return heap_.empty() ? UINT64_MAX : heap_.top().at_ns;
+}
+
+void PeriodicScheduler::on_timer() {
+    uint64_t expirations;
+    (void)::read(tfd_.get(), &expirations, sizeof(expirations));
+    armed_ns_ = UINT64_MAX;
+    run_due(monotonic_ns());
+    rearm();
+}
+
+void PeriodicScheduler::rearm() {
+    if (!tfd_) return;
+    uint64_t next = next_due_ns();
+    if (next == armed_ns_) return;
+    itimerspec its{};
+    if (next != UINT64_MAX) {
+        next = std::max<uint64_t>(next, 1);  // a zero it_value would disarm
+        its.it_value.tv_sec = static_cast<time_t>(next / 1000000000ULL);
+        its.it_value.tv_nsec = static_cast<long>(next % 1000000000ULL);
+    }
+    if (::timerfd_settime(tfd_.get(), TFD_TIMER_ABSTIME, &its, nullptr) == 0) armed_ns_ = next;
+}
+
+void PeriodicScheduler::log_summary(const std::string& label) const {
+    uint64_t fires = 0, missed = 0, lag_max = 0, lag_total = 0;
+    std::vector<JobId> late;
+    for (JobId id = 0; id < jobs_.size(); ++id) {
+        const auto& s = jobs_[id].stats;
+        fires += s.fires;
+        missed += s.missed;
+        lag_total += s.lag_total_ns;
+        lag_max = std::max(lag_max, s.lag_max_ns);
+        if (s.missed > 0) late.push_back(id);
+    }
+    log(LogLevel::INFO, label + ": " + std::to_string(jobs_.size()) + " jobs, " +
+                            std::to_string(fires) + " runs, lag avg " +
+                            ms_string(fires ? lag_total / fires : 0) + " ms max " +
+                            ms_string(lag_max) + " ms, " + std::to_string(missed) +
+                            " missed periods");
+    std::sort(late.begin(), late.end(), [this](JobId a, JobId b) {
+        return jobs_[a].stats.missed > jobs_[b].stats.missed;
+    });
+    if (late.size() > 10) late.resize(10);
+    for (JobId id : late) {
+        const auto& s = jobs_[id].stats;
+        log(LogLevel::WARN, label + ": job " + jobs_[id].key + " missed " +
+                                std::to_string(s.missed) + " periods, max lag " +
+                                ms_string(s.lag_max_ns) + " ms");
+    }
 }
 }  // namespace irr
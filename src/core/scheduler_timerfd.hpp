@@ -1,19 +1,90 @@
 #pragma once
+#include <cstdint>
+#include <deque>
 #include <functional>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "fd.hpp"
 #include "reactor.hpp"
 
 namespace irr {
-class TimerScheduler {
+using JobId = uint32_t;
+
+// The timerfd is re-armed one-shot for the earliest due time, so its expiration count is
+// always 1; an overloaded loop shows up here instead, as lag behind each job's due time and
+// as whole periods skipped.
+struct JobStats {
+    uint64_t fires{0};
+    uint64_t missed{0};  // whole periods skipped because the job ran late
+    uint64_t lag_max_ns{0};
+    uint64_t lag_total_ns{0};
+};
+
+// Periodic job scheduler driven by a min-heap of due times and one timerfd armed (absolute)
+// for the earliest job. Each job's phase within its interval is derived from a hash of its
+// key, so thousands of targets sharing an interval are spread across it instead of firing in
+// one burst, and the spread is the same from run to run. Jobs never drift: the next due time
+// is always origin + phase + k * interval.
+class PeriodicScheduler {
    public:
-    TimerScheduler();
-    ~TimerScheduler();
-    bool start(Reactor& r, int interval_ms, const std::function<void()>& cb);
+    explicit PeriodicScheduler(uint64_t origin_ns);
+    PeriodicScheduler();
+    ~PeriodicScheduler();
+
+    JobId add(std::string_view key, int interval_ms, std::function<void()> cb);
+    void cancel(JobId id);
+
+    bool start(Reactor& r);
     void stop();
 
+    // Runs every job due at or before now_ns; returns how many ran. Called from the timerfd
+    // handler, exposed for tests.
+    size_t run_due(uint64_t now_ns);
+    // UINT64_MAX when no job is scheduled.
+    uint64_t next_due_ns() const;
+
+    size_t size() const {
+        return jobs_.size();
+    }
+    const std::string& key(JobId id) const {
+        return jobs_[id].key;
+    }
+    const JobStats& stats(JobId id) const {
+        return jobs_[id].stats;
+    }
+    // Logs the aggregate lag and any jobs that skipped periods.
+    void log_summary(const std::string& label = "scheduler") const;
+
    private:
+    struct Job {
+        std::string key;
+        uint64_t interval_ns;
+        uint64_t phase_ns;
+        bool active;
+        std::function<void()> cb;
+        JobStats stats;
+    };
+    struct Due {
+        uint64_t at_ns;
+        JobId id;
+        bool operator>(const Due& o) const {
+            return at_ns > o.at_ns;
+        }
+    };
+
+    uint64_t origin_ns_;
+    uint64_t now_;  // latest time seen by run_due(); new jobs start after it
+    std::deque<Job> jobs_;
+    std::priority_queue<Due, std::vector<Due>, std::greater<Due>> heap_;
+    Reactor* reactor_{nullptr};
     Fd tfd_;
-    std::function<void()> cb_;
+    uint64_t armed_ns_{UINT64_MAX};
+    bool running_jobs_{false};
+
+    void on_timer();
+    void rearm();
 };
 }  // namespace irr
@@ -0,0 +1,63 @@
+#include "sink_worker.hpp"
+
+#include "event_bus.hpp"
+#include "logger.hpp"
+
+namespace irr {
+SinkWorker::SinkWorker(std::vector<EventRing*> rings, std::vector<EventSink*> sinks)
+    : rings_(std::move(rings)), sinks_(std::move(sinks)), batch_(kBatch) {
+    for (auto* r : rings_) r->set_doorbell(&bell_);
+}
+
+SinkWorker::~SinkWorker() {
+    stop();
+    for (auto* r : rings_) r->set_doorbell(nullptr);
+}
+
+bool SinkWorker::start() {
+    if (running_.exchange(true)) return true;
+    try {
+        thread_ = std::thread([this]() { run(); });
+    } catch (const std::system_error&) {
+        running_ = false;
+        log(LogLevel::ERROR, "SinkWorker failed to start thread");
+        return false;
+    }
+    return true;
+}
+
+void SinkWorker::stop() {
+    if (!running_.exchange(false)) return;
+    bell_.wake_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+bool SinkWorker::has_work() const {
+    for (const auto* r : rings_)
+        if (!r->empty()) return true;
+    return false;
+}
+
+size_t SinkWorker::drain_once() {
+    size_t total = 0;
+    for (auto* r : rings_) {
+        size_t n = r->pop_batch(batch_.data(), batch_.size());
+        if (n == 0) continue;
+        for (auto* s : sinks_) s->on_events({batch_.data(), n});
+        total += n;
+    }
+    return total;
+}
+
+void SinkWorker::run() {
+    while (running_.load(std::memory_order_relaxed)) {
+        if (drain_once() == 0) {
+            bell_.wait([this]() { return has_work(); }, 50);
+            for (auto* s : sinks_) s->on_idle();
+        }
+    }
+    // Final drain so stop() never loses queued events.
+    while (drain_once() > 0) {
+    }
+}
+}  // namespace irr
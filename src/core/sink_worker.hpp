@@ -0,0 +1,39 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "event.hpp"
+#include "event_ring.hpp"
+
+namespace irr {
+class EventSink;
+
+// Dedicated thread that drains one or more EventRings into a set of sinks, keeping file I/O
+// off the reactor thread.
+class SinkWorker {
+   public:
+    SinkWorker(std::vector<EventRing*> rings, std::vector<EventSink*> sinks);
+    ~SinkWorker();
+    SinkWorker(const SinkWorker&) = delete;
+    SinkWorker& operator=(const SinkWorker&) = delete;
+
+    bool start();
+    // Drains everything still queued, then joins the thread.
+    void stop();
+
+   private:
+    static constexpr size_t kBatch = 256;
+
+    std::vector<EventRing*> rings_;
+    std::vector<EventSink*> sinks_;
+    std::vector<Event> batch_;
+    Doorbell bell_;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+
+    void run();
+    size_t drain_once();
+    bool has_work() const;
+};
+}  // namespace irr
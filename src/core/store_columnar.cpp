@@ -0,0 +1,322 @@
+#include "store_columnar.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+
+#include "logger.hpp"
+#include "symbols.hpp"
+#include "time_utils.hpp"
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "columnar format assumes little-endian");
+
+namespace irr {
+using namespace columnar;
+
+namespace {
+void put_varint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+uint64_t zigzag(int64_t v) {
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+int64_t unzigzag(uint64_t v) {
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+template <typename T>
+void put_raw(std::string& out, const T& v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+void pad8(std::string& out) {
+    while (out.size() % 8 != 0) out.push_back('\0');
+}
+
+// Bounds-checked forward cursor over one column.
+struct Cursor {
+    const uint8_t* p;
+    const uint8_t* end;
+    bool ok{true};
+    uint64_t varint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (p >= end) {
+                ok = false;
+                return 0;
+            }
+            uint8_t b = *p++;
+            v |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if ((b & 0x80) == 0) return v;
+        }
+        ok = false;
+        return 0;
+    }
+};
+}  // namespace
+
+ColumnarStore::ColumnarStore(const std::string& path, size_t segment_events, int max_delay_ms)
+    : segment_events_(segment_events == 0 ? 1 : segment_events), max_delay_ms_(max_delay_ms) {
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_ < 0) log(LogLevel::ERROR, "ColumnarStore failed to open output file: " + path);
+}
+
+ColumnarStore::~ColumnarStore() {
+    if (fd_ < 0) return;
+    flush_segment();
+    ::close(fd_);
+}
+
+uint32_t ColumnarStore::dict_id(std::string_view s) {
+    auto it = dict_index_.find(s);
+    if (it != dict_index_.end()) return it->second;
+    dict_.emplace_back(s);
+    auto id = static_cast<uint32_t>(dict_.size() - 1);
+    dict_index_.emplace(dict_.back(), id);
+    return id;
+}
+
+void ColumnarStore::append(const Event& ev) {
+    const auto& syms = symbols();
+    uint64_t wall_ms = ev.ts_wall_ns / 1000000ULL;
+    if (count_ == 0) {
+        segment_started_ns_ = monotonic_ns();
+        prev_mono_ = 0;
+        prev_wall_ms_ = 0;
+        ts_min_ = ts_max_ = ev.ts_monotonic_ns;
+    }
+    ts_min_ = std::min(ts_min_, ev.ts_monotonic_ns);
+    ts_max_ = std::max(ts_max_, ev.ts_monotonic_ns);
+    put_varint(cols_[kTsMono], zigzag(static_cast<int64_t>(ev.ts_monotonic_ns - prev_mono_)));
+    put_varint(cols_[kTsWall], zigzag(static_cast<int64_t>(wall_ms - prev_wall_ms_)));
+    prev_mono_ = ev.ts_monotonic_ns;
+    prev_wall_ms_ = wall_ms;
+    put_varint(cols_[kType], dict_id(event_type_name(ev.type)));
+    put_varint(cols_[kTarget], dict_id(syms.name(ev.target_name)));
+    put_varint(cols_[kIp], dict_id(syms.name(ev.target_ip)));
+    put_varint(cols_[kFamily], dict_id(syms.name(ev.target_family)));
+    put_varint(cols_[kRun], dict_id(syms.name(ev.run_id)));
+    put_varint(cols_[kInterval], zigzag(ev.interval_ms));
+    put_varint(cols_[kTimeout], zigzag(ev.timeout_ms));
+    char category[64];
+    put_varint(cols_[kError],
+               dict_id(std::string_view(category, format_error_category(ev, category, 64))));
+    double us = std::isfinite(ev.metric_ms) ? std::round(ev.metric_ms * 1000.0) : 0.0;
+    auto metric = static_cast<uint32_t>(std::min(std::max(us, 0.0), 4294967295.0));
+    put_raw(cols_[kMetric], metric);
+    if (count_ % 8 == 0) cols_[kOk].push_back('\0');
+    if (ev.ok) cols_[kOk].back() = static_cast<char>(cols_[kOk].back() | (1 << (count_ % 8)));
+    ++count_;
+}
+
+void ColumnarStore::flush_segment() {
+    if (fd_ < 0 || count_ == 0) return;
+    SegmentFooter footer{};
+    out_.clear();
+    out_.resize(sizeof(SegmentHeader));
+    // Dictionary: u32 count, then (u16 length, bytes) per entry.
+    footer.dict_offset = static_cast<uint32_t>(out_.size());
+    put_raw(out_, static_cast<uint32_t>(dict_.size()));
+    for (const auto& s : dict_) {
+        put_raw(out_, static_cast<uint16_t>(std::min<size_t>(s.size(), 0xFFFF)));
+        out_.append(s.data(), std::min<size_t>(s.size(), 0xFFFF));
+    }
+    footer.dict_size = static_cast<uint32_t>(out_.size() - footer.dict_offset);
+    for (uint32_t c = 0; c < kColumnCount; ++c) {
+        pad8(out_);
+        footer.column_offset[c] = static_cast<uint32_t>(out_.size());
+        footer.column_size[c] = static_cast<uint32_t>(cols_[c].size());
+        out_ += cols_[c];
+        cols_[c].clear();
+    }
+    pad8(out_);
+    footer.ts_min = ts_min_;
+    footer.ts_max = ts_max_;
+    footer.event_count = count_;
+    footer.magic = kFooterMagic;
+    put_raw(out_, footer);
+    SegmentHeader header{kSegmentMagic, kVersion, static_cast<uint16_t>(kColumnCount), count_,
+                         static_cast<uint32_t>(out_.size())};
+    std::memcpy(&out_[0], &header, sizeof(header));
+
+    const char* p = out_.data();
+    size_t left = out_.size();
+    while (left > 0) {
+        ssize_t n = ::write(fd_, p, left);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (write_errors_++ == 0)
+                log(LogLevel::ERROR, "ColumnarStore write failed; dropping segment");
+            break;
+        }
+        p += n;
+        left -= static_cast<size_t>(n);
+    }
+    count_ = 0;
+    dict_index_.clear();
+    dict_.clear();
+}
+
+void ColumnarStore::on_event(const Event& ev) {
+    if (fd_ < 0) return;
+    append(ev);
+    if (count_ >= segment_events_) flush_segment();
+}
+
+void ColumnarStore::on_events(EventSpan events) {
+    for (const auto& ev : events) on_event(ev);
+}
+
+void ColumnarStore::on_idle() {
+    if (count_ == 0) return;
+    uint64_t max_delay_ns = static_cast<uint64_t>(max_delay_ms_) * 1000000ULL;
+    if (monotonic_ns() - segment_started_ns_ >= max_delay_ns) flush_segment();
+}
+
+ColumnarReader::~ColumnarReader() {
+    if (data_) ::munmap(const_cast<uint8_t*>(data_), size_);
+}
+
+bool ColumnarReader::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st {};
+    if (::fstat(fd, &st) < 0) {
+        ::close(fd);
+        return false;
+    }
+    if (st.st_size == 0) {
+        ::close(fd);
+        return true;  // empty store: no segments
+    }
+    void* p = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return false;
+    ::madvise(p, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+    data_ = static_cast<const uint8_t*>(p);
+    size_ = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+size_t ColumnarReader::segment_offsets(std::vector<size_t>& offsets) const {
+    offsets.clear();
+    size_t offset = 0;
+    while (offset + sizeof(SegmentHeader) + sizeof(SegmentFooter) <= size_) {
+        SegmentHeader header;
+        std::memcpy(&header, data_ + offset, sizeof(header));
+        if (header.magic != kSegmentMagic || header.segment_bytes > size_ - offset ||
+            header.segment_bytes < sizeof(SegmentHeader) + sizeof(SegmentFooter))
+            break;
+        offsets.push_back(offset);
+        offset += header.segment_bytes;
+    }
+    return offset;
+}
+
+bool ColumnarReader::next_segment(size_t& offset, std::vector<ColumnarRecord>& out,
+                                  std::vector<std::string_view>& dict) const {
+    out.clear();
+    if (offset + sizeof(SegmentHeader) + sizeof(SegmentFooter) > size_) return false;
+    const uint8_t* seg = data_ + offset;
+    SegmentHeader header;
+    std::memcpy(&header, seg, sizeof(header));
+    if (header.magic != kSegmentMagic || header.version != kVersion ||
+        header.columns != kColumnCount || header.segment_bytes > size_ - offset ||
+        header.segment_bytes < sizeof(SegmentHeader) + sizeof(SegmentFooter))
+        return false;
+    SegmentFooter footer;
+    std::memcpy(&footer, seg + header.segment_bytes - sizeof(footer), sizeof(footer));
+    uint32_t body_end = header.segment_bytes - static_cast<uint32_t>(sizeof(footer));
+    if (footer.magic != kFooterMagic || footer.event_count != header.event_count) return false;
+    uint32_t n = header.event_count;
+    if (footer.dict_offset > body_end || footer.dict_size > body_end - footer.dict_offset)
+        return false;
+    for (uint32_t c = 0; c < kColumnCount; ++c) {
+        if (footer.column_offset[c] > body_end ||
+            footer.column_size[c] > body_end - footer.column_offset[c])
+            return false;
+    }
+    if (footer.column_size[kMetric] != n * sizeof(uint32_t) ||
+        footer.column_size[kOk] != (n + 7) / 8)
+        return false;
+
+    dict.clear();
+    {
+        const uint8_t* p = seg + footer.dict_offset;
+        const uint8_t* end = p + footer.dict_size;
+        uint32_t count;
+        if (end - p < 4) return false;
+        std::memcpy(&count, p, 4);
+        p += 4;
+        for (uint32_t i = 0; i < count; ++i) {
+            uint16_t len;
+            if (end - p < 2) return false;
+            std::memcpy(&len, p, 2);
+            p += 2;
+            if (end - p < len) return false;
+            dict.emplace_back(reinterpret_cast<const char*>(p), len);
+            p += len;
+        }
+    }
+
+    auto cursor = [&](Column c) {
+        const uint8_t* p = seg + footer.column_offset[c];
+        return Cursor{p, p + footer.column_size[c]};
+    };
+    Cursor mono = cursor(kTsMono), wall = cursor(kTsWall), type = cursor(kType),
+           target = cursor(kTarget), ip = cursor(kIp), family = cursor(kFamily),
+           run = cursor(kRun), interval = cursor(kInterval), timeout = cursor(kTimeout),
+           error = cursor(kError);
+    const uint8_t* metric = seg + footer.column_offset[kMetric];
+    const uint8_t* okbits = seg + footer.column_offset[kOk];
+    auto str = [&](Cursor& c, std::string_view& dst) {
+        uint64_t id = c.varint();
+        if (id >= dict.size()) {
+            c.ok = false;
+            return;
+        }
+        dst = dict[id];
+    };
+
+    out.resize(n);
+    uint64_t prev_mono = 0, prev_wall = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        auto& r = out[i];
+        prev_mono += static_cast<uint64_t>(unzigzag(mono.varint()));
+        prev_wall += static_cast<uint64_t>(unzigzag(wall.varint()));
+        r.ts_monotonic_ns = prev_mono;
+        r.ts_wall_ms = prev_wall;
+        str(type, r.type);
+        str(target, r.target_name);
+        str(ip, r.target_ip);
+        str(family, r.target_family);
+        str(run, r.run_id);
+        str(error, r.error_category);
+        r.interval_ms = static_cast<int>(unzigzag(interval.varint()));
+        r.timeout_ms = static_cast<int>(unzigzag(timeout.varint()));
+        uint32_t us;
+        std::memcpy(&us, metric + i * sizeof(uint32_t), sizeof(us));
+        r.metric_ms = us / 1000.0;
+        r.ok = (okbits[i / 8] >> (i % 8)) & 1;
+    }
+    if (!(mono.ok && wall.ok && type.ok && target.ok && ip.ok && family.ok && run.ok &&
+          interval.ok && timeout.ok && error.ok)) {
+        out.clear();
+        return false;
+    }
+    offset += header.segment_bytes;
+    return true;
+}
+}  // namespace irr
@@ -0,0 +1,142 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "event_bus.hpp"
+
+namespace irr {
+// Append-only binary segment file (events.irrc). Each segment holds up to segment_events
+// events as independent columns:
+//   ts_monotonic_ns  zigzag varint deltas
+//   ts_wall          zigzag varint deltas in milliseconds
+//   type, target, ip, family, run, error
+//                    varint indexes into the segment's string dictionary
+//   interval/timeout varints
+//   metric           fixed-width uint32 microseconds (same precision as events.jsonl)
+//   ok               bitmap
+// and ends in a footer that indexes the columns and records the segment's time range.
+namespace columnar {
+constexpr uint32_t kSegmentMagic = 0x53525249;  // "IRRS"
+constexpr uint32_t kFooterMagic = 0x46525249;   // "IRRF"
+constexpr uint16_t kVersion = 1;
+
+enum Column : uint32_t {
+    kTsMono,
+    kTsWall,
+    kType,
+    kTarget,
+    kIp,
+    kFamily,
+    kRun,
+    kInterval,
+    kTimeout,
+    kError,
+    kMetric,
+    kOk,
+    kColumnCount,
+};
+
+struct SegmentHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t columns;
+    uint32_t event_count;
+    uint32_t segment_bytes;  // header + body + footer
+};
+
+struct SegmentFooter {
+    uint32_t column_offset[kColumnCount];  // relative to the segment start
+    uint32_t column_size[kColumnCount];
+    uint32_t dict_offset;
+    uint32_t dict_size;
+    uint64_t ts_min;
+    uint64_t ts_max;
+    uint32_t event_count;
+    uint32_t magic;
+};
+}  // namespace columnar
+
+class ColumnarStore : public EventSink {
+   public:
+    explicit ColumnarStore(const std::string& path, size_t segment_events = 4096,
+                           int max_delay_ms = 60000);
+    ~ColumnarStore();
+    void on_event(const Event& ev) override;
+    void on_events(EventSpan events) override;
+    void on_idle() override;
+    // Seals the current segment (if non-empty) with a single write().
+    void flush_segment();
+
+   private:
+    int fd_{-1};
+    size_t segment_events_;
+    int max_delay_ms_;
+    uint32_t count_{0};
+    uint64_t segment_started_ns_{0};
+    uint64_t prev_mono_{0};
+    uint64_t prev_wall_ms_{0};
+    uint64_t ts_min_{0};
+    uint64_t ts_max_{0};
+    std::string cols_[columnar::kColumnCount];
+    std::deque<std::string> dict_;
+    std::unordered_map<std::string_view, uint32_t> dict_index_;
+    std::string out_;
+    uint64_t write_errors_{0};
+
+    void append(const Event& ev);
+    uint32_t dict_id(std::string_view s);
+};
+
+// One decoded event; string fields point into the mapped file.
+struct ColumnarRecord {
+    uint64_t ts_monotonic_ns{};
+    uint64_t ts_wall_ms{};
+    std::string_view type;
+    std::string_view target_name;
+    std::string_view target_ip;
+    std::string_view target_family;
+    std::string_view run_id;
+    std::string_view error_category;
+    int interval_ms{};
+    int timeout_ms{};
+    bool ok{};
+    double metric_ms{};
+};
+
+// mmap-based reader. Segments are decoded straight out of the mapping; a torn or corrupt
+// trailing segment ends iteration rather than failing the whole file.
+class ColumnarReader {
+   public:
+    ColumnarReader() = default;
+    ~ColumnarReader();
+    ColumnarReader(const ColumnarReader&) = delete;
+    ColumnarReader& operator=(const ColumnarReader&) = delete;
+
+    bool open(const std::string& path);
+    // Decodes the segment at `offset` into `out` (reusing its capacity) and advances offset.
+    // Returns false at end of file or at the first invalid segment.
+    bool next_segment(size_t& offset, std::vector<ColumnarRecord>& out) {
+        return next_segment(offset, out, dict_);
+    }
+    // Same, with the caller's dictionary scratch, so threads can decode disjoint segments of
+    // one reader concurrently.
+    bool next_segment(size_t& offset, std::vector<ColumnarRecord>& out,
+                      std::vector<std::string_view>& dict) const;
+    // Fills `offsets` with the segment starts, found by hopping over their headers without
+    // decoding, and returns the end of the last one. Stops at the first header that does not
+    // describe a segment inside the file.
+    size_t segment_offsets(std::vector<size_t>& offsets) const;
+    size_t size() const {
+        return size_;
+    }
+
+   private:
+    const uint8_t* data_{nullptr};
+    size_t size_{0};
+    std::vector<std::string_view> dict_;
+};
+}  // namespace irr
@@ -1,67 +1,120 @@
 #include "store_jsonl.hpp"
 
-#include <iomanip>
-#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
 
+#include <cerrno>
+
+#include "../util/format.hpp"
 #include "logger.hpp"
+#include "symbols.hpp"
+#include "time_utils.hpp"
 
 namespace irr {
-JsonlStore::JsonlStore(const std::string& path) : out_(path, std::ios::app) {
-    is_open_ = out_.is_open();
-    if (!is_open_) {
+JsonlStore::JsonlStore(const std::string& path, const CommitPolicy& policy) : policy_(policy) {
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
         log(LogLevel::ERROR, "JsonlStore failed to open output file: " + path);
+        return;
     }
+    if (policy_.max_events == 0) policy_.max_events = 1;
+    buf_.reserve(policy_.max_events * 320 + 4096);
 }
+
 JsonlStore::~JsonlStore() {
-    if (is_open_) out_.flush();
+    if (fd_ < 0) return;
+    commit();
+    ::close(fd_);
 }
 
-std::string JsonlStore::escape(const std::string& s) {
-    std::string out;
-    out.reserve(s.size());
-    for (char c : s) {
-        switch (c) {
-            case '"':
-                out += "\\\"";
-                break;
-            case '\\':
-                out += "\\\\";
-                break;
-            case '\n':
-                out += "\\n";
-                break;
-            case '\r':
-                out += "\\r";
-                break;
-            case '\t':
-                out += "\\t";
-                break;
-            default:
-                out += c;
-                break;
+void JsonlStore::append_json(const Event& ev) {
+    const auto& syms = symbols();
+    char tmp[64];
+    if (pending_ == 0) oldest_pending_ns_ = monotonic_ns();
+    ++pending_;
+    buf_ += "{\"run_id\":\"";
+    append_json_escaped(buf_, syms.name(ev.run_id));
+    buf_ += "\",\"ts_monotonic_ns\":";
+    append_uint(buf_, ev.ts_monotonic_ns);
+    buf_ += ",\"ts_wall\":\"";
+    buf_.append(tmp, format_iso8601(ev.ts_wall_ns, tmp, sizeof(tmp)));
+    buf_ += "\",\"type\":\"";
+    buf_ += event_type_name(ev.type);
+    buf_ += "\",\"target\":{\"name\":\"";
+    append_json_escaped(buf_, syms.name(ev.target_name));
+    buf_ += "\",\"ip\":\"";
+    append_json_escaped(buf_, syms.name(ev.target_ip));
+    buf_ += "\",\"family\":\"";
+    append_json_escaped(buf_, syms.name(ev.target_family));
+    buf_ += "\"},\"probe\":{\"interval_ms\":";
+    append_int(buf_, ev.interval_ms);
+    buf_ += ",\"timeout_ms\":";
+    append_int(buf_, ev.timeout_ms);
+    buf_ += "},\"result\":{\"ok\":";
+    buf_ += ev.ok ? "true" : "false";
+    buf_ += ",\"metric_ms\":";
+    append_fixed(buf_, ev.metric_ms);
+    if (ev.kernel_ms >= 0) {
+        buf_ += ",\"kernel_ms\":";
+        append_fixed(buf_, ev.kernel_ms);
+    }
+    if (ev.answer_count > 0 || ev.min_ttl >= 0) {
+        buf_ += ",\"answers\":";
+        append_int(buf_, ev.answer_count);
+        buf_ += ",\"min_ttl\":";
+        append_int(buf_, ev.min_ttl);
+        if (size_t n = format_answer_ip(ev, tmp, sizeof(tmp))) {
+            buf_ += ",\"answer_ip\":\"";
+            buf_.append(tmp, n);
+            buf_ += "\"";
         }
     }
-    return out;
+    buf_ += ",\"error_category\":\"";
+    append_json_escaped(buf_, std::string_view(tmp, format_error_category(ev, tmp, sizeof(tmp))));
+    buf_ += "\"}}\n";
 }
 
-void JsonlStore::write_json(const Event& ev) {
-    if (!is_open_) return;
-    out_ << "{";
-    out_ << "\"run_id\":\"" << escape(ev.run_id) << "\",";
-    out_ << "\"ts_monotonic_ns\":" << ev.ts_monotonic_ns << ",";
-    out_ << "\"ts_wall\":\"" << ev.ts_wall << "\",";
-    out_ << "\"type\":\"" << escape(ev.type) << "\",";
-    out_ << "\"target\":{\"name\":\"" << escape(ev.target_name) << "\",";
-    out_ << "\"ip\":\"" << escape(ev.target_ip) << "\",";
-    out_ << "\"family\":\"" << escape(ev.target_family) << "\"},";
-    out_ << "\"probe\":{\"interval_ms\":" << ev.interval_ms << ",\"timeout_ms\":" << ev.timeout_ms
-         << "},";
-    out_ << "\"result\":{\"ok\":" << (ev.ok ? "true" : "false") << ",\"metric_ms\":" << ev.metric_ms
-         << ",\"error_category\":\"" << escape(ev.error_category) << "\"}";
-    out_ << "}\n";
+void JsonlStore::commit() {
+    if (fd_ < 0 || buf_.empty()) return;
+    const char* p = buf_.data();
+    size_t left = buf_.size();
+    while (left > 0) {
+        ssize_t n = ::write(fd_, p, left);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (write_errors_++ == 0)
+                log(LogLevel::ERROR, "JsonlStore write failed; dropping batch");
+            break;
+        }
+        p += n;
+        left -= static_cast<size_t>(n);
+    }
+    if (policy_.fdatasync) ::fdatasync(fd_);
+    buf_.clear();
+    pending_ = 0;
+}
+
+void JsonlStore::maybe_commit() {
+    if (pending_ == 0) return;
+    uint64_t max_delay_ns = static_cast<uint64_t>(policy_.max_delay_ms) * 1000000ULL;
+    if (pending_ >= policy_.max_events || monotonic_ns() - oldest_pending_ns_ >= max_delay_ns)
+        commit();
 }
 
 void JsonlStore::on_event(const Event& ev) {
-    write_json(ev);
+    if (fd_ < 0) return;
+    append_json(ev);
+    maybe_commit();
+}
+
+void JsonlStore::on_events(EventSpan events) {
+    if (fd_ < 0) return;
+    for (const auto& ev : events) append_json(ev);
+    maybe_commit();
+}
+
+void JsonlStore::on_idle() {
+    if (fd_ < 0) return;
+    maybe_commit();
 }
 }  // namespace irr
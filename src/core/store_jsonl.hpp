@@ -1,20 +1,35 @@
 #pragma once
-#include <fstream>
+#include <cstdint>
 #include <string>
 
 #include "event_bus.hpp"
 
 namespace irr {
+// Group-commit policy: buffered lines go out in one write() once either threshold is hit.
+struct CommitPolicy {
+    size_t max_events{64};    // commit after this many buffered events (1 = every event)
+    int max_delay_ms{1000};   // ...or once the oldest buffered event is this old
+    bool fdatasync{false};    // fdatasync() after every commit
+};
+
 class JsonlStore : public EventSink {
    public:
-    explicit JsonlStore(const std::string& path);
+    explicit JsonlStore(const std::string& path, const CommitPolicy& policy = CommitPolicy{});
     ~JsonlStore();
     void on_event(const Event& ev) override;
+    void on_events(EventSpan events) override;
+    void on_idle() override;
+    // Writes out everything buffered regardless of policy.
+    void commit();
 
    private:
-    bool is_open_{false};
-    std::ofstream out_;
-    void write_json(const Event& ev);
-    static std::string escape(const std::string& s);
+    int fd_{-1};
+    CommitPolicy policy_;
+    std::string buf_;
+    size_t pending_{0};
+    uint64_t oldest_pending_ns_{0};
+    uint64_t write_errors_{0};
+    void append_json(const Event& ev);
+    void maybe_commit();
 };
 }  // namespace irr
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace irr {
+using SymbolId = uint32_t;
+
+// Append-only string interning table. Probes intern target names, addresses and run ids once
+// and carry the small integer id in events; sinks resolve it back to text. Id 0 is always the
+// empty string so zero-initialised fields render as "".
+class SymbolTable {
+   public:
+    SymbolTable() {
+        intern("");
+    }
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    // Lookups of already-known strings do not allocate.
+    SymbolId intern(std::string_view s) {
+        std::lock_guard<std::mutex> lock(mu_);
+        auto it = index_.find(s);
+        if (it != index_.end()) return it->second;
+        strings_.emplace_back(s);
+        auto id = static_cast<SymbolId>(strings_.size() - 1);
+        index_.emplace(strings_.back(), id);
+        return id;
+    }
+
+    // The returned reference stays valid for the table's lifetime (deque never relocates).
+    const std::string& name(SymbolId id) const {
+        std::lock_guard<std::mutex> lock(mu_);
+        return id < strings_.size() ? strings_[id] : strings_[0];
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mu_);
+        return strings_.size();
+    }
+
+   private:
+    mutable std::mutex mu_;
+    std::deque<std::string> strings_;
+    std::unordered_map<std::string_view, SymbolId> index_;
+};
+
+// Process-wide table shared by probes and sinks.
+inline SymbolTable& symbols() {
+    static SymbolTable table;
+    return table;
+}
+}  // namespace irr
@@ -1,5 +1,6 @@
 #pragma once
 #include <chrono>
+#include <cstdint>
 #include <ctime>
 #include <string>
 
@@ -9,11 +10,22 @@ inline uint64_t monotonic_ns() {
     return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
 }
 
+inline uint64_t wall_ns() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+// Formats a CLOCK_REALTIME timestamp as "%FT%TZ" into buf (>= 21 bytes); returns the length.
+inline size_t format_iso8601(uint64_t ns, char* buf, size_t cap) {
+    auto t = static_cast<time_t>(ns / 1000000000ULL);
+    std::tm tm{};
+    ::gmtime_r(&t, &tm);
+    return std::strftime(buf, cap, "%FT%TZ", &tm);
+}
+
 inline std::string wall_time_iso8601() {
-    auto now = std::chrono::system_clock::now();
-    auto t = std::chrono::system_clock::to_time_t(now);
     char buf[32];
-    std::strftime(buf, sizeof(buf), "%FT%TZ", std::gmtime(&t));
-    return std::string(buf);
+    size_t n = format_iso8601(wall_ns(), buf, sizeof(buf));
+    return std::string(buf, n);
 }
 }  // namespace irr
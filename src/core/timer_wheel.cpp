@@ -0,0 +1,171 @@
+#include "timer_wheel.hpp"
+
+#include <algorithm>
+
+namespace irr {
+namespace {
+int rotated_ctz(uint64_t bits, uint32_t start) {
+    uint64_t rot = start == 0 ? bits : (bits >> start) | (bits << (64 - start));
+    return __builtin_ctzll(rot);
+}
+}  // namespace
+
+TimerWheel::TimerWheel(uint64_t now_ns) : next_tick_(now_ns / kTickNs) {
+    std::fill(std::begin(heads_), std::end(heads_), kNil);
+}
+
+TimerId TimerWheel::arm(uint64_t deadline_ns, TimerCallback cb) {
+    uint32_t idx;
+    if (!free_.empty()) {
+        idx = free_.back();
+        free_.pop_back();
+    } else {
+        idx = static_cast<uint32_t>(nodes_.size());
+        nodes_.emplace_back();
+    }
+    Node& n = nodes_[idx];
+    n.expires = (deadline_ns + kTickNs - 1) / kTickNs;
+    n.state = State::Armed;
+    n.cb = std::move(cb);
+    insert(idx);
+    ++count_;
+    return (static_cast<uint64_t>(n.generation) << 32) | idx;
+}
+
+bool TimerWheel::cancel(TimerId id) {
+    auto idx = static_cast<uint32_t>(id & 0xFFFFFFFFu);
+    auto gen = static_cast<uint32_t>(id >> 32);
+    if (id == 0 || idx >= nodes_.size()) return false;
+    Node& n = nodes_[idx];
+    if (n.generation != gen || n.state == State::Free) return false;
+    if (n.state == State::Armed) unlink(idx);
+    release(idx);
+    return true;
+}
+
+void TimerWheel::insert(uint32_t idx) {
+    Node& n = nodes_[idx];
+    uint64_t expires = std::max(n.expires, next_tick_);
+    uint64_t delta = expires - next_tick_;
+    int level = 0;
+    while (level < kLevels - 1 && delta >= (1ULL << (kSlotBits * (level + 1)))) ++level;
+    uint64_t max_delta = (1ULL << (kSlotBits * kLevels)) - 1;
+    if (delta > max_delta) expires = next_tick_ + max_delta;
+    auto slot = static_cast<uint32_t>((expires >> (kSlotBits * level)) & (kSlots - 1));
+    uint32_t bucket = level * kSlots + slot;
+    n.bucket = static_cast<uint16_t>(bucket);
+    n.prev = kNil;
+    n.next = heads_[bucket];
+    if (n.next != kNil) nodes_[n.next].prev = idx;
+    heads_[bucket] = idx;
+    occupied_[level] |= 1ULL << slot;
+}
+
+void TimerWheel::unlink(uint32_t idx) {
+    Node& n = nodes_[idx];
+    if (n.prev != kNil)
+        nodes_[n.prev].next = n.next;
+    else
+        heads_[n.bucket] = n.next;
+    if (n.next != kNil) nodes_[n.next].prev = n.prev;
+    if (heads_[n.bucket] == kNil) occupied_[n.bucket / kSlots] &= ~(1ULL << (n.bucket % kSlots));
+    n.prev = n.next = kNil;
+}
+
+void TimerWheel::release(uint32_t idx) {
+    Node& n = nodes_[idx];
+    n.state = State::Free;
+    n.cb = nullptr;
+    ++n.generation;
+    if (n.generation == 0) n.generation = 1;
+    free_.push_back(idx);
+    --count_;
+}
+
+void TimerWheel::cascade(int level, uint32_t slot) {
+    uint32_t bucket = level * kSlots + slot;
+    uint32_t idx = heads_[bucket];
+    heads_[bucket] = kNil;
+    occupied_[level] &= ~(1ULL << slot);
+    while (idx != kNil) {
+        uint32_t next = nodes_[idx].next;
+        insert(idx);
+        idx = next;
+    }
+}
+
+void TimerWheel::process_tick() {
+    uint64_t t = next_tick_;
+    // Higher levels first so their entries can land in the lower slot cascaded next.
+    int top = 0;
+    while (top < kLevels - 1 && ((t >> (kSlotBits * (top + 1))) << (kSlotBits * (top + 1))) == t)
+        ++top;
+    for (int level = top; level >= 1; --level)
+        cascade(level, static_cast<uint32_t>((t >> (kSlotBits * level)) & (kSlots - 1)));
+
+    auto slot = static_cast<uint32_t>(t & (kSlots - 1));
+    uint32_t idx = heads_[slot];
+    heads_[slot] = kNil;
+    occupied_[0] &= ~(1ULL << slot);
+    while (idx != kNil) {
+        Node& n = nodes_[idx];
+        uint32_t next = n.next;
+        n.prev = n.next = kNil;
+        if (n.expires <= t) {
+            n.state = State::Firing;
+            expired_.push_back(idx);
+        } else {
+            insert(idx);  // clamped long timer that still has time to run
+        }
+        idx = next;
+    }
+    ++next_tick_;
+}
+
+size_t TimerWheel::advance(uint64_t now_ns) {
+    uint64_t now_tick = now_ns / kTickNs;
+    expired_.clear();
+    while (next_tick_ <= now_tick) {
+        if (count_ == 0) {
+            next_tick_ = now_tick + 1;
+            break;
+        }
+        // Nothing due at level 0 before the next cascade boundary: skip straight to it.
+        if (occupied_[0] == 0 && (next_tick_ & (kSlots - 1)) != 0) {
+            next_tick_ = std::min(now_tick + 1, (next_tick_ | (kSlots - 1)) + 1);
+            continue;
+        }
+        process_tick();
+    }
+    size_t fired = 0;
+    for (uint32_t idx : expired_) {
+        Node& n = nodes_[idx];
+        if (n.state != State::Firing) continue;  // cancelled by an earlier callback
+        TimerCallback cb = std::move(n.cb);
+        release(idx);
+        ++fired;
+        if (cb) cb();
+    }
+    return fired;
+}
+
+uint64_t TimerWheel::next_deadline_ns() const {
+    if (count_ == 0) return UINT64_MAX;
+    uint64_t best = UINT64_MAX;
+    if (occupied_[0] != 0) {
+        auto start = static_cast<uint32_t>(next_tick_ & (kSlots - 1));
+        best = next_tick_ + static_cast<uint64_t>(rotated_ctz(occupied_[0], start));
+    }
+    for (int level = 1; level < kLevels; ++level) {
+        if (occupied_[level] == 0) continue;
+        int shift = kSlotBits * level;
+        uint64_t base = next_tick_ >> shift;
+        if ((base << shift) != next_tick_) ++base;  // first cascade boundary >= next_tick_
+        auto start = static_cast<uint32_t>(base & (kSlots - 1));
+        uint64_t tick = (base + static_cast<uint64_t>(rotated_ctz(occupied_[level], start)))
+                        << shift;
+        best = std::min(best, tick);
+    }
+    return best == UINT64_MAX ? best : best * kTickNs;
+}
+}  // namespace irr
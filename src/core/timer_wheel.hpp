@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace irr {
+using TimerId = uint64_t;  // 0 is never a valid id
+using TimerCallback = std::function<void()>;
+
+// Hierarchical timing wheel with 1 ms ticks: 4 levels of 64 slots (~4.6 h range; longer
+// deadlines re-cascade). Arm and cancel are O(1); timers live in a slab and are linked into
+// per-slot intrusive lists, with a per-level occupancy bitmap for finding the next deadline.
+// Pure data structure: the owner feeds it the clock (see Reactor).
+class TimerWheel {
+   public:
+    static constexpr uint64_t kTickNs = 1000000;
+
+    explicit TimerWheel(uint64_t now_ns = 0);
+
+    // Deadlines in the past fire on the next advance().
+    TimerId arm(uint64_t deadline_ns, TimerCallback cb);
+    // Returns false if the timer already fired or was cancelled.
+    bool cancel(TimerId id);
+    // Fires every timer whose deadline is <= now_ns; returns how many fired. Callbacks may arm
+    // and cancel timers.
+    size_t advance(uint64_t now_ns);
+    // Earliest time advance() has work to do (an expiry or a cascade); UINT64_MAX when empty.
+    uint64_t next_deadline_ns() const;
+    size_t size() const {
+        return count_;
+    }
+
+   private:
+    static constexpr int kLevels = 4;
+    static constexpr int kSlotBits = 6;
+    static constexpr uint32_t kSlots = 1u << kSlotBits;
+    static constexpr uint32_t kNil = UINT32_MAX;
+
+    enum class State : uint8_t { Free, Armed, Firing };
+
+    struct Node {
+        uint64_t expires{0};  // in ticks
+        uint32_t prev{kNil};
+        uint32_t next{kNil};
+        uint32_t generation{1};
+        uint16_t bucket{0};  // level * kSlots + slot
+        State state{State::Free};
+        TimerCallback cb;
+    };
+
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> free_;
+    uint32_t heads_[kLevels * kSlots];
+    uint64_t occupied_[kLevels]{};
+    uint64_t next_tick_;  // next tick advance() will process
+    size_t count_{0};
+    std::vector<uint32_t> expired_;
+
+    void insert(uint32_t idx);
+    void unlink(uint32_t idx);
+    void release(uint32_t idx);
+    void cascade(int level, uint32_t slot);
+    void process_tick();
+};
+}  // namespace irr
@@ -0,0 +1,38 @@
+#pragma once
+#include <linux/net_tstamp.h>
+#include <sys/socket.h>
+
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+
+namespace irr {
+// Control-buffer space for one SCM_TIMESTAMPING message (three timespecs).
+constexpr size_t kTimestampCmsgSpace = CMSG_SPACE(3 * sizeof(timespec));
+
+// Asks the kernel to stamp packets in software as they are received and to hand the stamp
+// back as SCM_TIMESTAMPING ancillary data. Stamps are CLOCK_REALTIME, so compare them with
+// wall_ns() taken at send time.
+inline bool enable_rx_timestamps(int fd) {
+    int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    return ::setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0;
+}
+
+// Software receive stamp in ns since the epoch from msg's control data, or 0 if there is none.
+inline uint64_t rx_timestamp_ns(msghdr& msg) {
+    for (cmsghdr* c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+        if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_TIMESTAMPING) continue;
+        timespec ts;
+        std::memcpy(&ts, CMSG_DATA(c), sizeof(ts));  // ts[0] is the software stamp
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL +
+               static_cast<uint64_t>(ts.tv_nsec);
+    }
+    return 0;
+}
+
+// Kernel-side RTT in ms from a wall-clock send time and a receive stamp; -1 if unavailable.
+inline double kernel_rtt_ms(uint64_t sent_wall_ns, uint64_t rx_ns) {
+    if (rx_ns == 0 || rx_ns < sent_wall_ns) return -1.0;
+    return (rx_ns - sent_wall_ns) / 1e6;
+}
+}  // namespace irr
@@ -4,13 +4,16 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <thread>
 
 #include "core/event_bus.hpp"
+#include "core/latency_sink.hpp"
 #include "core/logger.hpp"
 #include "core/reactor.hpp"
-#include "core/scheduler_timerfd.hpp"
+#include "core/sink_worker.hpp"
+#include "core/store_columnar.hpp"
 #include "core/store_jsonl.hpp"
 #include "core/time_utils.hpp"
 #include "core/uuid.hpp"
@@ -18,8 +21,10 @@
 #include "probes/icmp_probe.hpp"
 #include "probes/netlink_monitor.hpp"
 #include "probes/pmtu_probe.hpp"
+#include "probes/probe_shard.hpp"
 #include "probes/tcp_connect.hpp"
 #include "report/report_gen.hpp"
+#include "util/format.hpp"
 
 using namespace irr;
 
@@ -27,7 +32,8 @@ static void write_manifest(const std::string& path, const std::string& run_id, i
                            const std::string& profile, const std::vector<TcpTarget>& targets,
                            const std::vector<DnsTarget>& dns_targets,
                            const std::vector<PmtuTarget>& pmtu_targets,
-                           const std::vector<IcmpTarget>& icmp_targets, int interval_ms) {
+                           const std::vector<IcmpTarget>& icmp_targets,
+                           const std::vector<std::string>& resolvers, int interval_ms) {
     std::ofstream out(path + "/run.json");
     out << "{\n";
     out << "  \"run_id\": \"" << run_id << "\",\n";
@@ -38,7 +44,8 @@ static void write_manifest(const std::string& path, const std::string& run_id, i
     out << "  \"targets\": [\n";
     for (size_t i = 0; i < targets.size(); ++i) {
         out << "    {\"name\":\"" << targets[i].name << "\",\"host\":\"" << targets[i].host
-            << "\",\"port\":" << targets[i].port << "}";
+            << "\",\"port\":" << targets[i].port
+            << (targets[i].all_addrs ? ",\"all_addrs\":true}" : "}");
         if (i + 1 < targets.size()) out << ",";
         out << "\n";
     }
@@ -67,6 +74,10 @@ static void write_manifest(const std::string& path, const std::string& run_id, i
         out << "\n";
     }
     out << "  ]\n";
+    out << "  ,\"resolvers\": [";
+    for (size_t i = 0; i < resolvers.size(); ++i)
+        out << (i ? "," : "") << "\"" << resolvers[i] << "\"";
+    out << "]\n";
     out << "}\n";
 }
 
@@ -76,22 +87,31 @@ static int cmd_doctor() {
         std::cout << " - resolv.conf: ok\n";
     else
         std::cout << " - resolv.conf missing\n";
-    int fd = ::socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
+    int fd = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_ICMP);
+    if (fd < 0)
+        std::cout << " - ICMP ping socket: unavailable (see net.ipv4.ping_group_range)\n";
+    else {
+        ::close(fd);
+        std::cout << " - ICMP ping socket: available (no CAP_NET_RAW needed)\n";
+    }
+    fd = ::socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
     if (fd < 0)
         std::cout << " - ICMP raw: unavailable (need CAP_NET_RAW or root)\n";
     else {
         ::close(fd);
         std::cout << " - ICMP raw: available\n";
     }
+    std::cout << " - For ping sockets: sysctl -w net.ipv4.ping_group_range=\"0 2147483647\"\n";
     std::cout << " - For CAP_NET_RAW: try setcap cap_net_raw+ep ./irr\n";
     return 0;
 }
 
-static std::vector<TcpTarget> default_targets(const std::string& profile) {
+static std::vector<TcpTarget> default_targets(const std::string& profile, int interval_ms) {
     if (profile == "home") {
-        return {{"cloudflare", "1.1.1.1", 443, 1000, 2000}, {"google", "8.8.8.8", 443, 1000, 2000}};
+        return {{"cloudflare", "1.1.1.1", 443, interval_ms, 2000},
+                {"google", "8.8.8.8", 443, interval_ms, 2000}};
     }
-    return {{"quad9", "9.9.9.9", 443, 1000, 2000}};
+    return {{"quad9", "9.9.9.9", 443, interval_ms, 2000}};
 }
 
 static std::vector<DnsTarget> default_dns_targets(int interval_ms) {
@@ -111,73 +131,170 @@ static std::vector<IcmpTarget> default_icmp_targets(const std::vector<TcpTarget>
     return out;
 }
 
-static std::string first_resolver() {
+static std::vector<std::string> system_resolvers() {
     std::ifstream in("/etc/resolv.conf");
     std::string line;
+    std::vector<std::string> out;
     while (std::getline(in, line)) {
         if (line.rfind("nameserver", 0) == 0) {
             std::istringstream iss(line);
             std::string tag, ip;
             iss >> tag >> ip;
-            if (!ip.empty()) return ip;
+            if (!ip.empty()) out.push_back(ip);
         }
     }
-    return "1.1.1.1";
+    if (out.empty()) out.push_back("1.1.1.1");
+    return out;
 }
 
-static int cmd_run_parsed(int duration_s, const std::string& out_dir, const std::string& profile,
-                          int interval_ms, bool enable_dns, bool enable_icmp, bool enable_pmtu,
-                          bool enable_netlink) {
-    std::filesystem::create_directories(out_dir);
+struct RunOptions {
+    int duration_s{600};
+    std::string out_dir{"./bundle"};
+    std::string profile{"home"};
+    int interval_ms{1000};
+    bool enable_dns{true};
+    bool enable_icmp{true};
+    bool enable_pmtu{true};
+    bool enable_netlink{true};
+    bool async_bus{false};
+    AsyncBusOptions bus_opts;
+    bool latency_summary{false};
+    CommitPolicy commit_policy;
+    bool columnar{false};
+    int threads{1};
+    bool pin_cpus{false};
+    int epoll_batch{Reactor::kDefaultBatch};
+    ReactorBackend backend{ReactorBackend::Epoll};
+    bool tcp_all_addrs{false};
+    bool kernel_timestamps{false};
+    bool icmp_stateless{false};
+    size_t icmp_payload{0};
+    std::vector<std::string> resolvers;  // --resolver; empty = every resolv.conf nameserver
+};
+
+static void log_bus_stats(const RingStats& st) {
+    log(st.dropped ? LogLevel::WARN : LogLevel::INFO,
+        "event bus: " + std::to_string(st.pushed) + " queued, " + std::to_string(st.dropped) +
+            " dropped, max depth " + std::to_string(st.max_depth) + "/" +
+            std::to_string(st.capacity));
+}
+
+// Per-target latency over the whole run, from the live sketches.
+static void log_latency(const LatencySink& sink) {
+    for (const auto& [name, sketch] : sink.snapshot()) {
+        std::string line = "latency " + name + ": n=" + std::to_string(sketch.size()) + " p50=";
+        append_fixed(line, sketch.quantile(50), 2);
+        line += " p95=";
+        append_fixed(line, sketch.quantile(95), 2);
+        line += " p99=";
+        append_fixed(line, sketch.quantile(99), 2);
+        log(LogLevel::INFO, line + " ms");
+    }
+}
+
+static int cmd_run_parsed(const RunOptions& opt) {
+    std::filesystem::create_directories(opt.out_dir);
     std::string run_id = uuid4();
-    auto targets = default_targets(profile);
-    auto dns_targets = enable_dns ? default_dns_targets(interval_ms) : std::vector<DnsTarget>{};
-    auto pmtu_targets = enable_pmtu ? default_pmtu_targets(targets) : std::vector<PmtuTarget>{};
-    auto icmp_targets =
-        enable_icmp ? default_icmp_targets(targets, interval_ms) : std::vector<IcmpTarget>{};
-    write_manifest(out_dir, run_id, duration_s, profile, targets, dns_targets, pmtu_targets,
-                   icmp_targets, interval_ms);
-
-    EventBus bus;
-    JsonlStore store(out_dir + "/events.jsonl");
-    bus.add_sink(&store);
-
-    Reactor reactor;
-    TimerScheduler scheduler;
-    TimerScheduler pmtu_scheduler;
-    TcpConnectProbe tcp_probe(bus, run_id);
-    DnsProbe dns_probe(bus, run_id);
-    IcmpProbe icmp_probe(bus, run_id);
-    NetlinkMonitor nl(bus, run_id);
-    PmtuProbe pmtu_probe(bus, run_id);
-    dns_probe.set_resolver(first_resolver());
-    if (enable_netlink) nl.start(reactor);
-    scheduler.start(reactor, interval_ms, [&]() {
-        for (const auto& t : targets) tcp_probe.start(reactor, interval_ms, {t});
-        if (enable_dns) dns_probe.tick(reactor, dns_targets);
-        if (enable_icmp && icmp_probe.can_run()) icmp_probe.tick(reactor, icmp_targets);
-    });
-    if (enable_pmtu) pmtu_scheduler.start(reactor, 30000, [&]() { pmtu_probe.tick(pmtu_targets); });
-
-    auto start = std::chrono::steady_clock::now();
-    while (true) {
-        reactor.loop_once(200);
-        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
-                           std::chrono::steady_clock::now() - start)
-                           .count();
-        if (elapsed >= duration_s) break;
-    }
-    scheduler.stop();
-    if (enable_pmtu) pmtu_scheduler.stop();
-    tcp_probe.stop();
-    if (enable_dns) dns_probe.sweep_timeouts();
-    if (enable_netlink) nl.stop();
+    ShardTargets all;
+    all.tcp = default_targets(opt.profile, opt.interval_ms);
+    for (auto& t : all.tcp) t.all_addrs = opt.tcp_all_addrs;
+    if (opt.enable_dns) all.dns = default_dns_targets(opt.interval_ms);
+    if (opt.enable_pmtu) all.pmtu = default_pmtu_targets(all.tcp);
+    if (opt.enable_icmp) all.icmp = default_icmp_targets(all.tcp, opt.interval_ms);
+    all.netlink = opt.enable_netlink;
+    std::vector<std::string> resolvers = opt.resolvers.empty() ? system_resolvers() : opt.resolvers;
+    write_manifest(opt.out_dir, run_id, opt.duration_s, opt.profile, all.tcp, all.dns, all.pmtu,
+                   all.icmp, resolvers, opt.interval_ms);
+
+    JsonlStore store(opt.out_dir + "/events.jsonl", opt.commit_policy);
+    // The live sketches cost a lock and a lookup per event, so on the synchronous path they
+    // only run when asked for; with a sink thread that cost is off the probe threads.
+    LatencySink latency;
+    bool want_latency = opt.latency_summary || opt.async_bus || opt.threads > 1;
+    std::vector<EventSink*> sinks{&store};
+    if (want_latency) sinks.push_back(&latency);
+    std::unique_ptr<ColumnarStore> columnar_store;
+    if (opt.columnar) {
+        columnar_store = std::make_unique<ColumnarStore>(opt.out_dir + "/events.irrc");
+        sinks.push_back(columnar_store.get());
+    }
+    ShardOptions shard_opts;
+    shard_opts.resolvers = resolvers;
+    shard_opts.epoll_batch = opt.epoll_batch;
+    shard_opts.backend = opt.backend;
+    shard_opts.kernel_timestamps = opt.kernel_timestamps;
+    shard_opts.icmp_stateless = opt.icmp_stateless;
+    shard_opts.icmp_payload = opt.icmp_payload;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(opt.duration_s);
+
+    if (opt.threads <= 1) {
+        EventBus bus;
+        for (auto* s : sinks) bus.add_sink(s);
+        if (opt.async_bus && !bus.start_async(opt.bus_opts)) {
+            log(LogLevel::WARN, "async event bus unavailable; delivering events inline");
+        }
+        ProbeShard shard(0, bus, run_id, shard_opts);
+        shard.setup(all);
+        shard.run(deadline);
+        shard.finish();
+        if (bus.is_async()) {
+            bus.stop_async();
+            log_bus_stats(bus.stats());
+        }
+        if (want_latency) log_latency(latency);
+        return 0;
+    }
+
+    // Sharded mode: each reactor thread emits into its own ring and a single SinkWorker
+    // drains all of them into the stores, so shards share no queue and no lock.
+    auto n = static_cast<size_t>(opt.threads);
+    auto parts = partition_targets(all, n);
+    std::vector<std::unique_ptr<EventRing>> rings;
+    std::vector<std::unique_ptr<EventBus>> buses;
+    std::vector<std::unique_ptr<ProbeShard>> shards;
+    std::vector<EventRing*> ring_ptrs;
+    for (size_t i = 0; i < n; ++i) {
+        rings.push_back(std::make_unique<EventRing>(opt.bus_opts.capacity, opt.bus_opts.overflow));
+        buses.push_back(std::make_unique<EventBus>());
+        buses[i]->attach_ring(rings[i].get());
+        ring_ptrs.push_back(rings[i].get());
+        shards.push_back(std::make_unique<ProbeShard>(i, *buses[i], run_id, shard_opts));
+        shards[i]->setup(parts[i]);
+    }
+    SinkWorker worker(ring_ptrs, sinks);
+    if (!worker.start()) return 1;
+    unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < n; ++i) {
+        int cpu = opt.pin_cpus ? static_cast<int>(i % cpus) : -1;
+        if (shards[i]->spawn(deadline, cpu)) continue;
+        // Running this shard inline would hold back every later one until the deadline.
+        log(LogLevel::ERROR, "could not start " + std::to_string(n) + " shard threads; "
+                             "retry with fewer --threads");
+        for (auto& sh : shards) sh->request_stop();
+        for (auto& sh : shards) sh->finish();
+        worker.stop();
+        return 1;
+    }
+    for (auto& sh : shards) sh->finish();
+    worker.stop();
+    RingStats total;
+    for (auto* r : ring_ptrs) {
+        auto st = r->stats();
+        total.capacity += st.capacity;
+        total.depth += st.depth;
+        total.max_depth = std::max(total.max_depth, st.max_depth);
+        total.pushed += st.pushed;
+        total.dropped += st.dropped;
+    }
+    log_bus_stats(total);
+    if (want_latency) log_latency(latency);
     return 0;
 }
 
-static int cmd_report(const std::string& in_dir, const std::string& out_path) {
+static int cmd_report(const std::string& in_dir, const std::string& out_path,
+                      const ReportOptions& opts) {
     ReportStats stats;
-    if (!generate_report(in_dir, out_path, stats)) {
+    if (!generate_report(in_dir, out_path, stats, opts)) {
         std::cerr << "failed to generate report\n";
         return 1;
     }
@@ -189,7 +306,15 @@ static void print_usage() {
     std::cerr << "Usage: irr <run|report|doctor> [options]\n"
               << "  run    --duration <sec> --out <dir> --profile <name> --interval <ms> "
                  "[--no-dns] [--no-icmp] [--no-pmtu] [--no-netlink]\n"
-              << "  report --in <bundle> --out <report.html>\n"
+              << "         [--async-bus] [--bus-capacity <n>] "
+                 "[--bus-overflow block|drop-oldest|drop-newest]\n"
+              << "         [--commit-events <n>] [--commit-ms <ms>] [--fdatasync] [--columnar]\n"
+              << "         [--threads <n>] [--pin-cpus] [--epoll-batch <n>] "
+                 "[--reactor epoll|io_uring] [--tcp-all-addrs]\n"
+              << "         [--kernel-timestamps] [--icmp-stateless] [--icmp-payload <bytes>]\n"
+              << "         [--resolver <ip>]... [--latency-summary]\n"
+              << "  report --in <bundle> --out <report.html> [--threads <n>]\n"
+              << "         [--relative-error <a>] [--exact] [--no-checkpoint]\n"
               << "  doctor (no args)\n";
 }
 
@@ -205,45 +330,96 @@ int main(int argc, char** argv) {
     }
     if (cmd == "doctor") return cmd_doctor();
     if (cmd == "run") {
-        int duration_s = 600;
-        std::string out_dir = "./bundle";
-        std::string profile = "home";
-        int interval_ms = 1000;
-        bool enable_dns = true, enable_icmp = true, enable_pmtu = true, enable_netlink = true;
+        RunOptions opt;
         for (int i = 2; i < argc; ++i) {
             std::string a = argv[i];
             if (a == "--duration" && i + 1 < argc) {
-                duration_s = std::stoi(argv[++i]);
+                opt.duration_s = std::stoi(argv[++i]);
             } else if (a == "--out" && i + 1 < argc) {
-                out_dir = argv[++i];
+                opt.out_dir = argv[++i];
             } else if (a == "--profile" && i + 1 < argc) {
-                profile = argv[++i];
+                opt.profile = argv[++i];
             } else if ((a == "--interval" || a == "--interval-ms") && i + 1 < argc) {
-                interval_ms = std::stoi(argv[++i]);
+                opt.interval_ms = std::stoi(argv[++i]);
             } else if (a == "--no-dns") {
-                enable_dns = false;
+                opt.enable_dns = false;
             } else if (a == "--no-icmp") {
-                enable_icmp = false;
+                opt.enable_icmp = false;
             } else if (a == "--no-pmtu") {
-                enable_pmtu = false;
+                opt.enable_pmtu = false;
             } else if (a == "--no-netlink") {
-                enable_netlink = false;
+                opt.enable_netlink = false;
+            } else if (a == "--async-bus") {
+                opt.async_bus = true;
+            } else if (a == "--latency-summary") {
+                opt.latency_summary = true;
+            } else if (a == "--bus-capacity" && i + 1 < argc) {
+                opt.bus_opts.capacity = static_cast<size_t>(std::stoul(argv[++i]));
+            } else if (a == "--bus-overflow" && i + 1 < argc) {
+                if (!parse_overflow_policy(argv[++i], opt.bus_opts.overflow)) {
+                    std::cerr << "Unknown overflow policy: " << argv[i] << "\n";
+                    return 1;
+                }
+            } else if (a == "--commit-events" && i + 1 < argc) {
+                opt.commit_policy.max_events = static_cast<size_t>(std::stoul(argv[++i]));
+            } else if (a == "--commit-ms" && i + 1 < argc) {
+                opt.commit_policy.max_delay_ms = std::stoi(argv[++i]);
+            } else if (a == "--fdatasync") {
+                opt.commit_policy.fdatasync = true;
+            } else if (a == "--columnar") {
+                opt.columnar = true;
+            } else if (a == "--threads" && i + 1 < argc) {
+                opt.threads = std::max(1, std::stoi(argv[++i]));
+            } else if (a == "--pin-cpus") {
+                opt.pin_cpus = true;
+            } else if (a == "--epoll-batch" && i + 1 < argc) {
+                opt.epoll_batch = std::max(1, std::stoi(argv[++i]));
+            } else if (a == "--reactor" && i + 1 < argc) {
+                if (!parse_reactor_backend(argv[++i], opt.backend)) {
+                    std::cerr << "Unknown reactor backend: " << argv[i] << "\n";
+                    return 1;
+                }
+            } else if (a == "--tcp-all-addrs") {
+                opt.tcp_all_addrs = true;
+            } else if (a == "--kernel-timestamps") {
+                opt.kernel_timestamps = true;
+            } else if (a == "--icmp-stateless") {
+                opt.icmp_stateless = true;
+            } else if (a == "--icmp-payload" && i + 1 < argc) {
+                opt.icmp_payload = static_cast<size_t>(std::stoul(argv[++i]));
+            } else if (a == "--resolver" && i + 1 < argc) {
+                opt.resolvers.push_back(argv[++i]);
             }
         }
-        return cmd_run_parsed(duration_s, out_dir, profile, interval_ms, enable_dns, enable_icmp,
-                              enable_pmtu, enable_netlink);
+        return cmd_run_parsed(opt);
     }
     if (cmd == "report") {
         std::string in_dir = "./bundle";
         std::string out = "./bundle/report.html";
+        ReportOptions ropt;
         for (int i = 2; i < argc; ++i) {
             std::string a = argv[i];
-            if (a == "--in" && i + 1 < argc)
+            if (a == "--in" && i + 1 < argc) {
                 in_dir = argv[++i];
-            else if (a == "--out" && i + 1 < argc)
+            } else if (a == "--out" && i + 1 < argc) {
                 out = argv[++i];
+            } else if (a == "--threads" && i + 1 < argc) {
+                ropt.threads = static_cast<unsigned>(std::stoul(argv[++i]));
+            } else if (a == "--relative-error" && i + 1 < argc) {
+                ropt.relative_error = std::stod(argv[++i]);
+                // Also rejects NaN.
+                if (!(ropt.relative_error > 0 && ropt.relative_error <= 0.5)) {
+                    std::cerr << "--relative-error must be in (0, 0.5]: " << argv[i] << "\n";
+                    print_usage();
+                    return 1;
+                }
+            } else if (a == "--exact") {
+                ropt.exact = true;
+            } else if (a == "--no-checkpoint") {
+                ropt.checkpoint = false;
+            }
         }
-        return cmd_report(in_dir, out);
+        return cmd_report(in_dir, out, ropt);
     }
     std::cerr << "Unknown command\n";
     return 1;
@@ -0,0 +1,154 @@
+#pragma once
+#include <sys/socket.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace irr {
+// Summary of one DNS message, read in place from the receive buffer: no copies of names and
+// no allocation. Every length, offset and compression pointer is checked against the buffer.
+struct DnsMessage {
+    static constexpr size_t kMaxAddrs = 8;
+
+    uint16_t id;
+    bool response;   // QR
+    bool truncated;  // TC: the answer did not fit, ask again over TCP
+    int rcode;       // header RCODE, widened by the EDNS0 extended RCODE when present
+    uint16_t qdcount;
+    uint16_t ancount;
+    uint16_t nscount;
+    uint16_t arcount;
+    size_t question_off;  // first question (name, type, class) as it appears on the wire
+    size_t question_len;
+    uint16_t addr_count;  // A and AAAA records in the answer section
+    uint8_t addr_family[kMaxAddrs];  // AF_INET or AF_INET6, for the first kMaxAddrs of them
+    uint8_t addrs[kMaxAddrs][16];
+    // Lowest TTL in the answer section or, without answers, the negative-caching TTL of an
+    // authority SOA (min of its TTL and MINIMUM); -1 if neither is present.
+    int64_t min_ttl;
+    bool edns;
+    uint16_t udp_size;  // EDNS0 requestor payload size
+};
+
+namespace dns_detail {
+inline uint16_t rd16(const uint8_t* p) {
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+inline uint32_t rd32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+// RFC 2181: a TTL with the top bit set is treated as zero.
+inline int64_t ttl_value(uint32_t ttl) {
+    return ttl & 0x80000000U ? 0 : static_cast<int64_t>(ttl);
+}
+}  // namespace dns_detail
+
+// Validates the possibly compressed name at off (labels, pointers, 255-byte limit) and returns
+// the offset just past it in the record, or 0 if it is malformed. Pointers must point strictly
+// backwards, so a pointer loop cannot keep the walk going.
+inline size_t dns_skip_name(const uint8_t* data, size_t len, size_t off) {
+    size_t end = 0;
+    size_t total = 1;
+    size_t p = off;
+    while (p < len) {
+        uint8_t b = data[p];
+        if ((b & 0xC0) == 0xC0) {
+            if (p + 1 >= len) return 0;
+            size_t target = (static_cast<size_t>(b & 0x3F) << 8) | data[p + 1];
+            if (target >= p) return 0;
+            if (end == 0) end = p + 2;
+            p = target;
+            continue;
+        }
+        if (b & 0xC0) return 0;  // extended label types are obsolete
+        if (b == 0) return end ? end : p + 1;
+        total += 1u + b;
+        if (total > 255) return 0;
+        p += 1u + b;
+    }
+    return 0;
+}
+
+// Parses header, questions and all three record sections. Header fields are filled in even
+// when the body turns out to be malformed, in which case the result is false.
+inline bool parse_dns_message(const uint8_t* data, size_t len, DnsMessage& out) {
+    using dns_detail::rd16;
+    using dns_detail::rd32;
+    std::memset(&out, 0, sizeof(out));
+    out.min_ttl = -1;
+    if (len < 12) return false;
+    out.id = rd16(data);
+    out.response = data[2] & 0x80;
+    out.truncated = data[2] & 0x02;
+    out.rcode = data[3] & 0x0F;
+    out.qdcount = rd16(data + 4);
+    out.ancount = rd16(data + 6);
+    out.nscount = rd16(data + 8);
+    out.arcount = rd16(data + 10);
+
+    size_t off = 12;
+    for (uint16_t i = 0; i < out.qdcount; ++i) {
+        size_t name_end = dns_skip_name(data, len, off);
+        if (name_end == 0 || name_end + 4 > len) return false;
+        if (i == 0) {
+            out.question_off = off;
+            out.question_len = name_end + 4 - off;
+        }
+        off = name_end + 4;
+    }
+
+    int64_t answer_ttl = -1;
+    int64_t negative_ttl = -1;
+    uint32_t records = static_cast<uint32_t>(out.ancount) + out.nscount + out.arcount;
+    for (uint32_t r = 0; r < records; ++r) {
+        size_t name_end = dns_skip_name(data, len, off);
+        if (name_end == 0 || name_end + 10 > len) return false;
+        const uint8_t* rr = data + name_end;
+        uint16_t type = rd16(rr);
+        uint16_t klass = rd16(rr + 2);
+        uint32_t ttl = rd32(rr + 4);
+        size_t rdlen = rd16(rr + 8);
+        size_t rdata = name_end + 10;
+        if (rdata + rdlen > len) return false;
+        if (r < out.ancount) {
+            int64_t t = dns_detail::ttl_value(ttl);
+            if (answer_ttl < 0 || t < answer_ttl) answer_ttl = t;
+            bool a = type == 1 && rdlen == 4;
+            bool aaaa = type == 28 && rdlen == 16;
+            if (klass == 1 && (a || aaaa)) {
+                if (out.addr_count < DnsMessage::kMaxAddrs) {
+                    out.addr_family[out.addr_count] = a ? AF_INET : AF_INET6;
+                    std::memcpy(out.addrs[out.addr_count], data + rdata, rdlen);
+                }
+                ++out.addr_count;
+            }
+        } else if (r < static_cast<uint32_t>(out.ancount) + out.nscount) {
+            if (type == 6) {  // SOA: MNAME, RNAME, then SERIAL REFRESH RETRY EXPIRE MINIMUM
+                size_t p = dns_skip_name(data, rdata + rdlen, rdata);
+                if (p) p = dns_skip_name(data, rdata + rdlen, p);
+                // A malformed SOA only costs its negative TTL, not the rest of the reply.
+                if (p == 0 || p + 20 != rdata + rdlen) {
+                    off = rdata + rdlen;
+                    continue;
+                }
+                int64_t t = dns_detail::ttl_value(ttl);
+                int64_t minimum = dns_detail::ttl_value(rd32(data + p + 16));
+                int64_t neg = t < minimum ? t : minimum;
+                if (negative_ttl < 0 || neg < negative_ttl) negative_ttl = neg;
+            }
+        } else if (type == 41) {  // EDNS0 OPT: owner is the root, CLASS the payload size
+            if (name_end != off + 1 || data[off] != 0) return false;
+            out.edns = true;
+            out.udp_size = klass;
+            out.rcode |= static_cast<int>((ttl >> 24) & 0xFF) << 4;
+        }
+        off = rdata + rdlen;
+    }
+    out.min_ttl = answer_ttl >= 0 ? answer_ttl : negative_ttl;
+    return true;
+}
+}  // namespace irr
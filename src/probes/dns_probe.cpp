@@ -1,208 +1,607 @@
 #include "dns_probe.hpp"
 
 #include <arpa/inet.h>
-#include <fcntl.h>
 #include <netinet/in.h>
 #include <sys/epoll.h>
-#include <sys/select.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <cctype>
 #include <cerrno>
 #include <cstring>
 #include <random>
 
 #include "../core/logger.hpp"
+#include "../core/timestamping.hpp"
 
 namespace irr {
 namespace {
+// Without EDNS a UDP answer is at most 512 bytes; leave room for servers that ignore that.
+constexpr size_t kMaxReply = 1500;
+constexpr size_t kMaxQuery = 512;
+// EDNS0 payload size we advertise: the DNS Flag Day 2020 value, safe from fragmentation.
+constexpr uint16_t kEdnsUdpSize = 1232;
+
 uint16_t make_id() {
     static thread_local std::mt19937 rng{std::random_device{}()};
     return static_cast<uint16_t>(rng());
 }
 
-std::vector<uint8_t> build_query(uint16_t id, const std::string& qname) {
-    std::vector<uint8_t> buf;
-    buf.resize(12);  // header
-    buf[0] = id >> 8;
-    buf[1] = id & 0xff;
-    buf[2] = 0x01;  // recursion desired
-    buf[3] = 0x00;
-    buf[4] = 0x00;
-    buf[5] = 0x01;  // QDCOUNT=1
-    buf[6] = buf[7] = buf[8] = buf[9] = buf[10] = buf[11] = 0;
-    // qname labels
-    size_t pos = 12;
+uint32_t inflight_key(size_t resolver, size_t sock, uint16_t id) {
+    return (static_cast<uint32_t>(resolver) << 24) | (static_cast<uint32_t>(sock) << 16) | id;
+}
+
+// Wire-format question for an A query (labels, root, QTYPE, QCLASS); empty if qname has an
+// empty or over-long label.
+std::string encode_question(const std::string& qname) {
+    std::string out;
     size_t start = 0;
     while (start < qname.size()) {
         size_t dot = qname.find('.', start);
         if (dot == std::string::npos) dot = qname.size();
         size_t len = dot - start;
-        buf.push_back(static_cast<uint8_t>(len));
-        for (size_t i = 0; i < len; ++i) buf.push_back(static_cast<uint8_t>(qname[start + i]));
+        if (len == 0 || len > 63) return {};
+        out.push_back(static_cast<char>(len));
+        out.append(qname, start, len);
         start = dot + 1;
     }
-    buf.push_back(0);  // end of name
-    buf.push_back(0);
-    buf.push_back(1);  // QTYPE A
-    buf.push_back(0);
-    buf.push_back(1);  // QCLASS IN
-    return buf;
+    out.push_back('\0');                   // end of name
+    out.append("\x00\x01\x00\x01", 4);  // QTYPE A, QCLASS IN
+    return out;
 }
 
-int rcode_from_response(const uint8_t* data, size_t len) {
-    if (len < 12) return -1;
-    return data[3] & 0x0F;
+// Writes a single-question query with an EDNS0 OPT record into buf; returns the length or 0
+// if it does not fit.
+size_t build_query(uint8_t* buf, size_t cap, uint16_t id, const std::string& question) {
+    constexpr size_t kOptLen = 11;
+    if (question.empty() || cap < 12 + question.size() + kOptLen) return 0;
+    buf[0] = id >> 8;
+    buf[1] = id & 0xff;
+    buf[2] = 0x01;  // recursion desired
+    buf[3] = 0x00;
+    buf[4] = 0x00;
+    buf[5] = 0x01;  // QDCOUNT=1
+    buf[6] = buf[7] = buf[8] = buf[9] = buf[10] = 0;
+    buf[11] = 0x01;  // ARCOUNT=1
+    std::memcpy(buf + 12, question.data(), question.size());
+    uint8_t* opt = buf + 12 + question.size();
+    opt[0] = 0;  // root owner
+    opt[1] = 0;
+    opt[2] = 41;  // TYPE OPT
+    opt[3] = kEdnsUdpSize >> 8;
+    opt[4] = kEdnsUdpSize & 0xff;
+    std::memset(opt + 5, 0, 6);  // extended RCODE, version, flags, RDLEN
+    return 12 + question.size() + kOptLen;
+}
+
+// The reply must echo our question. Names compare case-insensitively (resolvers may apply
+// 0x20 randomisation); length, type and class bytes are never letters, so one pass does it.
+bool question_matches(const uint8_t* data, size_t len, const std::string& question) {
+    if (len < 12 + question.size() || data[4] != 0 || data[5] != 1) return false;
+    for (size_t i = 0; i < question.size(); ++i) {
+        auto a = static_cast<unsigned char>(data[12 + i]);
+        auto b = static_cast<unsigned char>(question[i]);
+        if (a != b && std::tolower(a) != std::tolower(b)) return false;
+    }
+    return true;
+}
+
+uint16_t port_of(const sockaddr_storage& ss) {
+    // sin_port and sin6_port share an offset.
+    return ntohs(reinterpret_cast<const sockaddr_in&>(ss).sin_port);
+}
+
+bool same_endpoint(const sockaddr_storage& a, const sockaddr_storage& b) {
+    if (a.ss_family != b.ss_family || port_of(a) != port_of(b)) return false;
+    if (a.ss_family == AF_INET) {
+        return reinterpret_cast<const sockaddr_in&>(a).sin_addr.s_addr ==
+               reinterpret_cast<const sockaddr_in&>(b).sin_addr.s_addr;
+    }
+    return std::memcmp(&reinterpret_cast<const sockaddr_in6&>(a).sin6_addr,
+                       &reinterpret_cast<const sockaddr_in6&>(b).sin6_addr,
+                       sizeof(in6_addr)) == 0;
+}
+
+bool parse_endpoint(const std::string& ip, int port, sockaddr_storage& ss, socklen_t& len) {
+    ss = {};
+    auto* sin = reinterpret_cast<sockaddr_in*>(&ss);
+    auto* sin6 = reinterpret_cast<sockaddr_in6*>(&ss);
+    if (::inet_pton(AF_INET, ip.c_str(), &sin->sin_addr) == 1) {
+        sin->sin_family = AF_INET;
+        sin->sin_port = htons(static_cast<uint16_t>(port));
+        len = sizeof(sockaddr_in);
+        return true;
+    }
+    if (::inet_pton(AF_INET6, ip.c_str(), &sin6->sin6_addr) == 1) {
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_port = htons(static_cast<uint16_t>(port));
+        len = sizeof(sockaddr_in6);
+        return true;
+    }
+    return false;
 }
 }  // namespace
 
-DnsProbe::DnsProbe(EventBus& bus, const std::string& run_id) : bus_(bus), run_id_(run_id) {}
+DnsProbe::DnsProbe(EventBus& bus, const std::string& run_id)
+    : bus_(bus), run_id_(symbols().intern(run_id)) {}
 
-void DnsProbe::set_resolver(const std::string& ip, int port) {
-    resolver_ip_ = ip;
+void DnsProbe::set_resolvers(const std::vector<std::string>& ips, int port) {
+    resolver_ips_ = ips;
     resolver_port_ = port;
 }
 
-void DnsProbe::tick(Reactor& r, const std::vector<DnsTarget>& targets) {
+void DnsProbe::start(Reactor& r, const std::vector<DnsTarget>& targets) {
     reactor_ = &r;
-    for (const auto& t : targets) send_udp_query(r, t);
-    sweep_timeouts();
-}
-
-void DnsProbe::send_udp_query(Reactor& r, const DnsTarget& t) {
-    int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
-    if (fd < 0) return;
-    sockaddr_in sa{};
-    sa.sin_family = AF_INET;
-    sa.sin_port = htons(resolver_port_);
-    if (::inet_pton(AF_INET, resolver_ip_.c_str(), &sa.sin_addr) != 1) {
-        ::close(fd);
-        return;
+    targets_ = targets;
+    target_names_.clear();
+    target_questions_.clear();
+    for (const auto& t : targets_) {
+        target_names_.push_back(symbols().intern(t.name));
+        target_questions_.push_back(encode_question(t.qname));
+        if (target_questions_.back().empty())
+            log(LogLevel::WARN, "dns target " + t.name + ": invalid qname: " + t.qname);
     }
-    uint16_t id = make_id();
-    auto pkt = build_query(id, t.qname);
-    ssize_t n =
-        ::sendto(fd, pkt.data(), pkt.size(), 0, reinterpret_cast<sockaddr*>(&sa), sizeof(sa));
-    if (n < 0) {
-        ::close(fd);
-        emit_event({fd, id, monotonic_ns(), t.name, t.qname, t.timeout_ms}, false, 0.0,
-                   "send_fail");
-        return;
+    rx_buf_.resize(kBatch * kMaxReply);
+    rx_control_.resize(kBatch * kTimestampCmsgSpace);
+    resolvers_.clear();
+    if (targets_.empty()) return;
+    for (const auto& ip : resolver_ips_) {
+        Resolver res;
+        if (!parse_endpoint(ip, resolver_port_, res.addr, res.len)) {
+            log(LogLevel::WARN, "dns resolver is not an IP address: " + ip);
+            continue;
+        }
+        bool dup = std::any_of(resolvers_.begin(), resolvers_.end(),
+                               [&](const Resolver& o) { return same_endpoint(o.addr, res.addr); });
+        if (dup) continue;
+        if (resolvers_.size() == kMaxResolvers) {
+            log(LogLevel::WARN, "dns: probing only the first " + std::to_string(kMaxResolvers) +
+                                    " resolvers");
+            break;
+        }
+        bool v6 = res.addr.ss_family == AF_INET6;
+        res.ip = ip;
+        res.sym = symbols().intern(ip);
+        res.family = symbols().intern(v6 ? "inet6" : "inet");
+        res.pool = v6 ? 1 : 0;
+        resolvers_.push_back(std::move(res));
     }
-    Attempt a{fd, id, monotonic_ns(), t.name, t.qname, t.timeout_ms};
-    inflight_[fd] = a;
-    r.add_fd(fd, EPOLLIN, [this, fd](uint32_t) { handle_response(fd); });
-}
-
-void DnsProbe::handle_response(int fd) {
-    uint8_t buf[1500];
-    sockaddr_in from{};
-    socklen_t flen = sizeof(from);
-    ssize_t n = ::recvfrom(fd, buf, sizeof(buf), 0, reinterpret_cast<sockaddr*>(&from), &flen);
-    auto it = inflight_.find(fd);
-    if (n <= 0 || it == inflight_.end()) {
-        reactor_->del_fd(fd);
-        ::close(fd);
-        inflight_.erase(fd);
-        return;
+    for (size_t pool = 0; pool < 2; ++pool) {
+        bool used = std::any_of(resolvers_.begin(), resolvers_.end(),
+                                [pool](const Resolver& res) { return res.pool == pool; });
+        if (used && !open_pool(pool))
+            log(LogLevel::WARN, "dns: could not open the UDP socket pool");
     }
-    int rcode = rcode_from_response(buf, static_cast<size_t>(n));
-    double ms = (monotonic_ns() - it->second.start_ns) / 1e6;
-    bool ok = (rcode == 0);
-    emit_event(it->second, ok, ms, ok ? "" : "dns_rcode", rcode);
-    reactor_->del_fd(fd);
-    ::close(fd);
-    inflight_.erase(fd);
 }
 
-void DnsProbe::sweep_timeouts() {
-    uint64_t now = monotonic_ns();
-    for (auto it = inflight_.begin(); it != inflight_.end();) {
-        auto& a = it->second;
-        double elapsed_ms = (now - a.start_ns) / 1e6;
-        if (elapsed_ms > a.timeout_ms) {
-            bool fallback_ok = false;
-            if (!a.tcp_fallback_attempted) {
-                a.tcp_fallback_attempted = true;
-                // attempt TCP fallback synchronously within timeout window
-                fallback_ok = tcp_fallback({a.target_name, a.qname, a.timeout_ms, a.timeout_ms}, a);
+bool DnsProbe::open_pool(size_t pool) {
+    int family = pool ? AF_INET6 : AF_INET;
+    for (size_t i = pool * kPoolSize; i < (pool + 1) * kPoolSize; ++i) {
+        Fd& s = sock_[i];
+        s.reset(::socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0));
+        if (!s) return false;
+        if (kernel_ts_ && !enable_rx_timestamps(s.get())) {
+            log(LogLevel::WARN, "dns: kernel timestamps unavailable");
+            kernel_ts_ = false;
+        }
+        // Port 0: the kernel picks a random free ephemeral port for each socket.
+        sockaddr_storage local{};
+        local.ss_family = static_cast<sa_family_t>(family);
+        socklen_t len = pool ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+        if (::bind(s.get(), reinterpret_cast<sockaddr*>(&local), len) < 0) {
+            s.reset();
+            return false;
+        }
+        reactor_->add_fd(s.get(), EPOLLIN, [this, i](uint32_t) { handle_recv(i); });
+    }
+    return true;
+}
+
+void DnsProbe::fire(size_t idx) {
+    if (!reactor_ || idx >= targets_.size() || resolvers_.empty()) return;
+    uint32_t round = 0;
+    if (resolvers_.size() > 1) {
+        round = next_round_++;
+        if (next_round_ == 0) next_round_ = 1;
+        rounds_[round] = Round{resolvers_.size(), 0};
+    }
+    for (size_t r = 0; r < resolvers_.size(); ++r) pending_.push_back({idx, r, round});
+    if (!flush_posted_) {
+        flush_posted_ = true;
+        reactor_->post([this]() { flush(); });
+    }
+}
+
+void DnsProbe::tick() {
+    for (size_t i = 0; i < targets_.size(); ++i) fire(i);
+}
+
+void DnsProbe::stop() {
+    if (reactor_) {
+        for (auto& kv : inflight_) reactor_->cancel_timer(kv.second.timer);
+        for (auto& res : resolvers_)
+            for (auto& kv : res.fallback) reactor_->cancel_timer(kv.second.timer);
+    }
+    inflight_.clear();
+    rounds_.clear();
+    pending_.clear();
+    if (rejected_ > 0)
+        log(LogLevel::INFO, "dns: rejected " + std::to_string(rejected_) + " replies");
+    for (size_t r = 0; r < resolvers_.size() && resolvers_.size() > 1; ++r) {
+        const ResolverStats& st = resolvers_[r].stats;
+        log(LogLevel::INFO, "dns: resolver " + resolvers_[r].ip + ": " + std::to_string(st.sent) +
+                                " sent, " + std::to_string(st.answered) + " answered, " +
+                                std::to_string(st.failed) + " failed, first in " +
+                                std::to_string(st.first) + " rounds");
+    }
+    for (size_t r = 0; r < resolvers_.size(); ++r) {
+        resolvers_[r].fallback.clear();
+        if (reactor_) tcp_close(r);
+    }
+    if (!reactor_) return;
+    for (auto& s : sock_)
+        if (s) reactor_->del_fd(s.get());
+}
+
+void DnsProbe::flush() {
+    flush_posted_ = false;
+    // Messages to every resolver of a family share that family's pool. Each batch leaves
+    // from the next socket in it, spreading txids over source ports.
+    Job batch[kBatch];
+    for (size_t pool = 0; pool < 2; ++pool) {
+        size_t n = 0;
+        for (const Job& j : pending_) {
+            if (resolvers_[j.resolver].pool != pool) continue;
+            batch[n++] = j;
+            if (n < kBatch) continue;
+            send_batch(pool * kPoolSize + next_sock_[pool]++ % kPoolSize, batch, n);
+            n = 0;
+        }
+        if (n > 0) send_batch(pool * kPoolSize + next_sock_[pool]++ % kPoolSize, batch, n);
+    }
+    pending_.clear();
+}
+
+void DnsProbe::send_batch(size_t sock, const Job* jobs, size_t count) {
+    mmsghdr msgs[kBatch];
+    iovec iov[kBatch];
+    uint8_t pkts[kBatch][kMaxQuery];
+    uint32_t keys[kBatch];
+    std::memset(msgs, 0, sizeof(msgs));
+    uint64_t start = monotonic_ns();
+    uint64_t start_wall = wall_ns();
+    size_t n = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const Job& j = jobs[i];
+        Resolver& res = resolvers_[j.resolver];
+        Attempt a{j.idx, j.resolver, make_id(), start, start_wall, target_names_[j.idx],
+                  targets_[j.idx].timeout_ms, j.round};
+        if (j.round) {
+            auto it = rounds_.find(j.round);
+            if (it != rounds_.end() && it->second.start_ns == 0) it->second.start_ns = start;
+        }
+        ++res.stats.sent;
+        // A txid already waiting on this socket would make the two replies indistinguishable.
+        for (int tries = 0; inflight_.count(inflight_key(j.resolver, sock, a.id)) && tries < 8;
+             ++tries)
+            a.id = make_id();
+        uint32_t key = inflight_key(j.resolver, sock, a.id);
+        size_t len = build_query(pkts[n], kMaxQuery, a.id, target_questions_[j.idx]);
+        if (!sock_[sock] || len == 0 || inflight_.count(key)) {
+            emit_event(a, false, 0.0, ErrorCode::SendFail);
+            continue;
+        }
+        inflight_.emplace(key, a);  // reserves the txid for the rest of the batch
+        iov[n] = {pkts[n], len};
+        msgs[n].msg_hdr.msg_name = &res.addr;
+        msgs[n].msg_hdr.msg_namelen = res.len;
+        msgs[n].msg_hdr.msg_iov = &iov[n];
+        msgs[n].msg_hdr.msg_iovlen = 1;
+        keys[n++] = key;
+    }
+    for (size_t off = 0; off < n;) {
+        int sent = ::sendmmsg(sock_[sock].get(), msgs + off, static_cast<unsigned>(n - off), 0);
+        if (sent <= 0) {
+            // The first message failed; report it and carry on with the rest.
+            auto it = inflight_.find(keys[off++]);
+            Attempt a = it->second;
+            inflight_.erase(it);
+            emit_event(a, false, 0.0, ErrorCode::SendFail);
+            continue;
+        }
+        for (int j = 0; j < sent; ++j) {
+            uint32_t key = keys[off++];
+            Attempt& a = inflight_.find(key)->second;
+            a.timer = reactor_->add_timer(start + static_cast<uint64_t>(a.timeout_ms) * 1000000ULL,
+                                          [this, key]() { handle_timeout(key); });
+        }
+    }
+}
+
+void DnsProbe::handle_recv(size_t sock) {
+    mmsghdr msgs[kBatch];
+    iovec iov[kBatch];
+    sockaddr_storage from[kBatch];
+    // Drain what is queued, bounded so one busy socket cannot starve the loop.
+    for (int round = 0; round < 4; ++round) {
+        std::memset(msgs, 0, sizeof(msgs));
+        for (size_t i = 0; i < kBatch; ++i) {
+            iov[i] = {rx_buf_.data() + i * kMaxReply, kMaxReply};
+            msgs[i].msg_hdr.msg_name = &from[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            if (kernel_ts_) {
+                msgs[i].msg_hdr.msg_control = rx_control_.data() + i * kTimestampCmsgSpace;
+                msgs[i].msg_hdr.msg_controllen = kTimestampCmsgSpace;
             }
-            emit_event(a, fallback_ok, elapsed_ms,
-                       fallback_ok ? "tcp_fallback_success" : "timeout");
-            reactor_->del_fd(it->first);
-            ::close(it->first);
-            it = inflight_.erase(it);
-        } else {
-            ++it;
         }
+        int n = ::recvmmsg(sock_[sock].get(), msgs, kBatch, MSG_DONTWAIT, nullptr);
+        if (n <= 0) return;
+        for (int i = 0; i < n; ++i) {
+            uint64_t rx_ns = kernel_ts_ ? rx_timestamp_ns(msgs[i].msg_hdr) : 0;
+            on_reply(sock, rx_buf_.data() + i * kMaxReply, msgs[i].msg_len, from[i], rx_ns);
+        }
+        if (static_cast<size_t>(n) < kBatch) return;
     }
 }
 
-bool DnsProbe::tcp_fallback(const DnsTarget& t, Attempt& a) {
-    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
-    if (fd < 0) return false;
-    sockaddr_in sa{};
-    sa.sin_family = AF_INET;
-    sa.sin_port = htons(resolver_port_);
-    if (::inet_pton(AF_INET, resolver_ip_.c_str(), &sa.sin_addr) != 1) {
-        ::close(fd);
-        return false;
+void DnsProbe::on_reply(size_t sock, const uint8_t* data, size_t len,
+                        const sockaddr_storage& from, uint64_t rx_ns) {
+    // Source, a well-formed response, txid on this socket, then the echoed question. A
+    // truncated answer may end mid-record, so only its header has to parse.
+    size_t r = 0;
+    while (r < resolvers_.size() && !same_endpoint(from, resolvers_[r].addr)) ++r;
+    DnsMessage msg;
+    bool parsed = parse_dns_message(data, len, msg);
+    if (r == resolvers_.size() || !(parsed || msg.truncated) || !msg.response) {
+        ++rejected_;
+        return;
+    }
+    auto it = inflight_.find(inflight_key(r, sock, msg.id));
+    if (it == inflight_.end() ||
+        !question_matches(data, len, target_questions_[it->second.idx])) {
+        ++rejected_;  // includes late replies to queries that already timed out
+        return;
     }
-    // set non-blocking connect with timeout using select
-    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
-    int rc = ::connect(fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa));
+    Attempt a = it->second;
+    reactor_->cancel_timer(a.timer);
+    inflight_.erase(it);
+    if (msg.truncated) {
+        // The answer did not fit a datagram: ask over TCP now rather than at the deadline.
+        start_fallback(a);
+        return;
+    }
+    double ms = (monotonic_ns() - a.start_ns) / 1e6;
+    bool ok = (msg.rcode == 0);
+    emit_event(a, ok, ms, ok ? ErrorCode::None : ErrorCode::DnsRcode, msg.rcode,
+               kernel_rtt_ms(a.start_wall_ns, rx_ns), &msg);
+}
+
+void DnsProbe::handle_timeout(uint32_t key) {
+    auto it = inflight_.find(key);
+    if (it == inflight_.end()) return;
+    Attempt a = it->second;
+    inflight_.erase(it);
+    start_fallback(a);
+}
+
+void DnsProbe::start_fallback(Attempt a) {
+    Resolver& res = resolvers_[a.resolver];
+    // Txids must be unique on the connection; the UDP id may clash with another socket's.
+    for (int tries = 0; res.fallback.count(a.id) && tries < 8; ++tries) a.id = make_id();
+    uint8_t framed[kMaxQuery + 2];
+    size_t qlen = build_query(framed + 2, kMaxQuery, a.id, target_questions_[a.idx]);
+    if (qlen == 0 || res.fallback.count(a.id) || (!res.tcp.fd && !tcp_connect(a.resolver))) {
+        emit_event(a, false, (monotonic_ns() - a.start_ns) / 1e6, ErrorCode::Timeout);
+        return;
+    }
+    framed[0] = static_cast<uint8_t>(qlen >> 8);
+    framed[1] = static_cast<uint8_t>(qlen & 0xff);
+    res.tcp.out.insert(res.tcp.out.end(), framed, framed + qlen + 2);
+    size_t r = a.resolver;
+    uint16_t id = a.id;
+    a.timer = reactor_->add_timer(monotonic_ns() + static_cast<uint64_t>(a.timeout_ms) * 1000000ULL,
+                                  [this, r, id]() { handle_fallback_timeout(r, id); });
+    res.fallback.emplace(id, a);
+    if (res.tcp.connected && !tcp_flush(r)) tcp_fail(r);
+}
+
+bool DnsProbe::tcp_connect(size_t r) {
+    Resolver& res = resolvers_[r];
+    TcpConn& tcp = res.tcp;
+    tcp.fd.reset(::socket(res.addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0));
+    if (!tcp.fd) return false;
+    int rc = ::connect(tcp.fd.get(), reinterpret_cast<sockaddr*>(&res.addr), res.len);
     if (rc < 0 && errno != EINPROGRESS) {
-        ::close(fd);
+        tcp.fd.reset();
         return false;
     }
-    fd_set wfds;
-    FD_ZERO(&wfds);
-    FD_SET(fd, &wfds);
-    timeval tv{};
-    tv.tv_sec = t.timeout_ms / 1000;
-    tv.tv_usec = (t.timeout_ms % 1000) * 1000;
-    rc = ::select(fd + 1, nullptr, &wfds, nullptr, &tv);
-    if (rc <= 0) {
-        ::close(fd);
+    tcp.connected = rc == 0;
+    tcp.events = EPOLLIN | EPOLLOUT;
+    if (!reactor_->add_fd(tcp.fd.get(), tcp.events, [this, r](uint32_t ev) { on_tcp(r, ev); })) {
+        tcp.fd.reset();
         return false;
     }
-    // build TCP DNS query with length prefix
-    auto pkt = build_query(a.id, t.qname);
-    uint16_t len = htons(static_cast<uint16_t>(pkt.size()));
-    std::vector<uint8_t> framed;
-    framed.resize(2);
-    std::memcpy(framed.data(), &len, 2);
-    framed.insert(framed.end(), pkt.begin(), pkt.end());
-    if (::send(fd, framed.data(), framed.size(), 0) < 0) {
-        ::close(fd);
-        return false;
+    return true;
+}
+
+void DnsProbe::on_tcp(size_t r, uint32_t events) {
+    TcpConn& tcp = resolvers_[r].tcp;
+    if (!tcp.connected) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        ::getsockopt(tcp.fd.get(), SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err != 0) {
+            tcp_fail(r);
+            return;
+        }
+        if (!(events & EPOLLOUT)) return;
+        tcp.connected = true;
+    }
+    if ((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !tcp_read(r)) {
+        tcp_fail(r);
+        return;
+    }
+    if (resolvers_[r].fallback.empty()) {
+        tcp_close(r);  // idle; the next fallback reconnects
+        return;
+    }
+    if (!tcp_flush(r)) tcp_fail(r);
+}
+
+bool DnsProbe::tcp_flush(size_t r) {
+    TcpConn& tcp = resolvers_[r].tcp;
+    while (tcp.out_off < tcp.out.size()) {
+        ssize_t n = ::send(tcp.fd.get(), tcp.out.data() + tcp.out_off, tcp.out.size() - tcp.out_off,
+                           MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        tcp.out_off += static_cast<size_t>(n);
+    }
+    if (tcp.out_off == tcp.out.size()) {
+        tcp.out.clear();
+        tcp.out_off = 0;
+    }
+    // Writable interest only while queries are queued.
+    uint32_t want = EPOLLIN | (tcp.out.empty() ? 0u : static_cast<uint32_t>(EPOLLOUT));
+    if (want != tcp.events) {
+        reactor_->mod_fd(tcp.fd.get(), want);
+        tcp.events = want;
+    }
+    return true;
+}
+
+bool DnsProbe::tcp_read(size_t r) {
+    TcpConn& tcp = resolvers_[r].tcp;
+    uint8_t buf[4096];
+    bool open = true;
+    for (;;) {
+        ssize_t n = ::recv(tcp.fd.get(), buf, sizeof(buf), 0);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n <= 0) {
+            open = false;  // closed by the resolver or failed; still use what arrived
+            break;
+        }
+        tcp.in.insert(tcp.in.end(), buf, buf + n);
+    }
+    // Responses are framed by a 2-byte length and may arrive in any order (RFC 7766).
+    size_t off = 0;
+    while (tcp.in.size() - off >= 2) {
+        size_t len = (static_cast<size_t>(tcp.in[off]) << 8) | tcp.in[off + 1];
+        if (tcp.in.size() - off - 2 < len) break;
+        on_tcp_reply(r, tcp.in.data() + off + 2, len);
+        off += 2 + len;
     }
-    uint8_t rbuf[2048];
-    rc = ::recv(fd, rbuf, sizeof(rbuf), 0);
-    ::close(fd);
-    if (rc <= 0) return false;
-    int rcode = rcode_from_response(rbuf + 2, static_cast<size_t>(rc - 2));
-    return rcode == 0;
+    tcp.in.erase(tcp.in.begin(), tcp.in.begin() + static_cast<std::ptrdiff_t>(off));
+    return open;
+}
+
+void DnsProbe::on_tcp_reply(size_t r, const uint8_t* data, size_t len) {
+    auto& fallback = resolvers_[r].fallback;
+    DnsMessage msg;
+    if (!parse_dns_message(data, len, msg) || !msg.response) {
+        ++rejected_;
+        return;
+    }
+    auto it = fallback.find(msg.id);
+    if (it == fallback.end() || !question_matches(data, len, target_questions_[it->second.idx])) {
+        ++rejected_;
+        return;
+    }
+    Attempt a = it->second;
+    reactor_->cancel_timer(a.timer);
+    fallback.erase(it);
+    double ms = (monotonic_ns() - a.start_ns) / 1e6;
+    if (msg.rcode == 0)
+        emit_event(a, true, ms, ErrorCode::TcpFallbackSuccess, -1, -1.0, &msg);
+    else
+        emit_event(a, false, ms, ErrorCode::DnsRcode, msg.rcode, -1.0, &msg);
 }
 
-void DnsProbe::emit_event(const Attempt& a, bool ok, double ms, const std::string& category,
-                          int rcode) {
+void DnsProbe::handle_fallback_timeout(size_t r, uint16_t id) {
+    auto& fallback = resolvers_[r].fallback;
+    auto it = fallback.find(id);
+    if (it == fallback.end()) return;
+    Attempt a = it->second;
+    fallback.erase(it);
+    emit_event(a, false, (monotonic_ns() - a.start_ns) / 1e6, ErrorCode::Timeout);
+    if (fallback.empty()) tcp_close(r);
+}
+
+void DnsProbe::tcp_fail(size_t r) {
+    tcp_close(r);
+    uint64_t now = monotonic_ns();
+    auto& fallback = resolvers_[r].fallback;
+    for (auto& kv : fallback) {
+        reactor_->cancel_timer(kv.second.timer);
+        emit_event(kv.second, false, (now - kv.second.start_ns) / 1e6, ErrorCode::Timeout);
+    }
+    fallback.clear();
+}
+
+void DnsProbe::tcp_close(size_t r) {
+    TcpConn& tcp = resolvers_[r].tcp;
+    if (tcp.fd) reactor_->del_fd(tcp.fd.get());
+    tcp.fd.reset();
+    tcp.connected = false;
+    tcp.events = 0;
+    tcp.out.clear();
+    tcp.out_off = 0;
+    tcp.in.clear();
+}
+
+void DnsProbe::emit_event(const Attempt& a, bool ok, double ms, ErrorCode error, int rcode,
+                          double kernel_ms, const DnsMessage* msg) {
+    Resolver& res = resolvers_[a.resolver];
     Event ev;
     ev.run_id = run_id_;
     ev.ts_monotonic_ns = monotonic_ns();
-    ev.ts_wall = wall_time_iso8601();
-    ev.type = ok ? "probe.dns.result" : "probe.dns.timeout";
+    ev.ts_wall_ns = wall_ns();
+    ev.type = ok ? EventType::DnsResult : EventType::DnsTimeout;
     ev.target_name = a.target_name;
-    ev.target_ip = resolver_ip_;
-    ev.target_family = "inet";
+    ev.target_ip = res.sym;
+    ev.target_family = res.family;
     ev.interval_ms = 0;
     ev.timeout_ms = a.timeout_ms;
     ev.ok = ok;
     ev.metric_ms = ms;
-    if (rcode >= 0)
-        ev.error_category = ok ? "" : (category + "_rcode_" + std::to_string(rcode));
-    else
-        ev.error_category = category;
+    ev.kernel_ms = kernel_ms;
+    ev.error = ok && rcode >= 0 ? ErrorCode::None : error;
+    ev.error_detail = rcode;
+    if (msg) {
+        ev.answer_count = msg->addr_count;
+        ev.min_ttl = static_cast<int32_t>(msg->min_ttl);
+        if (msg->addr_count > 0) {
+            ev.answer_family = msg->addr_family[0];
+            std::memcpy(ev.answer_addr, msg->addrs[0], sizeof(ev.answer_addr));
+        }
+    }
+    ++(ok ? res.stats.answered : res.stats.failed);
     bus_.emit(ev);
+    round_result(a, ev);
+}
+
+// One probe.dns.first_answer per multi-resolver round: the first NOERROR answer, timed from
+// the round's first send, or once every resolver has failed a failure repeating the last one.
+void DnsProbe::round_result(const Attempt& a, const Event& ev) {
+    if (a.round == 0) return;
+    auto it = rounds_.find(a.round);
+    if (it == rounds_.end()) return;
+    Round& r = it->second;
+    bool report = ev.ok ? !r.reported : (r.remaining == 1 && !r.reported);
+    if (report) {
+        r.reported = true;
+        if (ev.ok) ++resolvers_[a.resolver].stats.first;
+        Event first = ev;
+        first.type = EventType::DnsFirstAnswer;
+        first.metric_ms = (ev.ts_monotonic_ns - r.start_ns) / 1e6;
+        first.kernel_ms = -1.0;
+        bus_.emit(first);
+    }
+    if (--r.remaining == 0) rounds_.erase(it);
 }
 }  // namespace irr
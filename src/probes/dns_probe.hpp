@@ -1,11 +1,15 @@
 #pragma once
+#include <sys/socket.h>
+
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "../core/event_bus.hpp"
+#include "../core/fd.hpp"
 #include "../core/reactor.hpp"
 #include "../core/time_utils.hpp"
+#include "dns_message.hpp"
 
 namespace irr {
 struct DnsTarget {
@@ -15,36 +19,155 @@ struct DnsTarget {
     int timeout_ms;
 };
 
+// UDP queries over a small pool of long-lived sockets, each bound to its own random
+// ephemeral port. Queries fired during one reactor pass go out with a single sendmmsg and
+// replies are drained with recvmmsg. A reply is accepted only if it comes from a configured
+// resolver's address and port, arrives on the socket the query left from, carries a txid in
+// flight to that resolver and echoes the question; anything else is counted in rejected().
+//
+// Every fire() queries all configured resolvers at once. The pool is shared: one set of
+// sockets per address family however many resolvers there are, with each message addressed
+// individually within the batch. Each resolver gets its own probe.dns.result/timeout events
+// and stats; with more than one, the attempt as a whole is also reported as
+// probe.dns.first_answer, the time until the first resolver answered NOERROR.
+//
+// A query that times out over UDP (or comes back truncated) is retried over TCP on the reactor
+// with its own deadline. Fallbacks to a resolver share one pipelined connection to it (opened
+// on demand, closed when idle) and are matched by txid, since responses may come back in any
+// order.
 class DnsProbe {
    public:
+    static constexpr size_t kPoolSize = 4;
+    static constexpr size_t kBatch = 32;
+    static constexpr size_t kMaxResolvers = 16;
+
+    struct ResolverStats {
+        uint64_t sent{0};
+        uint64_t answered{0};  // NOERROR, over UDP or TCP
+        uint64_t failed{0};    // error RCODE, timeout or send failure
+        uint64_t first{0};     // rounds this resolver answered first
+    };
+
     DnsProbe(EventBus& bus, const std::string& run_id);
-    void set_resolver(const std::string& ip, int port = 53);
-    void tick(Reactor& r, const std::vector<DnsTarget>& targets);
-    void sweep_timeouts();
+    // Call before start(). Addresses that are not IP literals are skipped with a warning.
+    void set_resolvers(const std::vector<std::string>& ips, int port = 53);
+    void set_resolver(const std::string& ip, int port = 53) {
+        set_resolvers({ip}, port);
+    }
+    // Stores the target list, interning names once, and opens the socket pool. Queries are
+    // driven by fire()/tick().
+    void start(Reactor& r, const std::vector<DnsTarget>& targets);
+    // Queues one query per resolver for targets()[idx]; they are sent at the end of the
+    // current reactor pass.
+    void fire(size_t idx);
+    // Queues one round of queries per target.
+    void tick();
+    const std::vector<DnsTarget>& targets() const {
+        return targets_;
+    }
+    // Drops queued and in-flight queries without reporting them (end of run).
+    void stop();
+    // Also records UDP RTTs against the kernel's receive timestamp (Event::kernel_ms). Call
+    // before start().
+    void set_kernel_timestamps(bool on) {
+        kernel_ts_ = on;
+    }
+    // Replies dropped for a wrong source, unknown txid or mismatched question.
+    uint64_t rejected() const {
+        return rejected_;
+    }
+    size_t resolver_count() const {
+        return resolvers_.size();
+    }
+    const ResolverStats& resolver_stats(size_t i) const {
+        return resolvers_[i].stats;
+    }
 
    private:
     struct Attempt {
-        int fd;
+        size_t idx;
+        size_t resolver;
         uint16_t id;
         uint64_t start_ns;
-        std::string target_name;
-        std::string qname;
+        uint64_t start_wall_ns;
+        SymbolId target_name;
         int timeout_ms;
-        bool tcp_fallback_attempted{false};
+        uint32_t round;  // multi-resolver round, 0 if none
+        TimerId timer{0};
+    };
+    struct TcpConn {
+        Fd fd;
+        bool connected{false};
+        uint32_t events{0};
+        std::vector<uint8_t> out;  // framed queries not yet written
+        size_t out_off{0};
+        std::vector<uint8_t> in;  // partial response frames
+    };
+    struct Resolver {
+        std::string ip;
+        SymbolId sym;
+        SymbolId family;
+        size_t pool;  // 0 for IPv4, 1 for IPv6
+        sockaddr_storage addr{};
+        socklen_t len{0};
+        TcpConn tcp;
+        std::unordered_map<uint16_t, Attempt> fallback;  // key: txid on tcp
+        ResolverStats stats;
+    };
+    struct Round {
+        size_t remaining;
+        uint64_t start_ns;
+        bool reported{false};
+    };
+    struct Job {
+        size_t idx;
+        size_t resolver;
+        uint32_t round;
     };
 
     EventBus& bus_;
-    std::string run_id_;
+    SymbolId run_id_;
     Reactor* reactor_{nullptr};
-    std::string resolver_ip_ = "1.1.1.1";
+    std::vector<std::string> resolver_ips_{"1.1.1.1"};
     int resolver_port_ = 53;
-    std::unordered_map<int, Attempt> inflight_;
-    uint16_t next_id_{1};
-
-    void send_udp_query(Reactor& r, const DnsTarget& t);
-    void handle_response(int fd);
-    void emit_event(const Attempt& a, bool ok, double ms, const std::string& category,
-                    int rcode = -1);
-    bool tcp_fallback(const DnsTarget& t, Attempt& a);
+    std::vector<Resolver> resolvers_;
+    std::vector<DnsTarget> targets_;
+    std::vector<SymbolId> target_names_;
+    std::vector<std::string> target_questions_;  // wire-format question section
+    // kPoolSize sockets per address family (IPv4 first), shared by every resolver of that family.
+    Fd sock_[2 * kPoolSize];
+    size_t next_sock_[2]{};
+    // key: resolver << 24 | socket << 16 | txid
+    std::unordered_map<uint32_t, Attempt> inflight_;
+    std::unordered_map<uint32_t, Round> rounds_;
+    uint32_t next_round_{1};
+    std::vector<Job> pending_;
+    bool flush_posted_{false};
+    bool kernel_ts_{false};
+    std::vector<uint8_t> rx_buf_;
+    std::vector<char> rx_control_;
+    uint64_t rejected_{0};
+
+    bool open_pool(size_t pool);
+    void flush();
+    void send_batch(size_t sock, const Job* jobs, size_t count);
+    void handle_recv(size_t sock);
+    void on_reply(size_t sock, const uint8_t* data, size_t len, const sockaddr_storage& from,
+                  uint64_t rx_ns);
+    void handle_timeout(uint32_t key);
+    void emit_event(const Attempt& a, bool ok, double ms, ErrorCode error, int rcode = -1,
+                    double kernel_ms = -1.0, const DnsMessage* msg = nullptr);
+    void round_result(const Attempt& a, const Event& ev);
+
+    // TCP fallback, one connection per resolver.
+    void start_fallback(Attempt a);
+    bool tcp_connect(size_t r);
+    void on_tcp(size_t r, uint32_t events);
+    bool tcp_flush(size_t r);
+    bool tcp_read(size_t r);
+    void on_tcp_reply(size_t r, const uint8_t* data, size_t len);
+    void handle_fallback_timeout(size_t r, uint16_t id);
+    void tcp_fail(size_t r);  // reports every fallback pending on r as a timeout
+    void tcp_close(size_t r);
 };
 }  // namespace irr
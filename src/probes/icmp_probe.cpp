@@ -1,19 +1,28 @@
 #include "icmp_probe.hpp"
 
 #include <arpa/inet.h>
+#include <netinet/icmp6.h>
 #include <netinet/ip.h>
 #include <netinet/ip_icmp.h>
 #include <sys/epoll.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cerrno>
+#include <cstddef>
 #include <cstring>
+#include <random>
 
 #include "../core/logger.hpp"
+#include "../core/timestamping.hpp"
 
 namespace irr {
 namespace {
+// ICMP_FILTER from <linux/icmp.h>, which cannot be included next to <netinet/ip_icmp.h>.
+constexpr int kIcmpFilter = 1;
+
 uint16_t csum(const uint16_t* data, size_t len) {
     uint32_t sum = 0;
     for (; len > 1; len -= 2) sum += *data++;
@@ -22,126 +31,329 @@ uint16_t csum(const uint16_t* data, size_t len) {
     sum += (sum >> 16);
     return static_cast<uint16_t>(~sum);
 }
-}  // namespace
 
-IcmpProbe::IcmpProbe(EventBus& bus, const std::string& run_id) : bus_(bus), run_id_(run_id) {
-    int fd = ::socket(AF_INET, SOCK_RAW | SOCK_NONBLOCK, IPPROTO_ICMP);
-    if (fd >= 0) {
-        ::close(fd);
-        can_run_ = true;
+// Distinct echo ids per probe instance so raw-socket shards in one process can tell their
+// replies apart (ping sockets get a kernel-assigned id and per-socket delivery instead).
+uint16_t next_echo_id() {
+    static std::atomic<uint16_t> counter{0};
+    return static_cast<uint16_t>((::getpid() + counter.fetch_add(1)) & 0xFFFF);
+}
+
+// Largest ICMPv4 echo payload: 65535 less the IPv4 and ICMP headers.
+constexpr size_t kMaxPayload = 65507;
+
+uint32_t inflight_key(int family, uint16_t seq) {
+    return (static_cast<uint32_t>(family) << 16) | seq;
+}
+
+bool same_host(const sockaddr_storage& a, const sockaddr_storage& b) {
+    if (a.ss_family != b.ss_family) return false;
+    if (a.ss_family == AF_INET) {
+        return reinterpret_cast<const sockaddr_in&>(a).sin_addr.s_addr ==
+               reinterpret_cast<const sockaddr_in&>(b).sin_addr.s_addr;
     }
+    return std::memcmp(&reinterpret_cast<const sockaddr_in6&>(a).sin6_addr,
+                       &reinterpret_cast<const sockaddr_in6&>(b).sin6_addr,
+                       sizeof(in6_addr)) == 0;
+}
+}  // namespace
+
+IcmpProbe::IcmpProbe(EventBus& bus, const std::string& run_id)
+    : bus_(bus), run_id_(symbols().intern(run_id)), echo_id_(next_echo_id()) {
+    family_sym_[kV4] = symbols().intern("inet");
+    family_sym_[kV6] = symbols().intern("inet6");
+    std::random_device rd;
+    key_.k0 = (static_cast<uint64_t>(rd()) << 32) | rd();
+    key_.k1 = (static_cast<uint64_t>(rd()) << 32) | rd();
+    open_socket(kV4);
+    open_socket(kV6);
 }
 
-int IcmpProbe::open_socket() {
-    int fd = ::socket(AF_INET, SOCK_RAW | SOCK_NONBLOCK, IPPROTO_ICMP);
-    if (fd < 0) return -1;
+void IcmpProbe::open_socket(Family f) {
+    int domain = f == kV4 ? AF_INET : AF_INET6;
+    int proto = f == kV4 ? static_cast<int>(IPPROTO_ICMP) : static_cast<int>(IPPROTO_ICMPV6);
+    Socket& s = sock_[f];
+    s.fd.reset(::socket(domain, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, proto));
+    s.raw = false;
+    if (!s.fd) {
+        s.fd.reset(::socket(domain, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, proto));
+        s.raw = true;
+    }
+    if (!s.fd) return;
     int ttl = 64;
-    ::setsockopt(fd, IPPROTO_IP, IP_TTL, &ttl, sizeof(ttl));
-    return fd;
+    if (f == kV4) {
+        ::setsockopt(s.fd.get(), IPPROTO_IP, IP_TTL, &ttl, sizeof(ttl));
+        if (s.raw) {
+            // Only echo replies; every other ICMP message on the host stays out of our queue.
+            uint32_t filter = ~(1U << ICMP_ECHOREPLY);
+            ::setsockopt(s.fd.get(), SOL_RAW, kIcmpFilter, &filter, sizeof(filter));
+        }
+    } else {
+        ::setsockopt(s.fd.get(), IPPROTO_IPV6, IPV6_UNICAST_HOPS, &ttl, sizeof(ttl));
+        if (s.raw) {
+            icmp6_filter filter;
+            ICMP6_FILTER_SETBLOCKALL(&filter);
+            ICMP6_FILTER_SETPASS(ICMP6_ECHO_REPLY, &filter);
+            ::setsockopt(s.fd.get(), IPPROTO_ICMPV6, ICMP6_FILTER, &filter, sizeof(filter));
+        }
+    }
+}
+
+void IcmpProbe::set_kernel_timestamps(bool on) {
+    kernel_ts_ = false;
+    if (!on) return;
+    kernel_ts_ = true;
+    for (auto& s : sock_)
+        if (s.fd && !enable_rx_timestamps(s.fd.get())) kernel_ts_ = false;
+    if (!kernel_ts_) log(LogLevel::WARN, "icmp: kernel timestamps unavailable");
+}
+
+void IcmpProbe::set_stateless(bool on) {
+    stateless_ = on;
 }
 
-void IcmpProbe::tick(Reactor& r, const std::vector<IcmpTarget>& targets) {
-    if (!can_run_) return;
+void IcmpProbe::set_payload_size(size_t bytes) {
+    payload_ = std::min(bytes, kMaxPayload);
+    if (payload_ == 0) return;
+    // Don't fragment: an echo that does not fit the path is a send error, not two packets.
+    int v4 = IP_PMTUDISC_DO, v6 = IPV6_PMTUDISC_DO;
+    if (sock_[kV4].fd)
+        ::setsockopt(sock_[kV4].fd.get(), IPPROTO_IP, IP_MTU_DISCOVER, &v4, sizeof(v4));
+    if (sock_[kV6].fd)
+        ::setsockopt(sock_[kV6].fd.get(), IPPROTO_IPV6, IPV6_MTU_DISCOVER, &v6, sizeof(v6));
+}
+
+const char* IcmpProbe::socket_kind() const {
+    if (!sock_[kV4].fd) return "none";
+    return sock_[kV4].raw ? "raw" : "dgram";
+}
+
+void IcmpProbe::start(Reactor& r, const std::vector<IcmpTarget>& targets) {
     reactor_ = &r;
-    for (const auto& t : targets) send_ping(r, t);
-    sweep_timeouts();
+    targets_ = targets;
+    size_t payload = stateless_ ? std::max(payload_, sizeof(StampedEcho)) : payload_;
+    tx_.assign(sizeof(icmphdr) + payload, 0);
+    // Room for a raw socket's IP header (with options) in front of a full-size echo.
+    rx_.resize(std::max<size_t>(1500, 60 + tx_.size()));
+    slots_.assign(stateless_ ? targets_.size() : 0, Slot{});
+    target_names_.clear();
+    target_ips_.clear();
+    target_addrs_.assign(targets_.size(), sockaddr_storage{});
+    target_family_.assign(targets_.size(), -1);
+    for (size_t i = 0; i < targets_.size(); ++i) {
+        const auto& t = targets_[i];
+        target_names_.push_back(symbols().intern(t.name));
+        target_ips_.push_back(symbols().intern(t.ip));
+        auto& ss = target_addrs_[i];
+        auto* sin = reinterpret_cast<sockaddr_in*>(&ss);
+        auto* sin6 = reinterpret_cast<sockaddr_in6*>(&ss);
+        if (::inet_pton(AF_INET, t.ip.c_str(), &sin->sin_addr) == 1) {
+            sin->sin_family = AF_INET;
+            target_family_[i] = kV4;
+        } else if (::inet_pton(AF_INET6, t.ip.c_str(), &sin6->sin6_addr) == 1) {
+            sin6->sin6_family = AF_INET6;
+            target_family_[i] = kV6;
+        } else {
+            log(LogLevel::WARN, "icmp target " + t.name + ": not an IP address: " + t.ip);
+        }
+    }
+    for (int f = kV4; f < kFamilies; ++f) {
+        if (!sock_[f].fd) continue;
+        auto fam = static_cast<Family>(f);
+        r.add_fd(sock_[f].fd.get(), EPOLLIN, [this, fam](uint32_t) { handle_recv(fam); });
+    }
+    if (stateless_ && !targets_.empty())
+        sweep_timer_ = r.add_timer(monotonic_ns() + kSweepMs * 1000000ULL, [this]() { sweep(); });
 }
 
-void IcmpProbe::send_ping(Reactor& r, const IcmpTarget& t) {
-    int fd = open_socket();
-    if (fd < 0) return;
-    sockaddr_in sa{};
-    sa.sin_family = AF_INET;
-    if (::inet_pton(AF_INET, t.ip.c_str(), &sa.sin_addr) != 1) {
-        ::close(fd);
+void IcmpProbe::fire(size_t idx) {
+    if (reactor_ && idx < targets_.size()) send_ping(idx);
+}
+
+void IcmpProbe::tick() {
+    for (size_t i = 0; i < targets_.size(); ++i) fire(i);
+}
+
+void IcmpProbe::stop() {
+    for (auto& kv : inflight_)
+        if (reactor_) reactor_->cancel_timer(kv.second.timer);
+    inflight_.clear();
+    if (!reactor_) return;
+    reactor_->cancel_timer(sweep_timer_);
+    sweep_timer_ = 0;
+    for (auto& s : sock_)
+        if (s.fd) reactor_->del_fd(s.fd.get());
+}
+
+void IcmpProbe::send_ping(size_t idx) {
+    int f = target_family_[idx];
+    if (f < 0 || !sock_[f].fd) return;
+    if (stateless_) {
+        send_stamped(idx);
         return;
     }
-    uint16_t seq = next_seq_++;
-    icmphdr hdr{};
-    hdr.type = ICMP_ECHO;
-    hdr.code = 0;
-    hdr.un.echo.id = static_cast<uint16_t>(::getpid() & 0xFFFF);
-    hdr.un.echo.sequence = seq;
-    hdr.checksum = 0;
-    hdr.checksum = csum(reinterpret_cast<uint16_t*>(&hdr), sizeof(hdr));
-    ssize_t n = ::sendto(fd, &hdr, sizeof(hdr), 0, reinterpret_cast<sockaddr*>(&sa), sizeof(sa));
-    if (n < 0) {
-        ::close(fd);
+    const auto& t = targets_[idx];
+
+    // Next sequence not still waiting for a reply (only matters after a 16-bit wrap).
+    uint16_t seq = next_seq_[f]++;
+    for (int tries = 0; inflight_.count(inflight_key(f, seq)) && tries < 16; ++tries)
+        seq = next_seq_[f]++;
+    uint32_t key = inflight_key(f, seq);
+    if (inflight_.count(key)) return;
+
+    Attempt a{idx, monotonic_ns(), wall_ns()};
+    if (int err = send_echo(f, idx, seq)) {
+        emit(a, EventType::IcmpTimeout, false, 0.0, ErrorCode::SendFail, err);
         return;
     }
-    Attempt a{fd, seq, monotonic_ns(), t};
-    inflight_[fd] = a;
-    r.add_fd(fd, EPOLLIN, [this, fd](uint32_t) { handle_recv(fd); });
-}
-
-void IcmpProbe::handle_recv(int fd) {
-    uint8_t buf[1500];
-    sockaddr_in from{};
-    socklen_t flen = sizeof(from);
-    ssize_t n = ::recvfrom(fd, buf, sizeof(buf), 0, reinterpret_cast<sockaddr*>(&from), &flen);
-    auto it = inflight_.find(fd);
-    if (n < static_cast<ssize_t>(sizeof(iphdr) + sizeof(icmphdr)) || it == inflight_.end()) {
-        reactor_->del_fd(fd);
-        ::close(fd);
-        inflight_.erase(fd);
+    a.timer = reactor_->add_timer(a.start_ns + static_cast<uint64_t>(t.timeout_ms) * 1000000ULL,
+                                  [this, key]() { handle_timeout(key); });
+    inflight_[key] = a;
+}
+
+void IcmpProbe::send_stamped(size_t idx) {
+    Slot& slot = slots_[idx];
+    uint64_t now = monotonic_ns();
+    if (slot.pending) {
+        // Interval shorter than the timeout: the slot is needed for this ping.
+        emit(Attempt{idx, slot.sent_ns}, EventType::IcmpTimeout, false,
+             (now - slot.sent_ns) / 1e6, ErrorCode::Timeout);
+        slot.pending = false;
+    }
+    StampedEcho e{now, wall_ns(), static_cast<uint32_t>(idx), ++slot.gen, 0};
+    e.mac = siphash24(key_, &e, offsetof(StampedEcho, mac));
+    std::memcpy(tx_.data() + sizeof(icmphdr), &e, sizeof(e));
+    if (int err = send_echo(target_family_[idx], idx, static_cast<uint16_t>(e.gen))) {
+        emit(Attempt{idx, now}, EventType::IcmpTimeout, false, 0.0, ErrorCode::SendFail, err);
         return;
     }
-    auto* ip = reinterpret_cast<iphdr*>(buf);
-    auto* icmp = reinterpret_cast<icmphdr*>(buf + ip->ihl * 4);
-    if (icmp->type != ICMP_ECHOREPLY || icmp->un.echo.sequence != it->second.seq) {
-        return;  // keep waiting
+    slot.sent_ns = now;
+    slot.pending = true;
+}
+
+// Sends tx_ (header filled in here, payload as left by the caller); 0 or the sendto errno.
+int IcmpProbe::send_echo(int f, size_t idx, uint16_t seq) {
+    auto* hdr = reinterpret_cast<icmphdr*>(tx_.data());
+    // The echo header layout is shared by ICMPv4 and ICMPv6; the kernel fills in the v6
+    // checksum, and the id on ping sockets.
+    hdr->type = f == kV4 ? ICMP_ECHO : ICMP6_ECHO_REQUEST;
+    hdr->code = 0;
+    hdr->checksum = 0;
+    hdr->un.echo.id = htons(echo_id_);
+    hdr->un.echo.sequence = htons(seq);
+    if (f == kV4) hdr->checksum = csum(reinterpret_cast<uint16_t*>(tx_.data()), tx_.size());
+
+    const auto& addr = target_addrs_[idx];
+    socklen_t alen = f == kV4 ? sizeof(sockaddr_in) : sizeof(sockaddr_in6);
+    ssize_t n = ::sendto(sock_[f].fd.get(), tx_.data(), tx_.size(), 0,
+                         reinterpret_cast<const sockaddr*>(&addr), alen);
+    return n < 0 ? errno : 0;
+}
+
+void IcmpProbe::handle_recv(Family f) {
+    uint8_t* buf = rx_.data();
+    alignas(cmsghdr) char control[kTimestampCmsgSpace];
+    // Drain what is queued, bounded so one busy socket cannot starve the loop.
+    for (int i = 0; i < 64; ++i) {
+        sockaddr_storage from{};
+        iovec iov{buf, rx_.size()};
+        msghdr msg{};
+        msg.msg_name = &from;
+        msg.msg_namelen = sizeof(from);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        ssize_t n = ::recvmsg(sock_[f].fd.get(), &msg, 0);
+        if (n < 0) return;
+        size_t off = 0;
+        if (f == kV4 && sock_[f].raw) {
+            // Raw IPv4 sockets deliver the IP header; ping sockets and IPv6 do not.
+            if (n < static_cast<ssize_t>(sizeof(iphdr))) continue;
+            off = reinterpret_cast<const iphdr*>(buf)->ihl * 4u;
+        }
+        if (static_cast<size_t>(n) < off + sizeof(icmphdr)) continue;
+        const auto* icmp = reinterpret_cast<const icmphdr*>(buf + off);
+        uint8_t reply_type = f == kV4 ? ICMP_ECHOREPLY : ICMP6_ECHO_REPLY;
+        if (icmp->type != reply_type) continue;
+        if (sock_[f].raw && ntohs(icmp->un.echo.id) != echo_id_) continue;
+        uint64_t rx_ns = kernel_ts_ ? rx_timestamp_ns(msg) : 0;
+        if (stateless_) {
+            size_t data = off + sizeof(icmphdr);
+            on_stamped_reply(f, buf + data, static_cast<size_t>(n) - data, from, rx_ns);
+        } else {
+            on_reply(f, ntohs(icmp->un.echo.sequence), from, rx_ns);
+        }
     }
+}
+
+void IcmpProbe::on_reply(Family f, uint16_t seq, const sockaddr_storage& from, uint64_t rx_ns) {
+    auto it = inflight_.find(inflight_key(f, seq));
+    if (it == inflight_.end()) return;  // late reply after timeout, or not ours
+    if (!same_host(from, target_addrs_[it->second.idx])) return;
     double ms = (monotonic_ns() - it->second.start_ns) / 1e6;
-    Event ev;
-    ev.run_id = run_id_;
-    ev.ts_monotonic_ns = monotonic_ns();
-    ev.ts_wall = wall_time_iso8601();
-    ev.type = "probe.icmp.rtt";
-    ev.target_name = it->second.target.name;
-    ev.target_ip = it->second.target.ip;
-    ev.target_family = "inet";
-    ev.interval_ms = it->second.target.interval_ms;
-    ev.timeout_ms = it->second.target.timeout_ms;
-    ev.ok = true;
-    ev.metric_ms = ms;
-    ev.error_category = "";
-    bus_.emit(ev);
-    reactor_->del_fd(fd);
-    ::close(fd);
-    inflight_.erase(fd);
+    emit(it->second, EventType::IcmpRtt, true, ms, ErrorCode::None, 0,
+         kernel_rtt_ms(it->second.start_wall_ns, rx_ns));
+    reactor_->cancel_timer(it->second.timer);
+    inflight_.erase(it);
 }
 
-void IcmpProbe::emit_timeout(const Attempt& a) {
-    Event ev;
-    ev.run_id = run_id_;
-    ev.ts_monotonic_ns = monotonic_ns();
-    ev.ts_wall = wall_time_iso8601();
-    ev.type = "probe.icmp.timeout";
-    ev.target_name = a.target.name;
-    ev.target_ip = a.target.ip;
-    ev.target_family = "inet";
-    ev.interval_ms = a.target.interval_ms;
-    ev.timeout_ms = a.target.timeout_ms;
-    ev.ok = false;
-    ev.metric_ms = (monotonic_ns() - a.start_ns) / 1e6;
-    ev.error_category = "timeout";
-    bus_.emit(ev);
+void IcmpProbe::on_stamped_reply(Family f, const uint8_t* data, size_t len,
+                                 const sockaddr_storage& from, uint64_t rx_ns) {
+    StampedEcho e;
+    if (len < sizeof(e)) return;
+    std::memcpy(&e, data, sizeof(e));
+    if (e.mac != siphash24(key_, &e, offsetof(StampedEcho, mac))) return;  // not ours
+    if (e.idx >= targets_.size() || target_family_[e.idx] != f) return;
+    if (!same_host(from, target_addrs_[e.idx])) return;
+    Slot& slot = slots_[e.idx];
+    if (!slot.pending || slot.gen != e.gen) return;  // already reported as lost
+    slot.pending = false;
+    emit(Attempt{e.idx, e.sent_ns}, EventType::IcmpRtt, true, (monotonic_ns() - e.sent_ns) / 1e6,
+         ErrorCode::None, 0, kernel_rtt_ms(e.sent_wall_ns, rx_ns));
 }
 
-void IcmpProbe::sweep_timeouts() {
-    if (!reactor_) return;
+void IcmpProbe::handle_timeout(uint32_t key) {
+    auto it = inflight_.find(key);
+    if (it == inflight_.end()) return;
+    emit(it->second, EventType::IcmpTimeout, false, (monotonic_ns() - it->second.start_ns) / 1e6,
+         ErrorCode::Timeout);
+    inflight_.erase(it);
+}
+
+// Expires stateless pings past their target's timeout; one pass over the slots per kSweepMs.
+void IcmpProbe::sweep() {
     uint64_t now = monotonic_ns();
-    for (auto it = inflight_.begin(); it != inflight_.end();) {
-        auto& a = it->second;
-        double elapsed = (now - a.start_ns) / 1e6;
-        if (elapsed > a.target.timeout_ms) {
-            emit_timeout(a);
-            reactor_->del_fd(it->first);
-            ::close(it->first);
-            it = inflight_.erase(it);
-        } else {
-            ++it;
-        }
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        Slot& slot = slots_[i];
+        if (!slot.pending) continue;
+        if (now - slot.sent_ns < static_cast<uint64_t>(targets_[i].timeout_ms) * 1000000ULL)
+            continue;
+        slot.pending = false;
+        emit(Attempt{i, slot.sent_ns}, EventType::IcmpTimeout, false, (now - slot.sent_ns) / 1e6,
+             ErrorCode::Timeout);
     }
+    sweep_timer_ = reactor_->add_timer(now + kSweepMs * 1000000ULL, [this]() { sweep(); });
+}
+
+void IcmpProbe::emit(const Attempt& a, EventType type, bool ok, double ms, ErrorCode error,
+                     int detail, double kernel_ms) {
+    const auto& t = targets_[a.idx];
+    Event ev;
+    ev.run_id = run_id_;
+    ev.ts_monotonic_ns = monotonic_ns();
+    ev.ts_wall_ns = wall_ns();
+    ev.type = type;
+    ev.target_name = target_names_[a.idx];
+    ev.target_ip = target_ips_[a.idx];
+    ev.target_family = family_sym_[target_family_[a.idx]];
+    ev.interval_ms = t.interval_ms;
+    ev.timeout_ms = t.timeout_ms;
+    ev.ok = ok;
+    ev.metric_ms = ms;
+    ev.kernel_ms = kernel_ms;
+    ev.error = error;
+    ev.error_detail = detail;
+    bus_.emit(ev);
 }
 }  // namespace irr
@@ -1,4 +1,6 @@
 #pragma once
+#include <sys/socket.h>
+
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -7,6 +9,7 @@
 #include "../core/fd.hpp"
 #include "../core/reactor.hpp"
 #include "../core/time_utils.hpp"
+#include "../util/siphash.hpp"
 
 namespace irr {
 struct IcmpTarget {
@@ -16,33 +19,105 @@ struct IcmpTarget {
     int timeout_ms;
 };
 
+// Echo probe over one long-lived socket per address family. Replies are matched to the
+// in-flight table by echo sequence (and echo id on raw sockets), so the cost of a reply does
+// not grow with the number of targets. Unprivileged ping sockets (SOCK_DGRAM/IPPROTO_ICMP,
+// allowed by net.ipv4.ping_group_range) are preferred; raw sockets are the fallback and need
+// CAP_NET_RAW.
+//
+// In stateless mode the send time, target index and a keyed MAC travel in the echo payload, so
+// a reply is timed from its own bytes with no in-flight table and no per-ping allocation. Loss
+// is tracked in one fixed slot per target that a periodic sweep expires; a ping still
+// unanswered when the next one to the same target is sent is reported as lost.
 class IcmpProbe {
    public:
     IcmpProbe(EventBus& bus, const std::string& run_id);
     bool can_run() const {
-        return can_run_;
+        return sock_[kV4].fd || sock_[kV6].fd;
+    }
+    // Stores the target list, interning names once. Pings are driven by fire()/tick().
+    void start(Reactor& r, const std::vector<IcmpTarget>& targets);
+    // Sends one echo request to targets()[idx].
+    void fire(size_t idx);
+    // Sends one echo request per target.
+    void tick();
+    const std::vector<IcmpTarget>& targets() const {
+        return targets_;
     }
-    void tick(Reactor& r, const std::vector<IcmpTarget>& targets);
-    void sweep_timeouts();
+    // Drops in-flight pings without reporting them (end of run).
+    void stop();
+    // "dgram", "raw" or "none" for the IPv4 socket; for logs and `irr doctor`.
+    const char* socket_kind() const;
+    // Also records the RTT against the kernel's receive timestamp (Event::kernel_ms).
+    void set_kernel_timestamps(bool on);
+    // Selects stateless mode. Call before start().
+    void set_stateless(bool on);
+    // Echo payload bytes after the 8-byte header (stateless mode needs at least 32 and pads
+    // smaller sizes). A non-zero size also sets don't-fragment, so a payload too big for the
+    // path MTU the kernel knows fails to send with EMSGSIZE. Call before start().
+    void set_payload_size(size_t bytes);
 
    private:
+    enum Family { kV4, kV6, kFamilies };
+    struct Socket {
+        Fd fd;
+        bool raw{false};
+    };
     struct Attempt {
-        int fd;
-        uint16_t seq;
+        size_t idx;
         uint64_t start_ns;
-        IcmpTarget target;
+        uint64_t start_wall_ns{0};
+        TimerId timer{0};
+    };
+    // Stateless echo payload; `mac` is SipHash-2-4 of the fields before it under key_.
+    struct StampedEcho {
+        uint64_t sent_ns;
+        uint64_t sent_wall_ns;
+        uint32_t idx;
+        uint32_t gen;
+        uint64_t mac;
+    };
+    // Per-target loss tracking in stateless mode: the latest ping, if still unanswered.
+    struct Slot {
+        uint64_t sent_ns{0};
+        uint32_t gen{0};
+        bool pending{false};
     };
+    static constexpr int kSweepMs = 100;
 
     EventBus& bus_;
-    std::string run_id_;
-    bool can_run_{false};
+    SymbolId run_id_;
+    SymbolId family_sym_[kFamilies];
+    Socket sock_[kFamilies];
+    uint16_t echo_id_;
+    bool kernel_ts_{false};
+    bool stateless_{false};
+    size_t payload_{0};
+    SipKey key_;
+    std::vector<uint8_t> tx_;  // echo header + payload, rewritten in place for every ping
+    std::vector<uint8_t> rx_;
+    std::vector<Slot> slots_;
+    TimerId sweep_timer_{0};
     Reactor* reactor_{nullptr};
-    std::unordered_map<int, Attempt> inflight_;
-    uint16_t next_seq_{1};
+    std::vector<IcmpTarget> targets_;
+    std::vector<SymbolId> target_names_;
+    std::vector<SymbolId> target_ips_;
+    std::vector<sockaddr_storage> target_addrs_;
+    std::vector<int> target_family_;  // Family, or -1 if the address did not parse
+    std::unordered_map<uint32_t, Attempt> inflight_;  // key: family << 16 | sequence
+    uint16_t next_seq_[kFamilies]{1, 1};
 
-    int open_socket();
-    void send_ping(Reactor& r, const IcmpTarget& t);
-    void handle_recv(int fd);
-    void emit_timeout(const Attempt& a);
+    void open_socket(Family f);
+    void send_ping(size_t idx);
+    void send_stamped(size_t idx);
+    int send_echo(int f, size_t idx, uint16_t seq);
+    void handle_recv(Family f);
+    void on_reply(Family f, uint16_t seq, const sockaddr_storage& from, uint64_t rx_ns);
+    void on_stamped_reply(Family f, const uint8_t* data, size_t len, const sockaddr_storage& from,
+                          uint64_t rx_ns);
+    void handle_timeout(uint32_t key);
+    void sweep();
+    void emit(const Attempt& a, EventType type, bool ok, double ms, ErrorCode error,
+              int detail = 0, double kernel_ms = -1.0);
 };
 }  // namespace irr
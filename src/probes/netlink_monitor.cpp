@@ -1,26 +1,59 @@
 #include "netlink_monitor.hpp"
 
-#include <linux/netlink.h>
-#include <linux/rtnetlink.h>
+#include <arpa/inet.h>
+#include <net/if.h>
 #include <sys/epoll.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <cerrno>
+#include <cstdio>
 #include <cstring>
 
 #include "../core/logger.hpp"
 #include "../core/time_utils.hpp"
 
+#ifndef NETLINK_NO_ENOBUFS
+#define NETLINK_NO_ENOBUFS 5
+#endif
+
 namespace irr {
+namespace {
+constexpr int kRcvBuf = 1 << 20;
+
+size_t kind_index(ErrorCode kind) {
+    return static_cast<size_t>(kind) - static_cast<size_t>(ErrorCode::LinkUp);
+}
+
+bool is_link(ErrorCode kind) {
+    return kind == ErrorCode::LinkUp || kind == ErrorCode::LinkDown;
+}
+}  // namespace
+
 NetlinkMonitor::NetlinkMonitor(EventBus& bus, const std::string& run_id)
-    : bus_(bus), run_id_(run_id) {}
+    : bus_(bus),
+      run_id_(symbols().intern(run_id)),
+      host_(symbols().intern("host")),
+      localhost_(symbols().intern("localhost")),
+      family_(symbols().intern("netlink")),
+      family_link_(symbols().intern("link")),
+      family_inet_(symbols().intern("inet")),
+      family_inet6_(symbols().intern("inet6")),
+      coalesced_(symbols().intern("coalesced")) {}
 
 bool NetlinkMonitor::start(Reactor& r) {
-    fd_ = ::socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK, NETLINK_ROUTE);
+    fd_ = ::socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
     if (fd_ < 0) {
         log(LogLevel::WARN, "netlink socket unavailable; skipping route monitoring");
         return false;
     }
+    // A full-table reload can queue thousands of messages at once: give the socket room, and
+    // have the kernel drop what does not fit rather than failing our next recv with ENOBUFS.
+    int rcvbuf = kRcvBuf;
+    if (::setsockopt(fd_, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) < 0)
+        ::setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    int one = 1;
+    ::setsockopt(fd_, SOL_NETLINK, NETLINK_NO_ENOBUFS, &one, sizeof(one));
     sockaddr_nl addr{};
     addr.nl_family = AF_NETLINK;
     addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE;
@@ -30,44 +63,179 @@ bool NetlinkMonitor::start(Reactor& r) {
         fd_ = -1;
         return false;
     }
+    reactor_ = &r;
+    rx_.resize(kBatch * kMsgBytes);
     r.add_fd(fd_, EPOLLIN, [this](uint32_t ev) { handle(ev); });
     return true;
 }
 
 void NetlinkMonitor::stop() {
+    if (reactor_ && window_timer_) reactor_->cancel_timer(window_timer_);
+    window_timer_ = 0;
+    emit_summaries();
+    window_open_ = false;
     if (fd_ >= 0) {
+        if (reactor_) reactor_->del_fd(fd_);
         ::close(fd_);
         fd_ = -1;
     }
+    if (overruns_)
+        log(LogLevel::WARN, "netlink: receive queue overran " + std::to_string(overruns_) +
+                                " times; some changes were not seen");
+}
+
+void NetlinkMonitor::feed(const void* data, size_t len) {
+    if (process(static_cast<const char*>(data), len) && on_change_) on_change_();
 }
 
 void NetlinkMonitor::handle(uint32_t) {
-    char buf[4096];
-    ssize_t len = ::recv(fd_, buf, sizeof(buf), 0);
-    if (len <= 0) return;
-    for (nlmsghdr* nh = reinterpret_cast<nlmsghdr*>(buf); NLMSG_OK(nh, len);
-         nh = NLMSG_NEXT(nh, len)) {
+    mmsghdr msgs[kBatch];
+    iovec iov[kBatch];
+    bool changed = false;
+    // Bounded so a storm cannot starve the loop; the rest waits for the next wakeup.
+    for (int round = 0; round < 8; ++round) {
+        for (int i = 0; i < kBatch; ++i) {
+            iov[i] = {rx_.data() + i * kMsgBytes, kMsgBytes};
+            msgs[i] = {};
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        int n = ::recvmmsg(fd_, msgs, kBatch, MSG_DONTWAIT, nullptr);
+        if (n < 0) {
+            if (errno != ENOBUFS) break;
+            // Kernels without NETLINK_NO_ENOBUFS: messages were lost, but the socket is fine.
+            ++overruns_;
+            changed = true;
+            continue;
+        }
+        for (int i = 0; i < n; ++i) {
+            if (process(rx_.data() + i * kMsgBytes, msgs[i].msg_len)) changed = true;
+        }
+        if (n < kBatch) break;
+    }
+    if (changed && on_change_) on_change_();
+}
+
+bool NetlinkMonitor::process(const char* data, size_t len) {
+    bool changed = false;
+    auto remaining = static_cast<unsigned int>(len);
+    NetlinkChange c;
+    for (const auto* nh = reinterpret_cast<const nlmsghdr*>(data); NLMSG_OK(nh, remaining);
+         nh = NLMSG_NEXT(nh, remaining)) {
+        if (!parse_netlink_change(nh, c)) continue;
+        changed = true;
+        record(c);
+    }
+    return changed;
+}
+
+void NetlinkMonitor::record(const NetlinkChange& c) {
+    if (c.ifname[0]) {
+        auto it = ifnames_.find(c.ifindex);
+        if (it == ifnames_.end() || symbols().name(it->second) != c.ifname)
+            ifnames_[c.ifindex] = symbols().intern(c.ifname);
+    }
+    if (!window_open_) open_window();
+    if (window_emitted_ < kBurst) {
+        ++window_emitted_;
+        emit_change(c);
+    } else {
+        ++suppressed_[kind_index(c.kind)];
+    }
+}
+
+void NetlinkMonitor::open_window() {
+    window_open_ = true;
+    window_emitted_ = 0;
+    if (reactor_)
+        window_timer_ = reactor_->add_timer(monotonic_ns() + kCoalesceMs * 1000000ULL,
+                                            [this]() { close_window(); });
+}
+
+void NetlinkMonitor::close_window() {
+    window_timer_ = 0;
+    if (!emit_summaries()) {
+        window_open_ = false;
+        return;
+    }
+    // Still storming: keep counting rather than letting the next burst through.
+    open_window();
+    window_emitted_ = kBurst;
+}
+
+// One event per kind counted in this window; true if there were any.
+bool NetlinkMonitor::emit_summaries() {
+    bool any = false;
+    for (size_t k = 0; k < 4; ++k) {
+        if (suppressed_[k] == 0) continue;
+        any = true;
+        auto kind = static_cast<ErrorCode>(static_cast<size_t>(ErrorCode::LinkUp) + k);
         Event ev;
         ev.run_id = run_id_;
         ev.ts_monotonic_ns = monotonic_ns();
-        ev.ts_wall = wall_time_iso8601();
-        ev.target_name = "host";
-        ev.target_ip = "localhost";
-        ev.target_family = "netlink";
-        ev.interval_ms = 0;
+        ev.ts_wall_ns = wall_ns();
+        ev.type = is_link(kind) ? EventType::LinkChange : EventType::RouteChange;
+        ev.target_name = coalesced_;
+        ev.target_ip = localhost_;
+        ev.target_family = family_;
+        ev.interval_ms = kCoalesceMs;
         ev.timeout_ms = 0;
         ev.ok = true;
-        ev.metric_ms = 0.0;
-        if (nh->nlmsg_type == RTM_NEWLINK || nh->nlmsg_type == RTM_DELLINK) {
-            ev.type = "sys.netlink.link_change";
-            ev.error_category = nh->nlmsg_type == RTM_NEWLINK ? "link_up" : "link_down";
-        } else if (nh->nlmsg_type == RTM_NEWROUTE || nh->nlmsg_type == RTM_DELROUTE) {
-            ev.type = "sys.netlink.route_change";
-            ev.error_category = nh->nlmsg_type == RTM_NEWROUTE ? "route_add" : "route_del";
-        } else {
-            continue;
-        }
+        ev.metric_ms = static_cast<double>(suppressed_[k]);
+        ev.error = kind;
         bus_.emit(ev);
+        suppressed_[k] = 0;
+    }
+    return any;
+}
+
+SymbolId NetlinkMonitor::ifname(int ifindex) {
+    if (ifindex <= 0) return host_;
+    auto it = ifnames_.find(ifindex);
+    if (it != ifnames_.end()) return it->second;
+    char name[IF_NAMESIZE];
+    SymbolId sym;
+    if (::if_indextoname(static_cast<unsigned>(ifindex), name)) {
+        sym = symbols().intern(name);
+    } else {
+        std::snprintf(name, sizeof(name), "if%d", ifindex);
+        sym = symbols().intern(name);
+    }
+    ifnames_[ifindex] = sym;
+    return sym;
+}
+
+void NetlinkMonitor::emit_change(const NetlinkChange& c) {
+    Event ev;
+    ev.run_id = run_id_;
+    ev.ts_monotonic_ns = monotonic_ns();
+    ev.ts_wall_ns = wall_ns();
+    ev.target_name = ifname(c.ifindex);
+    ev.interval_ms = 0;
+    ev.timeout_ms = 0;
+    ev.ok = true;
+    ev.metric_ms = 0.0;
+    ev.error = c.kind;
+    if (is_link(c.kind)) {
+        ev.type = EventType::LinkChange;
+        ev.target_ip = localhost_;
+        ev.target_family = family_link_;
+    } else {
+        // "dst/len" (or "default"), plus " via gateway" when there is one.
+        char text[2 * INET6_ADDRSTRLEN + 16];
+        char addr[INET6_ADDRSTRLEN];
+        int af = c.family == AF_INET6 ? AF_INET6 : AF_INET;
+        size_t n = 0;
+        if (c.has_dst && ::inet_ntop(af, c.dst, addr, sizeof(addr)))
+            n = static_cast<size_t>(std::snprintf(text, sizeof(text), "%s/%u", addr, c.dst_len));
+        else
+            n = static_cast<size_t>(std::snprintf(text, sizeof(text), "default"));
+        if (c.has_gateway && ::inet_ntop(af, c.gateway, addr, sizeof(addr)))
+            std::snprintf(text + n, sizeof(text) - n, " via %s", addr);
+        ev.type = EventType::RouteChange;
+        ev.target_ip = symbols().intern(text);
+        ev.target_family = af == AF_INET6 ? family_inet6_ : family_inet_;
     }
+    bus_.emit(ev);
 }
 }  // namespace irr
@@ -1,18 +1,68 @@
 #pragma once
+#include <cstddef>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 #include "../core/event_bus.hpp"
 #include "../core/reactor.hpp"
+#include "netlink_parse.hpp"
 
 namespace irr {
+// Link and route changes from rtnetlink. Messages are read in batches with recvmmsg into one
+// preallocated buffer and decoded into NetlinkChange records. Changes become
+// sys.netlink.link_change/route_change events naming the interface and the route. A storm (a
+// routing-table reload or a Wi-Fi roam) is coalesced: after kBurst individual events in a
+// kCoalesceMs window, further changes are only counted, and each window ends with one
+// "coalesced" event per kind carrying the count in metric_ms.
 class NetlinkMonitor {
    public:
+    using ChangeHandler = InlineFunction<void(), 32>;
+    static constexpr int kCoalesceMs = 1000;
+    static constexpr int kBurst = 8;
+
     NetlinkMonitor(EventBus& bus, const std::string& run_id);
     bool start(Reactor& r);
+    // Reports what is still being counted, closes the socket and logs receive overruns.
     void stop();
+    // Called once per batch of netlink messages that contained a link or route change.
+    void set_change_handler(ChangeHandler cb) {
+        on_change_ = std::move(cb);
+    }
+    // Processes a buffer of netlink messages as if it had just been received.
+    void feed(const void* data, size_t len);
 
    private:
+    static constexpr int kBatch = 8;
+    static constexpr size_t kMsgBytes = 32768;  // NLMSG_GOODSIZE on large-page kernels
+
     int fd_{-1};
     EventBus& bus_;
-    std::string run_id_;
+    SymbolId run_id_;
+    SymbolId host_;
+    SymbolId localhost_;
+    SymbolId family_;
+    SymbolId family_link_;
+    SymbolId family_inet_;
+    SymbolId family_inet6_;
+    SymbolId coalesced_;
+    ChangeHandler on_change_;
+    Reactor* reactor_{nullptr};
+    std::vector<char> rx_;  // kBatch messages of kMsgBytes
+    std::unordered_map<int, SymbolId> ifnames_;
+    bool window_open_{false};
+    int window_emitted_{0};
+    uint32_t suppressed_[4]{};  // by kind, LinkUp..RouteDel
+    TimerId window_timer_{0};
+    uint64_t overruns_{0};
+
     void handle(uint32_t events);
+    bool process(const char* data, size_t len);
+    void record(const NetlinkChange& c);
+    void open_window();
+    void close_window();
+    bool emit_summaries();
+    SymbolId ifname(int ifindex);
+    void emit_change(const NetlinkChange& c);
 };
 }  // namespace irr
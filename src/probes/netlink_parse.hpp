@@ -0,0 +1,77 @@
+#pragma once
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+
+#include <cstdint>
+#include <cstring>
+
+#include "../core/event.hpp"
+
+namespace irr {
+// One link or route change decoded from an rtnetlink message, with no strings or heap: the
+// monitor decides afterwards whether it is worth rendering into an event.
+struct NetlinkChange {
+    ErrorCode kind;  // LinkUp, LinkDown, RouteAdd or RouteDel
+    uint8_t family;  // AF_INET/AF_INET6 for routes, AF_UNSPEC for links
+    uint8_t dst_len;
+    bool has_dst;
+    bool has_gateway;
+    int ifindex;  // link index, or the route's output interface (0 if none)
+    uint32_t mtu;  // IFLA_MTU, links only
+    uint8_t dst[16];
+    uint8_t gateway[16];
+    char ifname[IFNAMSIZ];  // IFLA_IFNAME, links only; empty if absent
+};
+
+// Decodes RTM_NEWLINK/RTM_DELLINK/RTM_NEWROUTE/RTM_DELROUTE. Returns false for any other
+// message, for truncated ones and for cloned (route cache) entries. A link counts as up only
+// while it is both administratively up and running.
+inline bool parse_netlink_change(const nlmsghdr* nh, NetlinkChange& out) {
+    std::memset(&out, 0, sizeof(out));
+    if (nh->nlmsg_type == RTM_NEWLINK || nh->nlmsg_type == RTM_DELLINK) {
+        if (nh->nlmsg_len < NLMSG_LENGTH(sizeof(ifinfomsg))) return false;
+        const auto* ifi = static_cast<const ifinfomsg*>(NLMSG_DATA(nh));
+        bool up = nh->nlmsg_type == RTM_NEWLINK && (ifi->ifi_flags & IFF_UP) &&
+                  (ifi->ifi_flags & IFF_RUNNING);
+        out.kind = up ? ErrorCode::LinkUp : ErrorCode::LinkDown;
+        out.ifindex = ifi->ifi_index;
+        int len = static_cast<int>(IFLA_PAYLOAD(nh));
+        for (const rtattr* a = IFLA_RTA(ifi); RTA_OK(a, len); a = RTA_NEXT(a, len)) {
+            size_t n = RTA_PAYLOAD(a);
+            if (a->rta_type == IFLA_IFNAME && n > 0) {
+                size_t copy = n < sizeof(out.ifname) ? n : sizeof(out.ifname) - 1;
+                std::memcpy(out.ifname, RTA_DATA(a), copy);
+                out.ifname[sizeof(out.ifname) - 1] = '\0';
+            } else if (a->rta_type == IFLA_MTU && n >= sizeof(uint32_t)) {
+                std::memcpy(&out.mtu, RTA_DATA(a), sizeof(out.mtu));
+            }
+        }
+        return true;
+    }
+    if (nh->nlmsg_type == RTM_NEWROUTE || nh->nlmsg_type == RTM_DELROUTE) {
+        if (nh->nlmsg_len < NLMSG_LENGTH(sizeof(rtmsg))) return false;
+        const auto* rtm = static_cast<const rtmsg*>(NLMSG_DATA(nh));
+        if (rtm->rtm_flags & RTM_F_CLONED) return false;
+        out.kind = nh->nlmsg_type == RTM_NEWROUTE ? ErrorCode::RouteAdd : ErrorCode::RouteDel;
+        out.family = rtm->rtm_family;
+        out.dst_len = rtm->rtm_dst_len;
+        size_t addr_len = rtm->rtm_family == AF_INET6 ? 16 : 4;
+        int len = static_cast<int>(RTM_PAYLOAD(nh));
+        for (const rtattr* a = RTM_RTA(rtm); RTA_OK(a, len); a = RTA_NEXT(a, len)) {
+            size_t n = RTA_PAYLOAD(a);
+            if (a->rta_type == RTA_DST && n >= addr_len) {
+                std::memcpy(out.dst, RTA_DATA(a), addr_len);
+                out.has_dst = true;
+            } else if (a->rta_type == RTA_GATEWAY && n >= addr_len) {
+                std::memcpy(out.gateway, RTA_DATA(a), addr_len);
+                out.has_gateway = true;
+            } else if (a->rta_type == RTA_OIF && n >= sizeof(int)) {
+                std::memcpy(&out.ifindex, RTA_DATA(a), sizeof(int));
+            }
+        }
+        return true;
+    }
+    return false;
+}
+}  // namespace irr
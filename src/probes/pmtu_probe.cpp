@@ -1,98 +1,304 @@
 #include "pmtu_probe.hpp"
 
 #include <arpa/inet.h>
-#include <netdb.h>
+#include <linux/errqueue.h>
 #include <netinet/in.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cerrno>
-#include <vector>
+#include <cstring>
 
 #include "../core/logger.hpp"
 
 namespace irr {
-PmtuProbe::PmtuProbe(EventBus& bus, const std::string& run_id) : bus_(bus), run_id_(run_id) {}
-
-void PmtuProbe::tick(const std::vector<PmtuTarget>& targets) {
-    for (const auto& t : targets) {
-        int discovered = 0;
-        int attempts = 0;
-        int successes = 0;
-        std::vector<int> sizes{1500, 1480, 1460, 1400, 1280, 1200};
-        for (int sz : sizes) {
-            ++attempts;
-            if (probe_target(t, sz, discovered)) {
-                discovered = sz;
-                ++successes;
-                break;
-            }
+namespace {
+// IP + UDP header bytes in front of the probe payload.
+size_t header_bytes(int family) {
+    return family == AF_INET6 ? 48 : 28;
+}
+
+// Path MTU of the connected socket's route as the kernel currently sees it.
+int route_mtu(int fd, int family) {
+    int mtu = 0;
+    socklen_t len = sizeof(mtu);
+    if (family == AF_INET6)
+        ::getsockopt(fd, IPPROTO_IPV6, IPV6_MTU, &mtu, &len);
+    else
+        ::getsockopt(fd, IPPROTO_IP, IP_MTU, &mtu, &len);
+    return mtu;
+}
+}  // namespace
+
+PmtuProbe::PmtuProbe(EventBus& bus, const std::string& run_id)
+    : bus_(bus), run_id_(symbols().intern(run_id)), family_unknown_(symbols().intern("unknown")) {}
+
+void PmtuProbe::start(Reactor& r, ResolverCache& resolver,
+                      const std::vector<PmtuTarget>& targets) {
+    reactor_ = &r;
+    resolver_ = &resolver;
+    targets_ = targets;
+    target_names_.clear();
+    target_hosts_.clear();
+    target_addrs_.clear();
+    searches_.clear();
+    searches_.resize(targets_.size());
+    for (const auto& t : targets_) {
+        target_names_.push_back(symbols().intern(t.name));
+        target_hosts_.push_back(symbols().intern(t.host));
+        target_addrs_.push_back(resolver.add(t.host, t.port));
+    }
+}
+
+void PmtuProbe::tick() {
+    for (size_t i = 0; i < targets_.size(); ++i) fire(i);
+}
+
+void PmtuProbe::invalidate() {
+    ++generation_;
+    for (auto& s : searches_) s.cached = false;
+}
+
+void PmtuProbe::stop() {
+    for (auto& s : searches_) {
+        if (reactor_ && s.timer) reactor_->cancel_timer(s.timer);
+        if (reactor_ && s.fd) reactor_->del_fd(s.fd.get());
+        s.timer = 0;
+        s.running = false;
+        s.fd.reset();
+    }
+}
+
+void PmtuProbe::fire(size_t idx) {
+    if (!reactor_ || idx >= targets_.size()) return;
+    Search& s = searches_[idx];
+    if (s.running) return;
+    if (s.cached && monotonic_ns() - s.cached_ns < kCacheMaxAgeMs * 1000000ULL) return;
+    ResolverCache::Handle h = target_addrs_[idx];
+    if (resolver_->state(h) == ResolverCache::State::Pending) return;
+    const auto& addrs = resolver_->addrs(h);
+    if (addrs.empty()) {
+        emit(idx, target_hosts_[idx], family_unknown_, false, 0, ErrorCode::DnsFailure,
+             resolver_->error(h));
+        return;
+    }
+    const ResolvedAddr& addr = addrs.front();
+    if (!open_socket(idx, addr)) {
+        emit(idx, addr.ip, addr.family, false, 0, ErrorCode::SendFail, errno);
+        return;
+    }
+    int route = route_mtu(s.fd.get(), s.family);
+    if (route <= static_cast<int>(header_bytes(s.family)) + 4) {
+        emit(idx, addr.ip, addr.family, false, 0, ErrorCode::SendFail, 0);
+        return;
+    }
+    s.ip = addr.ip;
+    s.family_sym = addr.family;
+    s.running = true;
+    s.generation = generation_;
+    s.hi = route;
+    s.lo = std::min(kMinMtu, route);
+    s.lo_confirmed = false;
+    s.lo_answered = false;
+    s.hint = route;  // the whole route MTU usually fits: try it first
+    s.reported = 0;
+    s.steps = 0;
+    // Grown once to the route MTU and reused by every probe after that.
+    if (s.buf.size() < static_cast<size_t>(route)) s.buf.resize(static_cast<size_t>(route), 0x42);
+    next_probe(idx);
+}
+
+// One socket per target, reopened only if the target's address family changes; connect()
+// follows address changes and gives IP_MTU a route to report on.
+bool PmtuProbe::open_socket(size_t idx, const ResolvedAddr& addr) {
+    Search& s = searches_[idx];
+    int family = addr.addr.ss_family;
+    if (!s.fd || s.family != family) {
+        if (s.fd) reactor_->del_fd(s.fd.get());
+        s.fd.reset(::socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0));
+        if (!s.fd) return false;
+        s.family = family;
+        int one = 1;
+        if (family == AF_INET6) {
+            int mode = IPV6_PMTUDISC_PROBE;
+            ::setsockopt(s.fd.get(), IPPROTO_IPV6, IPV6_MTU_DISCOVER, &mode, sizeof(mode));
+            ::setsockopt(s.fd.get(), IPPROTO_IPV6, IPV6_RECVERR, &one, sizeof(one));
+        } else {
+            int mode = IP_PMTUDISC_PROBE;
+            ::setsockopt(s.fd.get(), IPPROTO_IP, IP_MTU_DISCOVER, &mode, sizeof(mode));
+            ::setsockopt(s.fd.get(), IPPROTO_IP, IP_RECVERR, &one, sizeof(one));
         }
-        std::string category;
-        if (discovered == 0)
-            category = "emsgsize";
-        else if (successes >= 1 && attempts <= 2)
-            category = "confidence_high";
-        else if (successes >= 1 && attempts <= 4)
-            category = "confidence_medium";
+        reactor_->add_fd(s.fd.get(), EPOLLIN, [this, idx](uint32_t) { handle_event(idx); });
+    }
+    return ::connect(s.fd.get(), reinterpret_cast<const sockaddr*>(&addr.addr), addr.len) == 0;
+}
+
+// Binary search over (lo, hi], preferring a reported MTU as the next size; the floor itself is
+// probed last if nothing above it fit.
+void PmtuProbe::next_probe(size_t idx) {
+    Search& s = searches_[idx];
+    if (s.hi < s.lo) {
+        finish(idx, false, ErrorCode::Emsgsize, 0);  // not even the floor fits
+        return;
+    }
+    int floor = s.lo_confirmed ? s.lo + 1 : s.lo;
+    int next = 0;
+    if (s.hint >= floor && s.hint <= s.hi) next = s.hint;
+    s.hint = 0;
+    if (next == 0 && s.lo < s.hi) next = (s.lo + s.hi + 1) / 2;
+    if (next == 0 && !s.lo_confirmed) next = s.lo;
+    if (next == 0 || s.steps >= kMaxSteps) {
+        ErrorCode confidence = s.lo_answered         ? ErrorCode::ConfidenceHigh
+                               : s.reported == s.lo ? ErrorCode::ConfidenceMedium
+                                                    : ErrorCode::ConfidenceLow;
+        if (s.lo_confirmed)
+            finish(idx, true, confidence, 0);
         else
-            category = "confidence_low";
-
-        Event ev;
-        ev.run_id = run_id_;
-        ev.ts_monotonic_ns = monotonic_ns();
-        ev.ts_wall = wall_time_iso8601();
-        ev.type = "probe.pmtu.result";
-        ev.target_name = t.name;
-        ev.target_ip = t.host;
-        ev.target_family = "inet";
-        ev.interval_ms = 0;
-        ev.timeout_ms = 0;
-        ev.ok = discovered > 0;
-        ev.metric_ms = static_cast<double>(discovered);
-        ev.error_category = category;
-        bus_.emit(ev);
+            finish(idx, false, ErrorCode::Emsgsize, 0);
+        return;
     }
+    send_probe(idx, next);
 }
 
-bool PmtuProbe::probe_target(const PmtuTarget& t, int size, int& discovered) {
-    addrinfo hints{};
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_DGRAM;
-    addrinfo* res = nullptr;
-    if (getaddrinfo(t.host.c_str(), std::to_string(t.port).c_str(), &hints, &res) != 0 || !res)
-        return false;
-    int fd = ::socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-    if (fd < 0) {
-        freeaddrinfo(res);
-        return false;
+void PmtuProbe::send_probe(size_t idx, int size) {
+    Search& s = searches_[idx];
+    s.size = size;
+    ++s.steps;
+    // The first four payload bytes carry the size, so a port unreachable that quotes the
+    // datagram can be matched to the probe in flight.
+    uint32_t tag = htonl(static_cast<uint32_t>(size));
+    std::memcpy(s.buf.data(), &tag, sizeof(tag));
+    size_t len = static_cast<size_t>(size) - header_bytes(s.family);
+    ssize_t n = ::send(s.fd.get(), s.buf.data(), len, 0);
+    if (n < 0 && errno == ECONNREFUSED) {
+        // A pending error from the previous probe's port unreachable, not this send's.
+        drain_errors(idx);
+        n = ::send(s.fd.get(), s.buf.data(), len, 0);
     }
-    int val = IP_PMTUDISC_DO;
-    if (res->ai_family == AF_INET) {
-        ::setsockopt(fd, IPPROTO_IP, IP_MTU_DISCOVER, &val, sizeof(val));
-    } else if (res->ai_family == AF_INET6) {
-#ifdef IPPROTO_IPV6
-        val = IPV6_PMTUDISC_DO;
-        ::setsockopt(fd, IPPROTO_IPV6, IPV6_MTU_DISCOVER, &val, sizeof(val));
-#endif
+    if (n >= 0) {
+        uint64_t deadline = monotonic_ns() + kProbeWaitMs * 1000000ULL;
+        s.timer = reactor_->add_timer(deadline, [this, idx]() {
+            searches_[idx].timer = 0;
+            fits(idx, false);  // no complaint from the path in time
+        });
+        return;
     }
-    std::vector<uint8_t> payload(size, 0x42);
-    ssize_t rc = ::sendto(fd, payload.data(), payload.size(), 0, res->ai_addr, res->ai_addrlen);
-    if (rc < 0 && errno == EMSGSIZE) {
-        int mtu = 0;
-        socklen_t len = sizeof(mtu);
-        if (res->ai_family == AF_INET) ::getsockopt(fd, IPPROTO_IP, IP_MTU, &mtu, &len);
-#ifdef IPPROTO_IPV6
-        if (res->ai_family == AF_INET6) ::getsockopt(fd, IPPROTO_IPV6, IPV6_MTU, &mtu, &len);
-#endif
-        if (mtu > 0) discovered = mtu;
-        ::close(fd);
-        freeaddrinfo(res);
-        return false;
+    int err = errno;
+    ErrorReport rep = drain_errors(idx);
+    if (err == EMSGSIZE) {
+        // Larger than the outgoing interface; the local error carries its MTU.
+        too_big(idx, rep.mtu > 0 ? rep.mtu : route_mtu(s.fd.get(), s.family));
+        return;
+    }
+    finish(idx, false, ErrorCode::SendFail, err);
+}
+
+void PmtuProbe::handle_event(size_t idx) {
+    Search& s = searches_[idx];
+    ErrorReport rep = drain_errors(idx);
+    // Anything the target sent back is of no interest beyond clearing the queue.
+    uint8_t sink[64];
+    for (int i = 0; i < 16 && ::recv(s.fd.get(), sink, sizeof(sink), 0) >= 0; ++i) {
+    }
+    if (!s.running) return;
+    if (rep.unreachable)
+        finish(idx, false, ErrorCode::SendFail, rep.unreachable);
+    else if (rep.mtu > 0 && rep.mtu < s.size)
+        too_big(idx, rep.mtu);
+    else if (rep.answered)
+        fits(idx, true);
+}
+
+PmtuProbe::ErrorReport PmtuProbe::drain_errors(size_t idx) {
+    Search& s = searches_[idx];
+    ErrorReport rep;
+    uint8_t data[64];
+    alignas(cmsghdr) char control[256];
+    for (int i = 0; i < 16; ++i) {
+        iovec iov{data, sizeof(data)};
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        ssize_t n = ::recvmsg(s.fd.get(), &msg, MSG_ERRQUEUE);
+        if (n < 0) break;
+        for (cmsghdr* c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+            bool v4 = c->cmsg_level == IPPROTO_IP && c->cmsg_type == IP_RECVERR;
+            bool v6 = c->cmsg_level == IPPROTO_IPV6 && c->cmsg_type == IPV6_RECVERR;
+            if (!v4 && !v6) continue;
+            sock_extended_err ee;
+            std::memcpy(&ee, CMSG_DATA(c), sizeof(ee));
+            if (ee.ee_errno == EMSGSIZE && ee.ee_info > 0) {
+                int mtu = static_cast<int>(ee.ee_info);
+                rep.mtu = rep.mtu ? std::min(rep.mtu, mtu) : mtu;
+            } else if (ee.ee_errno == ECONNREFUSED && n >= 4) {
+                uint32_t tag;
+                std::memcpy(&tag, data, sizeof(tag));
+                if (ntohl(tag) == static_cast<uint32_t>(s.size)) rep.answered = true;
+            } else if (ee.ee_errno == EHOSTUNREACH || ee.ee_errno == ENETUNREACH) {
+                rep.unreachable = static_cast<int>(ee.ee_errno);
+            }
+        }
     }
-    ::close(fd);
-    freeaddrinfo(res);
-    discovered = size;
-    return true;
+    if (rep.mtu > 0) s.reported = s.reported ? std::min(s.reported, rep.mtu) : rep.mtu;
+    return rep;
+}
+
+void PmtuProbe::fits(size_t idx, bool answered) {
+    Search& s = searches_[idx];
+    if (s.timer) reactor_->cancel_timer(s.timer);
+    s.timer = 0;
+    s.lo = s.size;
+    s.lo_confirmed = true;
+    s.lo_answered = answered;
+    next_probe(idx);
+}
+
+void PmtuProbe::too_big(size_t idx, int reported_mtu) {
+    Search& s = searches_[idx];
+    if (s.timer) reactor_->cancel_timer(s.timer);
+    s.timer = 0;
+    s.hi = std::min(s.hi, s.size - 1);
+    if (reported_mtu > 0 && reported_mtu < s.size) {
+        s.hi = std::min(s.hi, reported_mtu);
+        s.hint = reported_mtu;
+    }
+    next_probe(idx);
+}
+
+void PmtuProbe::finish(size_t idx, bool ok, ErrorCode error, int detail) {
+    Search& s = searches_[idx];
+    if (s.timer) reactor_->cancel_timer(s.timer);
+    s.timer = 0;
+    s.running = false;
+    emit(idx, s.ip, s.family_sym, ok, ok ? s.lo : s.reported, error, detail);
+    // Send failures are retried on the next fire(); anything else stands until the path may
+    // have changed.
+    if (error != ErrorCode::SendFail && s.generation == generation_) {
+        s.cached = true;
+        s.cached_ns = monotonic_ns();
+    }
+}
+
+void PmtuProbe::emit(size_t idx, SymbolId ip, SymbolId family, bool ok, int mtu,
+                     ErrorCode error, int detail) {
+    Event ev;
+    ev.run_id = run_id_;
+    ev.ts_monotonic_ns = monotonic_ns();
+    ev.ts_wall_ns = wall_ns();
+    ev.type = EventType::PmtuResult;
+    ev.target_name = target_names_[idx];
+    ev.target_ip = ip;
+    ev.target_family = family;
+    ev.interval_ms = 0;
+    ev.timeout_ms = 0;
+    ev.ok = ok;
+    ev.metric_ms = static_cast<double>(mtu);
+    ev.error = error;
+    ev.error_detail = detail;
+    bus_.emit(ev);
 }
 }  // namespace irr
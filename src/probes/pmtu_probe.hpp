@@ -3,7 +3,10 @@
 #include <vector>
 
 #include "../core/event_bus.hpp"
+#include "../core/fd.hpp"
+#include "../core/reactor.hpp"
 #include "../core/time_utils.hpp"
+#include "resolver_cache.hpp"
 
 namespace irr {
 struct PmtuTarget {
@@ -12,14 +15,86 @@ struct PmtuTarget {
     int port;
 };
 
+// Path MTU discovery as a reactor-driven binary search between 1280 and the route MTU.
+// Each target keeps one connected UDP socket in IP_PMTUDISC_PROBE mode (DF set, kernel PMTU
+// cache ignored) with IP_RECVERR, and one payload buffer. A probe fits if the destination
+// answers it (ICMP port unreachable quoting the probe) or nothing comes back within
+// kProbeWaitMs; it is too big if the send fails with EMSGSIZE or a router's frag-needed
+// arrives on the error queue, whose MTU also narrows the search. A finished search is cached
+// until invalidate() (netlink route/link change) or kCacheMaxAgeMs, whichever comes first.
 class PmtuProbe {
    public:
     PmtuProbe(EventBus& bus, const std::string& run_id);
-    void tick(const std::vector<PmtuTarget>& targets);
+    // Stores the target list and registers hosts with the resolver cache.
+    void start(Reactor& r, ResolverCache& resolver, const std::vector<PmtuTarget>& targets);
+    // Starts a search for targets()[idx] unless one is running or its result is still
+    // cached; skipped while the host's first lookup is running.
+    void fire(size_t idx);
+    void tick();
+    // Drops cached results so the next fire() searches again. Searches already running
+    // still report, but their results are not cached.
+    void invalidate();
+    // Abandons running searches and closes the sockets.
+    void stop();
+    const std::vector<PmtuTarget>& targets() const {
+        return targets_;
+    }
 
    private:
+    static constexpr int kMinMtu = 1280;
+    static constexpr int kProbeWaitMs = 1000;
+    static constexpr int kMaxSteps = 20;
+    static constexpr uint64_t kCacheMaxAgeMs = 600000;  // the kernel's default mtu_expires
+
+    struct Search {
+        Fd fd;
+        int family{0};
+        std::vector<uint8_t> buf;
+        SymbolId ip{};
+        SymbolId family_sym{};
+        bool running{false};
+        int lo{0};                 // largest size known to fit (or the floor, unconfirmed)
+        int hi{0};                 // largest size that may still fit
+        bool lo_confirmed{false};  // lo has been probed and fit
+        bool lo_answered{false};   // ...and the destination itself answered that probe
+        int hint{0};               // size to try next, from the route or an MTU report
+        int reported{0};           // smallest MTU reported locally or by a router
+        int size{0};               // size in flight
+        int steps{0};
+        uint32_t generation{0};
+        TimerId timer{0};
+        bool cached{false};
+        uint64_t cached_ns{0};
+    };
+
+    // What one drain of a socket's error queue said about the path.
+    struct ErrorReport {
+        int mtu{0};            // smallest MTU from a local EMSGSIZE or a router's frag-needed
+        bool answered{false};  // the destination rejected the probe in flight (port closed)
+        int unreachable{0};    // EHOSTUNREACH/ENETUNREACH from the path, 0 if none
+    };
+
     EventBus& bus_;
-    std::string run_id_;
-    bool probe_target(const PmtuTarget& t, int size, int& discovered);
+    SymbolId run_id_;
+    SymbolId family_unknown_;
+    Reactor* reactor_{nullptr};
+    ResolverCache* resolver_{nullptr};
+    std::vector<PmtuTarget> targets_;
+    std::vector<SymbolId> target_names_;
+    std::vector<SymbolId> target_hosts_;
+    std::vector<ResolverCache::Handle> target_addrs_;
+    std::vector<Search> searches_;
+    uint32_t generation_{0};
+
+    bool open_socket(size_t idx, const ResolvedAddr& addr);
+    void next_probe(size_t idx);
+    void send_probe(size_t idx, int size);
+    void handle_event(size_t idx);
+    ErrorReport drain_errors(size_t idx);
+    void fits(size_t idx, bool answered);
+    void too_big(size_t idx, int reported_mtu);
+    void finish(size_t idx, bool ok, ErrorCode error, int detail);
+    void emit(size_t idx, SymbolId ip, SymbolId family, bool ok, int mtu, ErrorCode error,
+              int detail);
 };
 }  // namespace irr
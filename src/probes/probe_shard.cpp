@@ -0,0 +1,109 @@
+#include "probe_shard.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "../core/logger.hpp"
+
+namespace irr {
+std::vector<ShardTargets> partition_targets(const ShardTargets& all, size_t shards) {
+    if (shards == 0) shards = 1;
+    std::vector<ShardTargets> out(shards);
+    for (size_t i = 0; i < all.tcp.size(); ++i) out[i % shards].tcp.push_back(all.tcp[i]);
+    for (size_t i = 0; i < all.dns.size(); ++i) out[i % shards].dns.push_back(all.dns[i]);
+    for (size_t i = 0; i < all.icmp.size(); ++i) out[i % shards].icmp.push_back(all.icmp[i]);
+    out[0].pmtu = all.pmtu;
+    out[0].netlink = all.netlink;
+    return out;
+}
+
+ProbeShard::ProbeShard(size_t index, EventBus& bus, const std::string& run_id,
+                       const ShardOptions& opts)
+    : index_(index),
+      bus_(bus),
+      reactor_(opts.epoll_batch, opts.backend),
+      resolver_(bus, run_id),
+      tcp_(bus, run_id),
+      dns_(bus, run_id),
+      icmp_(bus, run_id),
+      netlink_(bus, run_id),
+      pmtu_(bus, run_id) {
+    if (!opts.resolvers.empty()) dns_.set_resolvers(opts.resolvers);
+    tcp_.set_kernel_timestamps(opts.kernel_timestamps);
+    dns_.set_kernel_timestamps(opts.kernel_timestamps);
+    icmp_.set_kernel_timestamps(opts.kernel_timestamps);
+    icmp_.set_stateless(opts.icmp_stateless);
+    icmp_.set_payload_size(opts.icmp_payload);
+}
+
+ProbeShard::~ProbeShard() {
+    finish();
+}
+
+void ProbeShard::setup(const ShardTargets& targets) {
+    if (targets.netlink) netlink_started_ = netlink_.start(reactor_);
+    tcp_.start(reactor_, resolver_, targets.tcp);
+    dns_.start(reactor_, targets.dns);
+    icmp_.start(reactor_, targets.icmp);
+    pmtu_.start(reactor_, resolver_, targets.pmtu);
+    // Cached path MTUs stand until the routing table or a link says otherwise.
+    if (netlink_started_) netlink_.set_change_handler([this]() { pmtu_.invalidate(); });
+    resolver_.start(reactor_);
+    // One job per (probe, target), each on its own interval and phase-spread across it.
+    for (size_t i = 0; i < targets.tcp.size(); ++i)
+        scheduler_.add("tcp/" + targets.tcp[i].name, targets.tcp[i].interval_ms,
+                       [this, i]() { tcp_.fire(i); });
+    for (size_t i = 0; i < targets.dns.size(); ++i)
+        scheduler_.add("dns/" + targets.dns[i].name, targets.dns[i].interval_ms,
+                       [this, i]() { dns_.fire(i); });
+    if (icmp_.can_run()) {
+        for (size_t i = 0; i < targets.icmp.size(); ++i)
+            scheduler_.add("icmp/" + targets.icmp[i].name, targets.icmp[i].interval_ms,
+                           [this, i]() { icmp_.fire(i); });
+    }
+    for (size_t i = 0; i < targets.pmtu.size(); ++i)
+        scheduler_.add("pmtu/" + targets.pmtu[i].name, 30000, [this, i]() { pmtu_.fire(i); });
+    scheduler_.start(reactor_);
+}
+
+void ProbeShard::run(std::chrono::steady_clock::time_point deadline) {
+    while (!stop_.load(std::memory_order_relaxed) && std::chrono::steady_clock::now() < deadline) {
+        reactor_.loop_once(200);
+        bus_.idle();
+    }
+}
+
+bool ProbeShard::spawn(std::chrono::steady_clock::time_point deadline, int cpu) {
+    try {
+        thread_ = std::thread([this, deadline, cpu]() {
+            if (cpu >= 0) {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(cpu, &set);
+                if (::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) != 0)
+                    log(LogLevel::WARN, "shard " + std::to_string(index_) +
+                                            ": could not pin to cpu " + std::to_string(cpu));
+            }
+            run(deadline);
+        });
+    } catch (const std::system_error&) {
+        log(LogLevel::ERROR, "shard " + std::to_string(index_) + ": failed to start thread");
+        return false;
+    }
+    return true;
+}
+
+void ProbeShard::finish() {
+    if (thread_.joinable()) thread_.join();
+    if (finished_) return;
+    finished_ = true;
+    scheduler_.stop();
+    scheduler_.log_summary("shard " + std::to_string(index_) + " scheduler");
+    tcp_.stop();
+    dns_.stop();
+    icmp_.stop();
+    pmtu_.stop();
+    resolver_.stop();
+    if (netlink_started_) netlink_.stop();
+}
+}  // namespace irr
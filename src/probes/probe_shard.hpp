@@ -0,0 +1,82 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../core/event_bus.hpp"
+#include "../core/reactor.hpp"
+#include "../core/scheduler_timerfd.hpp"
+#include "dns_probe.hpp"
+#include "icmp_probe.hpp"
+#include "netlink_monitor.hpp"
+#include "pmtu_probe.hpp"
+#include "resolver_cache.hpp"
+#include "tcp_connect.hpp"
+
+namespace irr {
+struct ShardTargets {
+    std::vector<TcpTarget> tcp;
+    std::vector<DnsTarget> dns;
+    std::vector<IcmpTarget> icmp;
+    std::vector<PmtuTarget> pmtu;
+    bool netlink{false};
+};
+
+// Splits targets across `shards` round-robin. Host-wide monitors (netlink, PMTU) stay on
+// shard 0.
+std::vector<ShardTargets> partition_targets(const ShardTargets& all, size_t shards);
+
+struct ShardOptions {
+    std::vector<std::string> resolvers;  // DNS probe resolvers, all queried every interval
+    int epoll_batch{Reactor::kDefaultBatch};
+    ReactorBackend backend{ReactorBackend::Epoll};
+    bool kernel_timestamps{false};  // also record Event::kernel_ms
+    bool icmp_stateless{false};     // see IcmpProbe::set_stateless
+    size_t icmp_payload{0};         // echo payload bytes; 0 = bare header
+};
+
+// One reactor thread's worth of probing: its own Reactor (and so its own timer wheel),
+// scheduler and probe instances, emitting into its own EventBus. Nothing is shared with other
+// shards except the process-wide symbol table. That table is mutex-guarded and is written
+// concurrently at run time: by shard 0's netlink monitor (interface names, route text) and by
+// every shard's getaddrinfo helper thread (resolved target addresses).
+class ProbeShard {
+   public:
+    ProbeShard(size_t index, EventBus& bus, const std::string& run_id,
+               const ShardOptions& opts);
+    ~ProbeShard();
+    ProbeShard(const ProbeShard&) = delete;
+    ProbeShard& operator=(const ProbeShard&) = delete;
+
+    // Registers targets and one periodic job per (probe, target).
+    void setup(const ShardTargets& targets);
+    // Runs the event loop on the calling thread until deadline or request_stop().
+    void run(std::chrono::steady_clock::time_point deadline);
+    // Runs the event loop on a new thread, pinned to `cpu` when cpu >= 0.
+    bool spawn(std::chrono::steady_clock::time_point deadline, int cpu);
+    // Makes run() return within one loop iteration; safe from any thread.
+    void request_stop() {
+        stop_.store(true, std::memory_order_relaxed);
+    }
+    // Joins the thread (if any), closes in-flight probes and logs scheduling lag.
+    void finish();
+
+   private:
+    size_t index_;
+    EventBus& bus_;
+    Reactor reactor_;
+    PeriodicScheduler scheduler_;
+    ResolverCache resolver_;
+    TcpConnectProbe tcp_;
+    DnsProbe dns_;
+    IcmpProbe icmp_;
+    NetlinkMonitor netlink_;
+    PmtuProbe pmtu_;
+    bool netlink_started_{false};
+    bool finished_{false};
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
+}  // namespace irr
@@ -0,0 +1,201 @@
+#include "resolver_cache.hpp"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "../core/logger.hpp"
+
+namespace irr {
+namespace {
+// Runs getaddrinfo; fills out with one entry per returned address.
+int lookup(const std::string& host, int port, int flags, std::vector<ResolvedAddr>& out) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = flags;
+    addrinfo* res = nullptr;
+    int rc = ::getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res);
+    if (rc != 0) return rc;
+    SymbolId inet = symbols().intern("inet");
+    SymbolId inet6 = symbols().intern("inet6");
+    for (addrinfo* ai = res; ai; ai = ai->ai_next) {
+        if (ai->ai_family != AF_INET && ai->ai_family != AF_INET6) continue;
+        ResolvedAddr ra{};
+        std::memcpy(&ra.addr, ai->ai_addr, ai->ai_addrlen);
+        ra.len = ai->ai_addrlen;
+        char ip[INET6_ADDRSTRLEN] = {};
+        if (ai->ai_family == AF_INET)
+            ::inet_ntop(AF_INET, &reinterpret_cast<sockaddr_in*>(ai->ai_addr)->sin_addr, ip,
+                        sizeof(ip));
+        else
+            ::inet_ntop(AF_INET6, &reinterpret_cast<sockaddr_in6*>(ai->ai_addr)->sin6_addr, ip,
+                        sizeof(ip));
+        ra.ip = symbols().intern(ip);
+        ra.family = ai->ai_family == AF_INET6 ? inet6 : inet;
+        out.push_back(ra);
+    }
+    ::freeaddrinfo(res);
+    return out.empty() ? EAI_NODATA : 0;
+}
+}  // namespace
+
+ResolverCache::ResolverCache(EventBus& bus, const std::string& run_id, int ttl_ms,
+                             int negative_ttl_ms)
+    : bus_(bus),
+      run_id_(symbols().intern(run_id)),
+      family_unknown_(symbols().intern("unknown")),
+      ttl_ms_(ttl_ms),
+      negative_ttl_ms_(negative_ttl_ms) {}
+
+ResolverCache::~ResolverCache() {
+    stop();
+}
+
+ResolverCache::Handle ResolverCache::add(const std::string& host, int port) {
+    for (Handle h = 0; h < entries_.size(); ++h)
+        if (entries_[h].host == host && entries_[h].port == port) return h;
+    Entry e;
+    e.host = host;
+    e.port = port;
+    e.host_sym = symbols().intern(host);
+    // Literals never touch the network, so they are resolved here and then left alone.
+    if (lookup(host, port, AI_NUMERICHOST, e.addrs) == 0) {
+        e.literal = true;
+        e.state = State::Ok;
+    }
+    entries_.push_back(std::move(e));
+    return entries_.size() - 1;
+}
+
+ResolverCache::Handle ResolverCache::pin(const std::string& host, int port,
+                                         const std::vector<std::string>& ips) {
+    Handle h = add(host, port);
+    Entry& e = entries_[h];
+    e.addrs.clear();
+    for (const auto& ip : ips)
+        if (lookup(ip, port, AI_NUMERICHOST, e.addrs) != 0)
+            log(LogLevel::WARN, "resolver cache: " + host + ": ignoring non-literal " + ip);
+    e.literal = true;
+    e.state = e.addrs.empty() ? State::Failed : State::Ok;
+    e.error = e.addrs.empty() ? EAI_NONAME : 0;
+    return h;
+}
+
+bool ResolverCache::start(Reactor& r) {
+    reactor_ = &r;
+    bool any = false;
+    for (const auto& e : entries_) any = any || !e.literal;
+    if (!any) return true;
+    event_fd_.reset(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+    if (!event_fd_ || !r.add_fd(event_fd_.get(), EPOLLIN, [this](uint32_t) { on_results(); })) {
+        log(LogLevel::ERROR, "resolver cache: eventfd unavailable");
+        return false;
+    }
+    stopping_ = false;
+    try {
+        thread_ = std::thread([this]() { worker(); });
+    } catch (const std::system_error&) {
+        log(LogLevel::ERROR, "resolver cache: failed to start thread");
+        return false;
+    }
+    for (Handle h = 0; h < entries_.size(); ++h)
+        if (!entries_[h].literal) request(h);
+    return true;
+}
+
+void ResolverCache::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        stopping_ = true;
+        requests_.clear();
+    }
+    cv_.notify_one();
+    if (thread_.joinable()) thread_.join();
+    if (!reactor_) return;
+    for (auto& e : entries_) {
+        reactor_->cancel_timer(e.refresh);
+        e.refresh = 0;
+    }
+    if (event_fd_) reactor_->del_fd(event_fd_.get());
+    event_fd_.reset();
+}
+
+void ResolverCache::request(Handle h) {
+    entries_[h].refresh = 0;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        requests_.push_back(h);
+    }
+    cv_.notify_one();
+}
+
+void ResolverCache::worker() {
+    std::unique_lock<std::mutex> lock(mu_);
+    for (;;) {
+        cv_.wait(lock, [this]() { return stopping_ || !requests_.empty(); });
+        if (stopping_) return;
+        Handle h = requests_.front();
+        requests_.pop_front();
+        lock.unlock();
+        // host and port are fixed once start() runs; the reactor only writes the other fields.
+        Result r{h, 0, 0, {}};
+        uint64_t t0 = monotonic_ns();
+        r.error = lookup(entries_[h].host, entries_[h].port, 0, r.addrs);
+        r.elapsed_ns = monotonic_ns() - t0;
+        lock.lock();
+        results_.push_back(std::move(r));
+        uint64_t one = 1;
+        (void)::write(event_fd_.get(), &one, sizeof(one));
+    }
+}
+
+void ResolverCache::on_results() {
+    uint64_t count;
+    (void)::read(event_fd_.get(), &count, sizeof(count));
+    std::vector<Result> done;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        done.swap(results_);
+    }
+    uint64_t now = monotonic_ns();
+    for (auto& r : done) {
+        Entry& e = entries_[r.h];
+        e.error = r.error;
+        if (r.error == 0) {
+            e.addrs = std::move(r.addrs);
+            e.state = State::Ok;
+        } else if (e.addrs.empty()) {
+            e.state = State::Failed;  // a failed refresh keeps serving the last good addresses
+        }
+        emit(e, r);
+        int ttl = r.error == 0 ? ttl_ms_ : negative_ttl_ms_;
+        Handle h = r.h;
+        e.refresh = reactor_->add_timer(now + static_cast<uint64_t>(ttl) * 1000000ULL,
+                                        [this, h]() { request(h); });
+    }
+}
+
+void ResolverCache::emit(const Entry& e, const Result& r) {
+    Event ev;
+    ev.run_id = run_id_;
+    ev.ts_monotonic_ns = monotonic_ns();
+    ev.ts_wall_ns = wall_ns();
+    ev.type = EventType::ResolveResult;
+    ev.target_name = e.host_sym;
+    ev.target_ip = r.error == 0 ? e.addrs.front().ip : e.host_sym;
+    ev.target_family = r.error == 0 ? e.addrs.front().family : family_unknown_;
+    ev.interval_ms = r.error == 0 ? ttl_ms_ : negative_ttl_ms_;
+    ev.timeout_ms = 0;
+    ev.ok = r.error == 0;
+    ev.metric_ms = r.elapsed_ns / 1e6;
+    ev.error = r.error == 0 ? ErrorCode::None : ErrorCode::DnsFailure;
+    ev.error_detail = r.error;
+    bus_.emit(ev);
+}
+}  // namespace irr
@@ -0,0 +1,105 @@
+#pragma once
+#include <sys/socket.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../core/event_bus.hpp"
+#include "../core/fd.hpp"
+#include "../core/reactor.hpp"
+#include "../core/time_utils.hpp"
+
+namespace irr {
+struct ResolvedAddr {
+    sockaddr_storage addr;
+    socklen_t len;
+    SymbolId ip;
+    SymbolId family;
+};
+
+// Host-name cache shared by the probes of one shard. getaddrinfo runs on a helper thread and
+// results come back to the reactor through an eventfd, so the reactor never blocks on the
+// system resolver and probes read addresses without a syscall. getaddrinfo reports no TTL, so
+// an entry lives for ttl_ms (negative_ttl_ms after a failure) and is then refreshed in the
+// background; the previous addresses are served until the refresh lands. Every lookup is
+// reported as a probe.resolve event. IP literals are parsed in add() and never refreshed.
+class ResolverCache {
+   public:
+    using Handle = size_t;
+    enum class State { Pending, Ok, Failed };
+
+    ResolverCache(EventBus& bus, const std::string& run_id, int ttl_ms = 60000,
+                  int negative_ttl_ms = 5000);
+    ~ResolverCache();
+    ResolverCache(const ResolverCache&) = delete;
+    ResolverCache& operator=(const ResolverCache&) = delete;
+
+    // Registers host:port (deduplicated) and returns its handle. Call before start().
+    Handle add(const std::string& host, int port);
+    // Registers host:port with a fixed list of IP literals instead of a lookup, like a literal
+    // host that resolves to several addresses. Unparsable entries are skipped; with none left
+    // the entry is Failed.
+    Handle pin(const std::string& host, int port, const std::vector<std::string>& ips);
+    // Opens the eventfd, starts the helper thread and queues the first lookups.
+    bool start(Reactor& r);
+    // Joins the helper thread once any lookup it is blocked in returns.
+    void stop();
+
+    // Pending until the first lookup completes; Failed only if no lookup has ever succeeded.
+    State state(Handle h) const {
+        return entries_[h].state;
+    }
+    // Addresses from the last successful lookup, in getaddrinfo order.
+    const std::vector<ResolvedAddr>& addrs(Handle h) const {
+        return entries_[h].addrs;
+    }
+    // getaddrinfo error of the last lookup, 0 if it succeeded.
+    int error(Handle h) const {
+        return entries_[h].error;
+    }
+
+   private:
+    struct Entry {
+        std::string host;
+        int port;
+        SymbolId host_sym;
+        bool literal{false};
+        State state{State::Pending};
+        int error{0};
+        std::vector<ResolvedAddr> addrs;
+        TimerId refresh{0};
+    };
+    struct Result {
+        Handle h;
+        int error;
+        uint64_t elapsed_ns;
+        std::vector<ResolvedAddr> addrs;
+    };
+
+    EventBus& bus_;
+    SymbolId run_id_;
+    SymbolId family_unknown_;
+    int ttl_ms_;
+    int negative_ttl_ms_;
+    Reactor* reactor_{nullptr};
+    std::vector<Entry> entries_;
+    Fd event_fd_;
+
+    // Shared with the helper thread.
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::deque<Handle> requests_;
+    std::vector<Result> results_;
+    bool stopping_{false};
+    std::thread thread_;
+
+    void worker();
+    void request(Handle h);
+    void on_results();
+    void emit(const Entry& e, const Result& r);
+};
+}  // namespace irr
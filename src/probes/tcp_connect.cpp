@@ -1,89 +1,190 @@
 #include "tcp_connect.hpp"
 
-#include <arpa/inet.h>
-#include <fcntl.h>
-#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/epoll.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <cerrno>
+
 #include "../core/logger.hpp"
 
 namespace irr {
-static bool set_nonblock(int fd) {
-    int flags = fcntl(fd, F_GETFL, 0);
-    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
-}
-
 TcpConnectProbe::TcpConnectProbe(EventBus& bus, const std::string& run_id)
-    : bus_(bus), run_id_(run_id) {}
+    : bus_(bus), run_id_(symbols().intern(run_id)), family_unknown_(symbols().intern("unknown")) {}
 
-void TcpConnectProbe::start(Reactor& r, int interval_ms, const std::vector<TcpTarget>& targets) {
+void TcpConnectProbe::start(Reactor& r, ResolverCache& resolver,
+                            const std::vector<TcpTarget>& targets) {
     reactor_ = &r;
+    resolver_ = &resolver;
     targets_ = targets;
-    for (const auto& t : targets_) new_attempt(t);
+    target_names_.clear();
+    target_hosts_.clear();
+    target_addrs_.clear();
+    for (const auto& t : targets_) {
+        target_names_.push_back(symbols().intern(t.name));
+        target_hosts_.push_back(symbols().intern(t.host));
+        target_addrs_.push_back(resolver.add(t.host, t.port));
+    }
+}
+
+void TcpConnectProbe::fire(size_t idx) {
+    if (reactor_ && idx < targets_.size()) new_attempt(idx);
+}
+
+void TcpConnectProbe::tick() {
+    for (size_t i = 0; i < targets_.size(); ++i) new_attempt(i);
 }
 
 void TcpConnectProbe::stop() {
-    for (auto& kv : inflight_) ::close(kv.first);
+    for (auto& kv : inflight_) {
+        if (reactor_) {
+            reactor_->del_fd(kv.first);
+            reactor_->cancel_timer(kv.second.timer);
+        }
+        ::close(kv.first);
+    }
     inflight_.clear();
+    rounds_.clear();
 }
 
-void TcpConnectProbe::new_attempt(const TcpTarget& t) {
-    addrinfo hints{};
-    hints.ai_socktype = SOCK_STREAM;
-    hints.ai_family = AF_UNSPEC;
-    addrinfo* res = nullptr;
-    std::string port = std::to_string(t.port);
-    if (getaddrinfo(t.host.c_str(), port.c_str(), &hints, &res) != 0 || !res) {
-        Event ev{run_id_, monotonic_ns(), wall_time_iso8601(), "probe.tcp.connect", t.name,
-                 t.host,  "unknown",      t.interval_ms,       t.timeout_ms,        false,
-                 0.0,     "dns_failure"};
-        bus_.emit(ev);
+void TcpConnectProbe::emit_failure(size_t idx, ErrorCode error, int detail) {
+    const auto& t = targets_[idx];
+    Event ev;
+    ev.run_id = run_id_;
+    ev.ts_monotonic_ns = monotonic_ns();
+    ev.ts_wall_ns = wall_ns();
+    ev.type = EventType::TcpConnect;
+    ev.target_name = target_names_[idx];
+    ev.target_ip = target_hosts_[idx];
+    ev.target_family = family_unknown_;
+    ev.interval_ms = t.interval_ms;
+    ev.timeout_ms = t.timeout_ms;
+    ev.ok = false;
+    ev.metric_ms = 0.0;
+    ev.error = error;
+    ev.error_detail = detail;
+    bus_.emit(ev);
+}
+
+void TcpConnectProbe::new_attempt(size_t idx) {
+    ResolverCache::Handle h = target_addrs_[idx];
+    if (resolver_->state(h) == ResolverCache::State::Pending) return;
+    const auto& addrs = resolver_->addrs(h);
+    if (addrs.empty()) {
+        emit_failure(idx, ErrorCode::DnsFailure, resolver_->error(h));
         return;
     }
-    int fd = ::socket(res->ai_family, res->ai_socktype | SOCK_NONBLOCK, res->ai_protocol);
-    if (fd < 0) {
-        freeaddrinfo(res);
+    if (!targets_[idx].all_addrs) {
+        connect_one(idx, addrs.front(), 0);
         return;
     }
-    set_nonblock(fd);
-    if (::connect(fd, res->ai_addr, res->ai_addrlen) < 0 && errno != EINPROGRESS) {
-        ::close(fd);
-        freeaddrinfo(res);
-        Event ev{run_id_,
-                 monotonic_ns(),
-                 wall_time_iso8601(),
-                 "probe.tcp.connect",
-                 t.name,
-                 t.host,
-                 "unknown",
-                 t.interval_ms,
-                 t.timeout_ms,
-                 false,
-                 0.0,
-                 "connect_immediate_fail"};
-        bus_.emit(ev);
+    // Happy Eyeballs mode: every address at once, each its own in-flight entry.
+    uint32_t round = next_round_++;
+    if (next_round_ == 0) next_round_ = 1;
+    rounds_[round] = Round{idx, monotonic_ns(), addrs.size()};
+    for (const auto& ra : addrs) connect_one(idx, ra, round);
+}
+
+void TcpConnectProbe::connect_one(size_t idx, const ResolvedAddr& ra, uint32_t round) {
+    const auto& t = targets_[idx];
+    Attempt a{-1, 0, target_names_[idx], ra.ip, ra.family, t.interval_ms, t.timeout_ms, 0, round};
+    int fd = ::socket(ra.addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0 || (::connect(fd, reinterpret_cast<const sockaddr*>(&ra.addr), ra.len) < 0 &&
+                   errno != EINPROGRESS)) {
+        int err = errno;
+        if (fd >= 0) ::close(fd);
+        emit_result(a, false, 0.0, ErrorCode::ConnectImmediateFail, err);
+        round_result(a, false, ErrorCode::ConnectImmediateFail, err);
         return;
     }
-    char ipbuf[64] = {};
-    if (res->ai_family == AF_INET) {
-        inet_ntop(AF_INET, &((sockaddr_in*)res->ai_addr)->sin_addr, ipbuf, sizeof(ipbuf));
-    } else if (res->ai_family == AF_INET6) {
-        inet_ntop(AF_INET6, &((sockaddr_in6*)res->ai_addr)->sin6_addr, ipbuf, sizeof(ipbuf));
-    } else {
-        std::snprintf(ipbuf, sizeof(ipbuf), "unknown");
-    }
-    Attempt a{fd,
-              monotonic_ns(),
-              t.name,
-              ipbuf,
-              res->ai_family == AF_INET6 ? "inet6" : "inet",
-              t.interval_ms,
-              t.timeout_ms};
+    a.fd = fd;
+    a.start_ns = monotonic_ns();
+    a.timer = reactor_->add_timer(a.start_ns + static_cast<uint64_t>(t.timeout_ms) * 1000000ULL,
+                                  [this, fd]() { handle_timeout(fd); });
     inflight_[fd] = a;
-    freeaddrinfo(res);
-    reactor_->add_fd(fd, EPOLLOUT | EPOLLERR, [this, fd](uint32_t ev) { handle_event(fd, ev); });
+    if (!reactor_->add_fd(fd, EPOLLOUT | EPOLLERR,
+                          [this, fd](uint32_t ev) { handle_event(fd, ev); })) {
+        int err = errno;
+        reactor_->cancel_timer(a.timer);
+        inflight_.erase(fd);
+        ::close(fd);
+        emit_result(a, false, 0.0, ErrorCode::ConnectImmediateFail, err);
+        round_result(a, false, ErrorCode::ConnectImmediateFail, err);
+    }
+}
+
+void TcpConnectProbe::round_result(const Attempt& a, bool ok, ErrorCode error, int detail) {
+    if (a.round == 0) return;
+    auto it = rounds_.find(a.round);
+    if (it == rounds_.end()) return;
+    Round& r = it->second;
+    --r.remaining;
+    if (ok && !r.reported) {
+        r.reported = true;
+        emit_first_success(r, &a, ErrorCode::None, 0);
+    } else if (!ok) {
+        r.last_error = error;
+        r.last_detail = detail;
+    }
+    if (r.remaining > 0) return;
+    if (!r.reported) emit_first_success(r, nullptr, r.last_error, r.last_detail);
+    rounds_.erase(it);
+}
+
+// One per Happy Eyeballs round: time from the first connect to the first address that
+// answered, or a failure carrying the last address's error once every address has failed.
+void TcpConnectProbe::emit_first_success(const Round& r, const Attempt* winner, ErrorCode error,
+                                         int detail) {
+    const auto& t = targets_[r.idx];
+    Event ev;
+    ev.run_id = run_id_;
+    ev.ts_monotonic_ns = monotonic_ns();
+    ev.ts_wall_ns = wall_ns();
+    ev.type = EventType::TcpFirstSuccess;
+    ev.target_name = target_names_[r.idx];
+    ev.target_ip = winner ? winner->ip : target_hosts_[r.idx];
+    ev.target_family = winner ? winner->family : family_unknown_;
+    ev.interval_ms = t.interval_ms;
+    ev.timeout_ms = t.timeout_ms;
+    ev.ok = winner != nullptr;
+    ev.metric_ms = (ev.ts_monotonic_ns - r.start_ns) / 1e6;
+    ev.error = error;
+    ev.error_detail = detail;
+    bus_.emit(ev);
+}
+
+void TcpConnectProbe::emit_result(const Attempt& a, bool ok, double ms, ErrorCode error,
+                                  int detail, double kernel_ms) {
+    Event ev;
+    ev.run_id = run_id_;
+    ev.ts_monotonic_ns = monotonic_ns();
+    ev.ts_wall_ns = wall_ns();
+    ev.type = EventType::TcpConnect;
+    ev.target_name = a.name;
+    ev.target_ip = a.ip;
+    ev.target_family = a.family;
+    ev.interval_ms = a.interval_ms;
+    ev.timeout_ms = a.timeout_ms;
+    ev.ok = ok;
+    ev.metric_ms = ms;
+    ev.kernel_ms = kernel_ms;
+    ev.error = error;
+    ev.error_detail = detail;
+    bus_.emit(ev);
+}
+
+// A blackholed SYN never produces EPOLLOUT; give up at the attempt's deadline.
+void TcpConnectProbe::handle_timeout(int fd) {
+    auto it = inflight_.find(fd);
+    if (it == inflight_.end()) return;
+    double ms = (monotonic_ns() - it->second.start_ns) / 1e6;
+    emit_result(it->second, false, ms, ErrorCode::Timeout, 0);
+    round_result(it->second, false, ErrorCode::Timeout, 0);
+    reactor_->del_fd(fd);
+    ::close(fd);
+    inflight_.erase(it);
 }
 
 void TcpConnectProbe::handle_event(int fd, uint32_t events) {
@@ -95,19 +196,17 @@ void TcpConnectProbe::handle_event(int fd, uint32_t events) {
     ::getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len);
     double ms = (monotonic_ns() - it->second.start_ns) / 1e6;
     bool ok = (err == 0);
-    Event ev{run_id_,
-             monotonic_ns(),
-             wall_time_iso8601(),
-             "probe.tcp.connect",
-             it->second.name,
-             it->second.ip,
-             it->second.family,
-             it->second.interval_ms,
-             it->second.timeout_ms,
-             ok,
-             ms,
-             ok ? "" : std::string("so_error_") + std::to_string(err)};
-    bus_.emit(ev);
+    double kernel_ms = -1.0;
+    if (ok && kernel_ts_) {
+        // The SYN/SYN-ACK sample, taken by the kernel when the handshake completed.
+        tcp_info info{};
+        socklen_t ilen = sizeof(info);
+        if (::getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &ilen) == 0 && info.tcpi_rtt > 0)
+            kernel_ms = info.tcpi_rtt / 1000.0;
+    }
+    emit_result(it->second, ok, ms, ok ? ErrorCode::None : ErrorCode::SoError, err, kernel_ms);
+    round_result(it->second, ok, ok ? ErrorCode::None : ErrorCode::SoError, err);
+    reactor_->cancel_timer(it->second.timer);
     reactor_->del_fd(fd);
     ::close(fd);
     inflight_.erase(it);
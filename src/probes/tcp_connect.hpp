@@ -8,6 +8,7 @@
 #include "../core/event_bus.hpp"
 #include "../core/reactor.hpp"
 #include "../core/time_utils.hpp"
+#include "resolver_cache.hpp"
 
 namespace irr {
 struct TcpTarget {
@@ -16,30 +17,72 @@ struct TcpTarget {
     int port;
     int interval_ms;
     int timeout_ms;
+    // Happy Eyeballs mode: connect to every resolved address concurrently (one
+    // probe.tcp.connect each) and report the first to succeed as probe.tcp.first_success.
+    bool all_addrs{false};
 };
 
 class TcpConnectProbe {
    public:
     TcpConnectProbe(EventBus& bus, const std::string& run_id);
-    void start(Reactor& r, int interval_ms, const std::vector<TcpTarget>& targets);
+    // Stores the target list, interning names once and registering hosts with the resolver
+    // cache. Attempts are driven by fire()/tick().
+    void start(Reactor& r, ResolverCache& resolver, const std::vector<TcpTarget>& targets);
+    // Issues one connect attempt to targets()[idx] using its cached address; skipped while
+    // the host's first lookup is still running.
+    void fire(size_t idx);
+    // Issues one connect attempt per target.
+    void tick();
+    const std::vector<TcpTarget>& targets() const {
+        return targets_;
+    }
     void stop();
+    // Also records the kernel's handshake RTT (TCP_INFO tcpi_rtt) as Event::kernel_ms.
+    void set_kernel_timestamps(bool on) {
+        kernel_ts_ = on;
+    }
 
    private:
     struct Attempt {
         int fd;
         uint64_t start_ns;
-        std::string name;
-        std::string ip;
-        std::string family;
+        SymbolId name;
+        SymbolId ip;
+        SymbolId family;
         int interval_ms;
         int timeout_ms;
+        TimerId timer;
+        uint32_t round;  // Happy Eyeballs round, 0 if none
+    };
+    struct Round {
+        size_t idx;
+        uint64_t start_ns;
+        size_t remaining;
+        bool reported{false};
+        ErrorCode last_error{ErrorCode::None};
+        int last_detail{0};
     };
     EventBus& bus_;
-    std::string run_id_;
+    SymbolId run_id_;
+    SymbolId family_unknown_;
     Reactor* reactor_{nullptr};
+    ResolverCache* resolver_{nullptr};
+    bool kernel_ts_{false};
     std::vector<TcpTarget> targets_;
+    std::vector<SymbolId> target_names_;
+    std::vector<SymbolId> target_hosts_;
+    std::vector<ResolverCache::Handle> target_addrs_;
     std::unordered_map<int, Attempt> inflight_;
-    void new_attempt(const TcpTarget& t);
+    std::unordered_map<uint32_t, Round> rounds_;
+    uint32_t next_round_{1};
+    void new_attempt(size_t idx);
+    void connect_one(size_t idx, const ResolvedAddr& ra, uint32_t round);
+    void round_result(const Attempt& a, bool ok, ErrorCode error, int detail);
+    void emit_first_success(const Round& r, const Attempt* winner, ErrorCode error, int detail);
+    void emit_failure(size_t idx, ErrorCode error, int detail = 0);
     void handle_event(int fd, uint32_t events);
+    void handle_timeout(int fd);
+    void emit_result(const Attempt& a, bool ok, double ms, ErrorCode error, int detail,
+                     double kernel_ms = -1.0);
 };
 }  // namespace irr
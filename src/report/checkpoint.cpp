@@ -0,0 +1,138 @@
+#include "checkpoint.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string_view>
+#include <system_error>
+
+#include "../core/logger.hpp"
+#include "../util/byte_io.hpp"
+#include "../util/siphash.hpp"
+
+namespace irr {
+namespace {
+// Layout: magic, version, sketch options, file identity, ReportStats, then a SipHash of
+// everything before it.
+constexpr uint32_t kMagic = 0x4b525249;  // "IRRK"
+constexpr uint16_t kVersion = 1;
+constexpr SipKey kKey{0x697272636b707431ULL, 0x7265706f72747374ULL};
+
+// The error the sketches were actually built with (QuantileSketch clamps the option).
+double sketch_error(const ReportOptions& opts) {
+    return QuantileSketch(opts.relative_error).relative_error();
+}
+
+uint64_t hash(const char* data, uint64_t begin, uint64_t end) {
+    return siphash24(kKey, data + begin, static_cast<size_t>(end - begin));
+}
+
+void save_stats(std::string& out, const ReportStats& st) {
+    put_raw(out, static_cast<uint64_t>(st.total));
+    put_raw(out, static_cast<uint64_t>(st.failures));
+    st.metrics.save(out);
+    put_raw(out, static_cast<uint32_t>(st.per_target.size()));
+    for (const auto& kv : st.per_target) {
+        put_string(out, kv.first);
+        kv.second.save(out);
+    }
+    put_raw(out, static_cast<uint32_t>(st.per_target_fail.size()));
+    for (const auto& kv : st.per_target_fail) {
+        put_string(out, kv.first);
+        put_raw(out, static_cast<uint64_t>(kv.second));
+    }
+    st.timeline.save(out);
+}
+
+bool load_stats(ByteReader& in, ReportStats& st) {
+    st.total = in.raw<uint64_t>();
+    st.failures = in.raw<uint64_t>();
+    if (!st.metrics.load(in)) return false;
+    auto targets = in.raw<uint32_t>();
+    for (uint32_t i = 0; in.ok && i < targets; ++i) {
+        std::string name(in.string());
+        if (!st.per_target[name].load(in)) return false;
+    }
+    auto fails = in.raw<uint32_t>();
+    for (uint32_t i = 0; in.ok && i < fails; ++i) {
+        std::string name(in.string());
+        st.per_target_fail[name] = in.raw<uint64_t>();
+    }
+    return in.ok && st.timeline.load(in);
+}
+}  // namespace
+
+void ReportCheckpoint::stamp(uint64_t file_dev, uint64_t file_ino, const char* data,
+                             uint64_t end) {
+    dev = file_dev;
+    ino = file_ino;
+    offset = end;
+    uint64_t n = std::min<uint64_t>(kHashBytes, end);
+    head_hash = hash(data, 0, n);
+    tail_hash = hash(data, end - n, end);
+}
+
+bool ReportCheckpoint::matches(uint64_t file_dev, uint64_t file_ino, const char* data,
+                               uint64_t size) const {
+    if (file_dev != dev || file_ino != ino || size < offset) return false;
+    if (offset > 0 && data[offset - 1] != '\n') return false;
+    uint64_t n = std::min<uint64_t>(kHashBytes, offset);
+    return hash(data, 0, n) == head_hash && hash(data, offset - n, offset) == tail_hash;
+}
+
+bool save_checkpoint(const std::string& path, const ReportCheckpoint& ck,
+                     const ReportOptions& opts) {
+    std::string out;
+    put_raw(out, kMagic);
+    put_raw(out, kVersion);
+    put_raw(out, static_cast<uint8_t>(opts.exact));
+    put_raw(out, sketch_error(opts));
+    put_raw(out, ck.dev);
+    put_raw(out, ck.ino);
+    put_raw(out, ck.offset);
+    put_raw(out, ck.head_hash);
+    put_raw(out, ck.tail_hash);
+    save_stats(out, ck.stats);
+    put_raw(out, siphash24(kKey, out.data(), out.size()));
+
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        if (!f.write(out.data(), static_cast<std::streamsize>(out.size())) || !f.flush()) {
+            log(LogLevel::WARN, "cannot write report checkpoint " + tmp);
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        log(LogLevel::WARN, "cannot install report checkpoint " + path + ": " + ec.message());
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
+
+bool load_checkpoint(const std::string& path, const ReportOptions& opts, ReportCheckpoint& ck) {
+    std::ifstream f(path, std::ios::binary);
+    if (!f.is_open()) return false;
+    std::string data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(uint64_t)) return false;
+    size_t body = data.size() - sizeof(uint64_t);
+    ByteReader trailer(std::string_view(data).substr(body));
+    if (trailer.raw<uint64_t>() != siphash24(kKey, data.data(), body)) return false;
+
+    ByteReader in(std::string_view(data.data(), body));
+    if (in.raw<uint32_t>() != kMagic || in.raw<uint16_t>() != kVersion) return false;
+    if ((in.raw<uint8_t>() != 0) != opts.exact) return false;
+    if (in.raw<double>() != sketch_error(opts) && !opts.exact) return false;
+    ck.dev = in.raw<uint64_t>();
+    ck.ino = in.raw<uint64_t>();
+    ck.offset = in.raw<uint64_t>();
+    ck.head_hash = in.raw<uint64_t>();
+    ck.tail_hash = in.raw<uint64_t>();
+    ck.stats = ReportStats();
+    return in.ok && load_stats(in, ck.stats) && in.p == in.end;
+}
+}  // namespace irr
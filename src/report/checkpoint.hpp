@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "report_gen.hpp"
+
+namespace irr {
+// Aggregation state for the first `offset` bytes of events.jsonl, kept next to the bundle
+// (report.ckpt) so the next `irr report` only parses what was appended since. The file is
+// recognised by device and inode plus hashes of its first bytes and of the bytes just before
+// offset, which catches rotation, truncation and rewrites in place.
+struct ReportCheckpoint {
+    static constexpr size_t kHashBytes = 4096;
+
+    uint64_t dev{0};
+    uint64_t ino{0};
+    uint64_t offset{0};  // just past the last complete line aggregated
+    uint64_t head_hash{0};
+    uint64_t tail_hash{0};
+    ReportStats stats;
+
+    // Records the identity of data[0, offset).
+    void stamp(uint64_t file_dev, uint64_t file_ino, const char* data, uint64_t end);
+    // True if the file (size bytes now) still begins with the bytes that were aggregated.
+    bool matches(uint64_t file_dev, uint64_t file_ino, const char* data, uint64_t size) const;
+};
+
+// Writes a temporary file and renames it into place; false (and logged) on I/O errors.
+bool save_checkpoint(const std::string& path, const ReportCheckpoint& ck,
+                     const ReportOptions& opts);
+// False if the file is missing, corrupt, from another format version, or was built with
+// different sketch options.
+bool load_checkpoint(const std::string& path, const ReportOptions& opts, ReportCheckpoint& ck);
+}  // namespace irr
@@ -0,0 +1,421 @@
+#include "jsonl_scan.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IRR_SCAN_X86 1
+#endif
+
+namespace irr {
+namespace {
+// Bitmasks of '"' and '\\' for the 64 bytes at p (bit i = byte i).
+struct BlockMasks {
+    uint64_t quote;
+    uint64_t backslash;
+};
+using BlockFn = BlockMasks (*)(const char* p);
+
+BlockMasks block_scalar(const char* p) {
+    BlockMasks m{0, 0};
+    for (int i = 0; i < 64; ++i) {
+        m.quote |= static_cast<uint64_t>(p[i] == '"') << i;
+        m.backslash |= static_cast<uint64_t>(p[i] == '\\') << i;
+    }
+    return m;
+}
+
+#ifdef IRR_SCAN_X86
+__attribute__((target("sse2"))) BlockMasks block_sse2(const char* p) {
+    const __m128i q = _mm_set1_epi8('"');
+    const __m128i bs = _mm_set1_epi8('\\');
+    BlockMasks m{0, 0};
+    for (int i = 0; i < 4; ++i) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i));
+        auto mq = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, q)));
+        auto mb = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, bs)));
+        m.quote |= static_cast<uint64_t>(mq) << (16 * i);
+        m.backslash |= static_cast<uint64_t>(mb) << (16 * i);
+    }
+    return m;
+}
+
+__attribute__((target("avx2"))) BlockMasks block_avx2(const char* p) {
+    const __m256i q = _mm256_set1_epi8('"');
+    const __m256i bs = _mm256_set1_epi8('\\');
+    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+    auto q0 = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, q)));
+    auto q1 = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, q)));
+    auto b0 = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, bs)));
+    auto b1 = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, bs)));
+    return {q0 | (static_cast<uint64_t>(q1) << 32), b0 | (static_cast<uint64_t>(b1) << 32)};
+}
+#endif
+
+JsonlScanIsa best_isa() {
+#ifdef IRR_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return JsonlScanIsa::Avx2;
+    if (__builtin_cpu_supports("sse2")) return JsonlScanIsa::Sse2;
+#endif
+    return JsonlScanIsa::Scalar;
+}
+
+BlockFn block_fn(JsonlScanIsa isa) {
+#ifdef IRR_SCAN_X86
+    if (isa == JsonlScanIsa::Avx2) return block_avx2;
+    if (isa == JsonlScanIsa::Sse2) return block_sse2;
+#endif
+    return block_scalar;
+}
+
+JsonlScanIsa g_isa = best_isa();
+BlockFn g_block = block_fn(g_isa);
+
+// Walks a line 64 bytes at a time, yielding the positions of unescaped quotes. A quote is
+// escaped when preceded by an odd run of backslashes; runs may straddle blocks.
+class QuoteCursor {
+   public:
+    explicit QuoteCursor(std::string_view line) : p_(line.data()), n_(line.size()) {}
+
+    // Position of the next unescaped quote, or the line length if there is none.
+    size_t next() {
+        while (mask_ == 0) {
+            if (base_ >= n_) return n_;
+            load();
+        }
+        size_t pos = base_ - 64 + static_cast<size_t>(__builtin_ctzll(mask_));
+        mask_ &= mask_ - 1;
+        return pos < n_ ? pos : n_;
+    }
+
+    // Appends the positions of up to `max` further quotes to out; returns how many.
+    size_t take(size_t* out, size_t max) {
+        size_t k = 0;
+        for (;;) {
+            while (mask_ != 0 && k < max) {
+                out[k++] = base_ - 64 + static_cast<size_t>(__builtin_ctzll(mask_));
+                mask_ &= mask_ - 1;
+            }
+            if (k == max || base_ >= n_) return k;
+            load();
+        }
+    }
+
+    bool saw_backslash() const {
+        return saw_backslash_;
+    }
+
+   private:
+    const char* p_;
+    size_t n_;
+    size_t base_{0};  // start of the next block to load
+    uint64_t mask_{0};
+    bool carry_{false};  // the previous block ended with an unpaired backslash
+    bool saw_backslash_{false};
+
+    void load() {
+        BlockMasks m;
+        if (n_ - base_ >= 64) {
+            m = g_block(p_ + base_);
+        } else {
+            char tail[64] = {};
+            std::memcpy(tail, p_ + base_, n_ - base_);
+            m = g_block(tail);
+        }
+        uint64_t escaped = carry_ ? 1 : 0;
+        carry_ = false;
+        if (m.backslash) {
+            saw_backslash_ = true;
+            for (uint64_t b = m.backslash; b; b &= b - 1) {
+                int i = __builtin_ctzll(b);
+                if ((escaped >> i) & 1) continue;  // itself escaped
+                if (i == 63)
+                    carry_ = true;
+                else
+                    escaped |= uint64_t{1} << (i + 1);
+            }
+        }
+        mask_ = m.quote & ~escaped;
+        base_ += 64;
+    }
+};
+
+void append_utf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+bool hex4(std::string_view s, size_t i, uint32_t& out) {
+    if (i + 4 > s.size()) return false;
+    auto r = std::from_chars(s.data() + i, s.data() + i + 4, out, 16);
+    return r.ptr == s.data() + i + 4;
+}
+
+// Decodes JSON escapes in s (the raw string body) into scratch.
+std::string_view unescape(std::string_view s, std::string& scratch) {
+    scratch.clear();
+    for (size_t i = 0; i < s.size(); ++i) {
+        char c = s[i];
+        if (c != '\\' || i + 1 == s.size()) {
+            scratch.push_back(c);
+            continue;
+        }
+        char e = s[++i];
+        switch (e) {
+            case 'b':
+                scratch.push_back('\b');
+                break;
+            case 'f':
+                scratch.push_back('\f');
+                break;
+            case 'n':
+                scratch.push_back('\n');
+                break;
+            case 'r':
+                scratch.push_back('\r');
+                break;
+            case 't':
+                scratch.push_back('\t');
+                break;
+            case 'u': {
+                uint32_t cp = 0;
+                if (!hex4(s, i + 1, cp)) {
+                    scratch.push_back(e);
+                    break;
+                }
+                i += 4;
+                uint32_t lo = 0;
+                if (cp >= 0xD800 && cp < 0xDC00 && i + 2 < s.size() && s[i + 1] == '\\' &&
+                    s[i + 2] == 'u' && hex4(s, i + 3, lo) && lo >= 0xDC00 && lo < 0xE000) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                    i += 6;
+                }
+                append_utf8(scratch, cp);
+                break;
+            }
+            default:  // '"', '\\', '/'
+                scratch.push_back(e);
+                break;
+        }
+    }
+    return scratch;
+}
+
+bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// String indexes in a line as JsonlStore writes it: run_id, its value, ts_monotonic_ns,
+// ts_wall, its value, then the keys below. Everything after metric_ms is optional.
+constexpr int kTsKey = 2;
+constexpr int kTypeKey = 5;
+constexpr int kTargetKey = 7;
+constexpr int kNameKey = 8;
+constexpr int kResultKey = 17;
+constexpr int kOkKey = 18;
+constexpr int kMetricKey = 19;
+constexpr int kFixedStrings = kMetricKey + 1;
+
+// Fast path for the writer's own layout: collects the first kFixedStrings strings, checks the
+// keys where the schema puts them and reads the values at their known offsets. False if the
+// line is laid out any other way.
+bool scan_fixed(std::string_view line, JsonlFields& out) {
+    const char* s = line.data();
+    size_t n = line.size();
+    QuoteCursor quotes(line);
+    size_t q[2 * kFixedStrings];
+    if (quotes.take(q, 2 * kFixedStrings) != 2 * kFixedStrings) return false;
+    auto str = [&](int k) {
+        return std::string_view(s + q[2 * k] + 1, q[2 * k + 1] - q[2 * k] - 1);
+    };
+    // A key is followed by ':'; keys holding a string or an object are followed by '"' or '{'.
+    auto key = [&](int k, std::string_view name, char next) {
+        size_t after = q[2 * k + 1];
+        return str(k) == name && after + 2 < n && s[after + 1] == ':' && s[after + 2] == next;
+    };
+    if (!key(kTypeKey, "type", '"') || !key(kTargetKey, "target", '{') ||
+        !key(kNameKey, "name", '"') || !key(kResultKey, "result", '{'))
+        return false;
+    size_t ok_at = q[2 * kOkKey + 1] + 2;
+    size_t metric_at = q[2 * kMetricKey + 1] + 2;
+    if (str(kOkKey) != "ok" || str(kMetricKey) != "metric_ms" || metric_at >= n ||
+        s[metric_at - 1] != ':')
+        return false;
+    size_t ts_at = q[2 * kTsKey + 1] + 2;
+    if (str(kTsKey) == "ts_monotonic_ns" && s[ts_at - 1] == ':')
+        std::from_chars(s + ts_at, s + q[2 * (kTsKey + 1)], out.ts_monotonic_ns);
+    std::string_view ok(s + ok_at, q[2 * kMetricKey] - ok_at);  // "true," or "false,"
+    if (ok == "true,") {
+        out.ok = true;
+    } else if (ok != "false,") {
+        return false;
+    }
+    out.has_ok = true;
+    size_t end = metric_at;
+    while (end < n && s[end] != ',' && s[end] != '}') ++end;
+    auto r = std::from_chars(s + metric_at, s + end, out.metric_ms);
+    out.has_metric = r.ec == std::errc() && r.ptr == s + end;
+    out.type = str(kTypeKey + 1);
+    out.target_name = str(kNameKey + 1);
+    return true;
+}
+}  // namespace
+
+bool set_jsonl_scan_isa(JsonlScanIsa isa) {
+    if (static_cast<int>(isa) > static_cast<int>(best_isa())) return false;
+    g_isa = isa;
+    g_block = block_fn(isa);
+    return true;
+}
+
+JsonlScanIsa jsonl_scan_isa() {
+    return g_isa;
+}
+
+bool scan_event_line(std::string_view line, JsonlFields& out, std::string& scratch) {
+    out = JsonlFields{};
+    if (scan_fixed(line, out)) {
+        if (out.target_name.find('\\') != std::string_view::npos)
+            out.target_name = unescape(out.target_name, scratch);
+        return out.has_metric;
+    }
+    out = JsonlFields{};
+    QuoteCursor quotes(line);
+    const char* s = line.data();
+    size_t n = line.size();
+    int depth = 0;
+    std::string_view key;     // pending key at the current depth
+    std::string_view parent;  // key of the depth-2 object we are in
+    bool have_type = false;
+    size_t pos = 0;
+    for (;;) {
+        size_t open = quotes.next();
+        // Structure and bare values between two strings: ':', ',', braces, numbers, literals.
+        while (pos < open) {
+            char c = s[pos];
+            if (c == '{') {
+                if (++depth == 2) parent = key;
+                key = {};
+                ++pos;
+            } else if (c == '}') {
+                if (depth-- == 2) parent = {};
+                ++pos;
+            } else if (c == ':' || c == ',' || c == '[' || c == ']' || is_space(c)) {
+                ++pos;
+            } else {
+                // A bare value: only ts_monotonic_ns, result.ok and result.metric_ms are of
+                // interest.
+                size_t end = pos;
+                while (end < open && s[end] != ',' && s[end] != '}' && s[end] != ']' &&
+                       !is_space(s[end]))
+                    ++end;
+                if (depth == 1 && key == "ts_monotonic_ns") {
+                    std::from_chars(s + pos, s + end, out.ts_monotonic_ns);
+                } else if (depth == 2 && parent == "result") {
+                    if (key == "ok") {
+                        std::string_view v(s + pos, end - pos);
+                        out.has_ok = v == "true" || v == "false";
+                        out.ok = v == "true";
+                    } else if (key == "metric_ms") {
+                        auto r = std::from_chars(s + pos, s + end, out.metric_ms);
+                        out.has_metric = r.ec == std::errc() && r.ptr == s + end;
+                    }
+                }
+                key = {};
+                pos = end;
+            }
+        }
+        if (open >= n) break;
+        size_t close = quotes.next();
+        if (close >= n) return false;  // unterminated string
+        std::string_view str(s + open + 1, close - open - 1);
+        pos = close + 1;
+        while (pos < n && is_space(s[pos])) ++pos;
+        if (pos < n && s[pos] == ':') {
+            key = str;
+            continue;
+        }
+        if (depth == 1 && key == "type") {
+            out.type = str;
+            have_type = true;
+        } else if (depth == 2 && parent == "target" && key == "name") {
+            out.target_name = str;
+        }
+        key = {};
+    }
+    // Escapes are rare (the writer only emits them for quotes, backslashes and control
+    // characters), so only decode when this line had any backslash at all.
+    if (quotes.saw_backslash() && out.target_name.find('\\') != std::string_view::npos)
+        out.target_name = unescape(out.target_name, scratch);
+    return have_type && out.has_metric;
+}
+
+JsonlFileReader::~JsonlFileReader() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+bool JsonlFileReader::open(const std::string& path) {
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) return false;
+    buf_.resize(kChunk);
+    return true;
+}
+
+// Moves the unfinished line to the front and reads more after it, growing the buffer if a
+// single line fills it. False at end of file.
+bool JsonlFileReader::fill() {
+    if (eof_ || fd_ < 0) return false;
+    std::memmove(buf_.data(), buf_.data() + pos_, end_ - pos_);
+    end_ -= pos_;
+    pos_ = 0;
+    if (end_ == buf_.size()) buf_.resize(buf_.size() * 2);
+    for (;;) {
+        ssize_t n = ::read(fd_, buf_.data() + end_, buf_.size() - end_);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            eof_ = true;
+            return false;
+        }
+        end_ += static_cast<size_t>(n);
+        return true;
+    }
+}
+
+bool JsonlFileReader::next(std::string_view& line) {
+    for (;;) {
+        const char* start = buf_.data() + pos_;
+        const auto* nl = static_cast<const char*>(std::memchr(start, '\n', end_ - pos_));
+        if (nl) {
+            line = std::string_view(start, static_cast<size_t>(nl - start));
+            pos_ += line.size() + 1;
+            return true;
+        }
+        if (!fill()) break;
+    }
+    if (pos_ == end_) return false;
+    line = std::string_view(buf_.data() + pos_, end_ - pos_);
+    pos_ = end_;
+    return true;
+}
+}  // namespace irr
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace irr {
+// The fields of one JsonlStore line that the report uses. The views point into the scanned
+// line, or into the caller's scratch string when the value contained escapes, and are valid
+// until either changes.
+struct JsonlFields {
+    uint64_t ts_monotonic_ns{0};  // 0 when absent
+    std::string_view type;
+    std::string_view target_name;  // target.name
+    bool ok{false};                // result.ok
+    bool has_ok{false};
+    double metric_ms{0};  // result.metric_ms
+    bool has_metric{false};
+};
+
+// Instruction set used to classify 64-byte blocks of a line. The fastest one the CPU supports
+// is picked at startup.
+enum class JsonlScanIsa { Scalar, Sse2, Avx2 };
+
+// Switches the block classifier (benchmarks and tests); false if the CPU lacks it.
+bool set_jsonl_scan_isa(JsonlScanIsa isa);
+JsonlScanIsa jsonl_scan_isa();
+
+// Single pass over one line (without its '\n'). Each 64-byte block is turned into bitmasks of
+// quotes and backslashes, escaped quotes are masked out, and only the string boundaries and
+// the short stretches between them are visited: keys are tracked with their enclosing object
+// so "name" is read only under "target" and "ok"/"metric_ms" only under "result". Numbers go
+// through std::from_chars. Returns false unless the line has a "type" string and a metric.
+bool scan_event_line(std::string_view line, JsonlFields& out, std::string& scratch);
+
+// Splits a file into lines through one large read buffer (no per-line allocation or copy).
+// A final line without a newline is still returned.
+class JsonlFileReader {
+   public:
+    static constexpr size_t kChunk = 4 << 20;
+
+    JsonlFileReader() = default;
+    ~JsonlFileReader();
+    JsonlFileReader(const JsonlFileReader&) = delete;
+    JsonlFileReader& operator=(const JsonlFileReader&) = delete;
+
+    bool open(const std::string& path);
+    // The view is valid until the next call.
+    bool next(std::string_view& line);
+
+   private:
+    int fd_{-1};
+    bool eof_{false};
+    std::vector<char> buf_;
+    size_t pos_{0};
+    size_t end_{0};
+
+    bool fill();
+};
+}  // namespace irr
@@ -1,27 +1,30 @@
 #include "report_gen.hpp"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <algorithm>
-#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
-#include <sstream>
+#include <map>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
 #include "../core/logger.hpp"
-#include "../util/percentile.hpp"
+#include "../core/store_columnar.hpp"
+#include "../util/format.hpp"
+#include "checkpoint.hpp"
+#include "jsonl_scan.hpp"
 
 namespace irr {
 namespace {
-struct ParsedEventLine {
-    std::string type;
-    std::string target_name;
-    bool ok{false};
-    bool has_ok{false};
-    double metric_ms{0};
-    bool has_metric{false};
-};
-
 std::string html_escape(const std::string& in) {
     std::string out;
     out.reserve(in.size());
@@ -49,136 +52,281 @@ std::string html_escape(const std::string& in) {
     }
     return out;
 }
+}  // namespace
 
-// Extract substring that is the object value of a key, handling nested braces.
-bool extract_object_substr(const std::string& line, const std::string& key, std::string& out) {
-    auto pos = line.find("\"" + key + "\":{");
-    if (pos == std::string::npos) return false;
-    pos = line.find('{', pos);
-    if (pos == std::string::npos) return false;
-    int depth = 0;
-    for (size_t i = pos; i < line.size(); ++i) {
-        if (line[i] == '{')
-            depth++;
-        else if (line[i] == '}')
-            depth--;
-        if (depth == 0) {
-            out = line.substr(pos, i - pos + 1);
-            return true;
-        }
+namespace {
+bool is_probe_result(std::string_view type) {
+    return type == "probe.tcp.connect" || type == "probe.dns.result" ||
+           type == "probe.dns.timeout" || type == "probe.icmp.rtt" || type == "probe.icmp.timeout";
+}
+
+void accumulate(ReportStats& stats, uint64_t ts_ns, std::string_view type,
+                std::string_view target, bool ok, double metric_ms) {
+    if (!is_probe_result(type)) return;
+    if (type == "probe.tcp.connect") stats.timeline.add(target, ts_ns, ok, metric_ms);
+    static thread_local std::string key;  // reused so map lookups do not allocate per event
+    key.assign(target.data(), target.size());
+    ++stats.total;
+    if (ok) {
+        stats.metrics.add(metric_ms);
+        auto it = stats.per_target.find(key);
+        if (it == stats.per_target.end())
+            it = stats.per_target.emplace(key, stats.metrics.empty_like()).first;
+        it->second.add(metric_ms);
+    } else {
+        ++stats.failures;
+        stats.per_target_fail[key] += 1;
     }
-    return false;
 }
 
-bool extract_bool(const std::string& line, const std::string& key, bool& out) {
-    auto pos = line.find("\"" + key + "\":");
-    if (pos == std::string::npos) return false;
-    pos += key.size() + 3;
-    while (pos < line.size() && std::isspace(static_cast<unsigned char>(line[pos]))) ++pos;
-    if (line.compare(pos, 4, "true") == 0) {
-        out = true;
-        return true;
+void accumulate(ReportStats& stats, const JsonlFields& f) {
+    accumulate(stats, f.ts_monotonic_ns, f.type, f.target_name, f.has_ok && f.ok, f.metric_ms);
+}
+
+bool load_jsonl(const std::string& path, ReportStats& stats) {
+    JsonlFileReader in;
+    if (!in.open(path)) return false;
+    std::string_view line;
+    std::string scratch;
+    JsonlFields f;
+    while (in.next(line)) {
+        if (scan_event_line(line, f, scratch)) accumulate(stats, f);
     }
-    if (line.compare(pos, 5, "false") == 0) {
-        out = false;
-        return true;
+    return true;
+}
+
+// Decodes segments [first, last) of the index; false at the first invalid one.
+bool scan_segments(const ColumnarReader& reader, const std::vector<size_t>& offsets,
+                   size_t first, size_t last, ReportStats& stats) {
+    std::vector<ColumnarRecord> batch;
+    std::vector<std::string_view> dict;
+    for (size_t s = first; s < last; ++s) {
+        size_t offset = offsets[s];
+        if (!reader.next_segment(offset, batch, dict)) return false;
+        for (const auto& r : batch)
+            accumulate(stats, r.ts_monotonic_ns, r.type, r.target_name, r.ok, r.metric_ms);
     }
-    return false;
+    return true;
 }
 
-bool extract_double(const std::string& line, const std::string& key, double& out) {
-    auto pos = line.find("\"" + key + "\":");
-    if (pos == std::string::npos) return false;
-    pos += key.size() + 3;
-    size_t end = pos;
-    while (end < line.size() && (std::isdigit(static_cast<unsigned char>(line[end])) ||
-                                 line[end] == '.' || line[end] == '-'))
-        ++end;
-    try {
-        out = std::stod(line.substr(pos, end - pos));
-        return true;
-    } catch (...) {
-        return false;
+// Scans the lines in [p, end); the last one may lack its '\n' (end of file), as with
+// JsonlFileReader.
+void scan_range(const char* p, const char* end, ReportStats& stats) {
+    std::string scratch;
+    JsonlFields f;
+    while (p < end) {
+        const auto* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        const char* stop = nl ? nl : end;
+        if (scan_event_line(std::string_view(p, static_cast<size_t>(stop - p)), f, scratch))
+            accumulate(stats, f);
+        p = stop + 1;
+    }
+}
+
+// Adds a later chunk's partial; called in chunk order so exact-mode samples keep file order.
+void merge(ReportStats& stats, const ReportStats& part) {
+    stats.total += part.total;
+    stats.failures += part.failures;
+    stats.metrics.merge(part.metrics);
+    stats.timeline.merge(part.timeline);
+    for (const auto& kv : part.per_target) {
+        auto it = stats.per_target.find(kv.first);
+        if (it == stats.per_target.end())
+            stats.per_target.emplace(kv.first, kv.second);
+        else
+            it->second.merge(kv.second);
     }
+    for (const auto& kv : part.per_target_fail) stats.per_target_fail[kv.first] += kv.second;
 }
 
-bool extract_string(const std::string& line, const std::string& key, std::string& out) {
-    auto pos = line.find("\"" + key + "\":\"");
-    if (pos == std::string::npos) return false;
-    size_t start = pos + key.size() + 4;
-    size_t end = line.find('"', start);
-    if (end == std::string::npos) return false;
-    out = line.substr(start, end - start);
+unsigned pick_threads(const ReportOptions& opts, size_t size) {
+    if (opts.threads) return opts.threads;
+    unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+    size_t by_size = std::max<size_t>(1, size / ReportOptions::kMinChunkBytes);
+    return static_cast<unsigned>(std::min<size_t>(hw, by_size));
+}
+
+// Segments are self-describing, so runs of them are decoded on separate threads and merged
+// in file order like JSONL chunks. Everything after an invalid segment is dropped, as a serial
+// read would stop there.
+bool load_columnar(const std::string& path, const ReportOptions& opts, ReportStats& stats) {
+    ColumnarReader reader;
+    if (!reader.open(path)) return false;
+    std::vector<size_t> offsets;
+    size_t end = reader.segment_offsets(offsets);
+    size_t segments = offsets.size();
+    auto n = static_cast<unsigned>(
+        std::min<size_t>(pick_threads(opts, reader.size()), std::max<size_t>(segments, 1)));
+    std::vector<size_t> bounds(n + 1);
+    for (unsigned i = 0; i <= n; ++i) bounds[i] = segments * i / n;
+
+    std::vector<ReportStats> parts(n - 1);
+    for (auto& part : parts) part.metrics = stats.metrics.empty_like();
+    std::vector<uint8_t> intact(n, 0);
+    std::vector<std::thread> workers;
+    workers.reserve(n - 1);
+    for (unsigned i = 1; i < n; ++i) {
+        workers.emplace_back([&, i] {
+            intact[i] = scan_segments(reader, offsets, bounds[i], bounds[i + 1], parts[i - 1]);
+        });
+    }
+    intact[0] = scan_segments(reader, offsets, bounds[0], bounds[1], stats);
+    for (auto& w : workers) w.join();
+    bool torn = end != reader.size() || !intact[0];
+    for (unsigned i = 1; i < n && !torn; ++i) {
+        merge(stats, parts[i - 1]);
+        torn = !intact[i];
+    }
+    if (torn)
+        log(LogLevel::WARN, "events.irrc has a torn or corrupt tail; ignoring trailing bytes");
     return true;
 }
 
-bool parse_event_line(const std::string& line, ParsedEventLine& ev) {
-    if (!extract_string(line, "type", ev.type)) return false;
-    ev.has_ok = extract_bool(line, "ok", ev.ok);
-    ev.has_metric = extract_double(line, "metric_ms", ev.metric_ms);
-    // target nested object
-    std::string target_obj;
-    if (extract_object_substr(line, "target", target_obj)) {
-        extract_string(target_obj, "name", ev.target_name);
+// Read-only mapping of a whole regular file.
+struct MappedFile {
+    const char* data{nullptr};
+    size_t size{0};
+    struct stat st {};
+
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() {
+        if (data) ::munmap(const_cast<char*>(data), size);
     }
-    return ev.has_metric;
+
+    // -1 if the file cannot be opened, 0 if it is not a regular file or cannot be mapped (read
+    // it through a buffer instead), 1 once mapped (data stays null for an empty file).
+    int open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return -1;
+        if (::fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+            ::close(fd);
+            return 0;
+        }
+        size = static_cast<size_t>(st.st_size);
+        if (size == 0) {
+            ::close(fd);
+            return 1;
+        }
+        void* map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED) return 0;
+        ::madvise(map, size, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(map);
+        return 1;
+    }
+};
+
+// Aggregates the lines in data[begin, end), split into one chunk per thread.
+void aggregate_range(const char* data, size_t begin, size_t end, const ReportOptions& opts,
+                     ReportStats& stats) {
+    if (begin == end) return;
+    // Chunk i starts at the first line beginning at or after begin + size * i / n.
+    size_t size = end - begin;
+    unsigned n = pick_threads(opts, size);
+    std::vector<size_t> bounds(n + 1, end);
+    bounds[0] = begin;
+    for (unsigned i = 1; i < n; ++i) {
+        size_t at = std::max(bounds[i - 1], begin + size * i / n);
+        if (at > begin && at < end && data[at - 1] != '\n') {
+            const auto* nl = static_cast<const char*>(std::memchr(data + at, '\n', end - at));
+            at = nl ? static_cast<size_t>(nl - data) + 1 : end;
+        }
+        bounds[i] = at;
+    }
+
+    std::vector<ReportStats> parts(n - 1);
+    for (auto& part : parts) part.metrics = stats.metrics.empty_like();
+    std::vector<std::thread> workers;
+    workers.reserve(n - 1);
+    for (unsigned i = 1; i < n; ++i) {
+        workers.emplace_back([&, i] {
+            scan_range(data + bounds[i], data + bounds[i + 1], parts[i - 1]);
+        });
+    }
+    scan_range(data + bounds[0], data + bounds[1], stats);
+    for (auto& w : workers) w.join();
+    for (const auto& part : parts) merge(stats, part);
 }
 
-std::string build_svg_polyline(const std::vector<double>& vals, double width, double height) {
-    if (vals.empty()) return "";
-    double maxv = 1.0;
-    for (double v : vals) maxv = std::max(maxv, v);
-    std::ostringstream oss;
-    double step = width / (vals.size() - 1 + 1e-6);
-    for (size_t i = 0; i < vals.size(); ++i) {
-        double x = i * step;
-        double y = height - (vals[i] / maxv) * height;
-        oss << (i == 0 ? "" : " ") << x << "," << y;
-    }
-    return oss.str();
+// Resumes from the bundle's checkpoint when it still describes the start of events.jsonl,
+// aggregates the complete lines after it and saves the new state. A last line without its
+// '\n' (still being written) is counted in stats but left for the next run.
+bool aggregate_jsonl_incremental(const std::string& bundle_in, const ReportOptions& opts,
+                                 ReportStats& stats) {
+    std::string path = bundle_in + "/events.jsonl";
+    std::string ckpt_path = bundle_in + "/" + kCheckpointFile;
+    MappedFile file;
+    int rc = file.open(path);
+    if (rc < 0) return false;
+    if (rc == 0) return load_jsonl(path, stats);
+    if (file.size == 0) return true;
+
+    auto dev = static_cast<uint64_t>(file.st.st_dev);
+    auto ino = static_cast<uint64_t>(file.st.st_ino);
+    ReportCheckpoint ck;
+    bool resumed =
+        load_checkpoint(ckpt_path, opts, ck) && ck.matches(dev, ino, file.data, file.size);
+    if (!resumed) {
+        if (std::filesystem::exists(ckpt_path))
+            log(LogLevel::INFO, "report checkpoint does not match events.jsonl or these "
+                                "options; rescanning");
+        ck = ReportCheckpoint();
+        ck.stats.metrics = stats.metrics.empty_like();
+    }
+    size_t begin = resumed ? static_cast<size_t>(ck.offset) : 0;
+    const auto* nl = static_cast<const char*>(
+        begin < file.size ? ::memrchr(file.data + begin, '\n', file.size - begin) : nullptr);
+    size_t complete = nl ? static_cast<size_t>(nl - file.data) + 1 : begin;
+    aggregate_range(file.data, begin, complete, opts, ck.stats);
+    if (!resumed || complete != begin) {
+        ck.stamp(dev, ino, file.data, complete);
+        save_checkpoint(ckpt_path, ck, opts);
+    }
+    stats = std::move(ck.stats);
+    if (complete < file.size) scan_range(file.data + complete, file.data + file.size, stats);
+    return true;
 }
 }  // namespace
 
-bool generate_report(const std::string& bundle_in, const std::string& out_html,
-                     ReportStats& stats) {
-    std::ifstream in(bundle_in + "/events.jsonl");
-    if (!in.is_open()) {
-        log(LogLevel::ERROR, "Cannot open events.jsonl");
-        return false;
+bool aggregate_jsonl(const std::string& path, const ReportOptions& opts, ReportStats& stats) {
+    MappedFile file;
+    int rc = file.open(path);
+    if (rc < 0) return false;
+    if (rc == 0) return load_jsonl(path, stats);
+    aggregate_range(file.data, 0, file.size, opts, stats);
+    return true;
+}
+
+bool generate_report(const std::string& bundle_in, const std::string& out_html, ReportStats& stats,
+                     const ReportOptions& opts) {
+    stats.metrics = opts.exact ? QuantileSketch::exact() : QuantileSketch(opts.relative_error);
+    std::string columnar_path = bundle_in + "/events.irrc";
+    std::string jsonl_path = bundle_in + "/events.jsonl";
+    bool loaded = false;
+    // events.jsonl is always written and is never behind events.irrc, which seals a segment
+    // only every few thousand events or a minute. With a checkpoint only its new tail is
+    // parsed, which beats decoding the whole columnar store again.
+    if (opts.checkpoint && std::filesystem::exists(jsonl_path)) {
+        loaded = aggregate_jsonl_incremental(bundle_in, opts, stats);
+    } else if (std::filesystem::exists(columnar_path)) {
+        loaded = load_columnar(columnar_path, opts, stats);
+    } else {
+        loaded = aggregate_jsonl(jsonl_path, opts, stats);
     }
-    std::vector<double> metrics;
-    size_t failures = 0;
-    size_t total = 0;
-    std::string line;
-    while (std::getline(in, line)) {
-        ParsedEventLine parsed;
-        if (!parse_event_line(line, parsed)) continue;
-        if (parsed.type != "probe.tcp.connect" && parsed.type != "probe.dns.result" &&
-            parsed.type != "probe.dns.timeout" && parsed.type != "probe.icmp.rtt" &&
-            parsed.type != "probe.icmp.timeout")
-            continue;
-        ++total;
-        if (parsed.has_ok && parsed.ok) {
-            metrics.push_back(parsed.metric_ms);
-            stats.per_target[parsed.target_name].push_back(parsed.metric_ms);
-            if (parsed.type == "probe.tcp.connect") stats.timeline.push_back(parsed.metric_ms);
-        } else {
-            ++failures;
-            stats.per_target_fail[parsed.target_name] += 1;
-        }
+    if (!loaded) {
+        log(LogLevel::ERROR, "Cannot open events.irrc/events.jsonl in " + bundle_in);
+        return false;
     }
-    stats.total = total;
-    stats.failures = failures;
-    stats.loss_pct = total == 0 ? 0.0 : (failures * 100.0 / total);
-    stats.p50_ms = percentile(metrics, 50);
-    stats.p95_ms = percentile(metrics, 95);
-    stats.p99_ms = percentile(metrics, 99);
+    stats.loss_pct = stats.total == 0 ? 0.0 : (stats.failures * 100.0 / stats.total);
+    stats.p50_ms = stats.metrics.quantile(50);
+    stats.p95_ms = stats.metrics.quantile(95);
+    stats.p99_ms = stats.metrics.quantile(99);
 
     std::ofstream out(out_html);
     if (!out.is_open()) return false;
 
-    std::string poly = build_svg_polyline(stats.timeline, 600, 160);
-
     out << "<!doctype html><html><head><meta charset=\"utf-8\"><title>IRR Report</title>";
     out << "<meta name=\"viewport\" content=\"width=device-width, initial-scale=1\">";
     out << "<style>body{font-family:Arial;margin:24px;} "
@@ -199,21 +347,32 @@ bool generate_report(const std::string& bundle_in, const std::string& out_html,
     out << "<h2>Per-target "
            "breakdown</h2><table><tr><th>Target</th><th>p50</th><th>p95</th><th>p99</"
            "th><th>failures</th></tr>";
-    for (const auto& kv : stats.per_target) {
-        double p50 = percentile(kv.second, 50);
-        double p95 = percentile(kv.second, 95);
-        double p99 = percentile(kv.second, 99);
-        size_t fails = stats.per_target_fail[kv.first];
-        out << "<tr><td>" << html_escape(kv.first) << "</td><td>" << p50 << "</td><td>" << p95
+    // Sorted by name so the table does not depend on hash-map iteration order.
+    std::map<std::string, const QuantileSketch*> rows;
+    for (const auto& kv : stats.per_target) rows.emplace(kv.first, &kv.second);
+    for (const auto& [name, sketch] : rows) {
+        double p50 = sketch->quantile(50);
+        double p95 = sketch->quantile(95);
+        double p99 = sketch->quantile(99);
+        size_t fails = stats.per_target_fail[name];
+        out << "<tr><td>" << html_escape(name) << "</td><td>" << p50 << "</td><td>" << p95
             << "</td><td>" << p99 << "</td><td>" << fails << "</td></tr>";
     }
     out << "</table>";
 
     out << "<h2>Timeline (TCP connect)</h2>";
-    if (!poly.empty()) {
-        out << "<svg width='640' height='200'><polyline fill='none' stroke='#0a74da' "
-               "stroke-width='2' points='"
-            << poly << "' /></svg>";
+    if (!stats.timeline.empty()) {
+        std::string svg;
+        stats.timeline.render_svg(svg, 600, 160);
+        out << svg << "<p>";
+        stats.timeline.for_each_series([&out](const std::string& name, const char* color) {
+            out << "<span style='color:" << color << "'>&#9632; " << html_escape(name)
+                << "</span> ";
+        });
+        std::string span;
+        append_fixed(span, static_cast<double>(stats.timeline.bucket_ns()) / 1e9, 3);
+        out << "<br>Each point covers " << span
+            << " s: band = min..max, line = mean, ticks = failures.</p>";
     } else {
         out << "<p>No data</p>";
     }
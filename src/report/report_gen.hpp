@@ -3,16 +3,43 @@
 #include <unordered_map>
 #include <vector>
 
+#include "../util/quantile_sketch.hpp"
+#include "timeline.hpp"
+
 namespace irr {
 struct ReportStats {
     double p50_ms{0}, p95_ms{0}, p99_ms{0};
     double loss_pct{0};
     size_t total{0};
     size_t failures{0};
-    std::unordered_map<std::string, std::vector<double>> per_target;
+    QuantileSketch metrics;  // every successful sample
+    std::unordered_map<std::string, QuantileSketch> per_target;
     std::unordered_map<std::string, size_t> per_target_fail;
-    std::vector<double> timeline;
+    Timeline timeline;  // TCP connect latency per target
+};
+
+struct ReportOptions {
+    // Threads scanning events.jsonl (or the segments of events.irrc). 0 picks one per core,
+    // capped so that every thread gets at least kMinChunkBytes; 1 is the serial path.
+    unsigned threads{0};
+    static constexpr size_t kMinChunkBytes = 8 << 20;
+    // Latency quantiles come from sketches with this relative error; exact keeps every sample
+    // (memory grows with the bundle, fine for small ones).
+    double relative_error{QuantileSketch::kDefaultRelativeError};
+    bool exact{false};
+    // Resume from and update <bundle>/report.ckpt so only the appended tail of events.jsonl
+    // is parsed.
+    bool checkpoint{true};
 };
 
-bool generate_report(const std::string& bundle_in, const std::string& out_html, ReportStats& stats);
+constexpr const char* kCheckpointFile = "report.ckpt";
+
+bool generate_report(const std::string& bundle_in, const std::string& out_html, ReportStats& stats,
+                     const ReportOptions& opts = {});
+
+// Aggregates events.jsonl into stats, whose sketches keep the mode and error stats.metrics
+// was set up with. The file is mapped and split at newline boundaries into one chunk per
+// thread; each thread fills its own partial stats and the partials are merged in file order,
+// so the result matches a serial pass exactly.
+bool aggregate_jsonl(const std::string& path, const ReportOptions& opts, ReportStats& stats);
 }  // namespace irr
@@ -0,0 +1,244 @@
+#include "timeline.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "../util/format.hpp"
+
+namespace irr {
+namespace {
+const char* const kColors[] = {"#0a74da", "#e8710a", "#1e8e3e", "#9334e6",
+                               "#d01884", "#12b5cb", "#795548", "#5f6368"};
+
+void combine(Timeline::Bucket& dst, const Timeline::Bucket& src) {
+    if (src.ok) {
+        dst.min = dst.ok ? std::min(dst.min, src.min) : src.min;
+        dst.max = dst.ok ? std::max(dst.max, src.max) : src.max;
+    }
+    dst.ok += src.ok;
+    dst.failures += src.failures;
+    dst.sum_us += src.sum_us;
+}
+
+bool has_data(const Timeline::Bucket& b) {
+    return b.ok || b.failures;
+}
+
+// Bucket spans are kMinBucketNs times a power of two; returns log2(to / from).
+unsigned shift_between(uint64_t from, uint64_t to) {
+    unsigned s = 0;
+    while ((from << s) < to) ++s;
+    return s;
+}
+
+void append_point(std::string& out, char cmd, double x, double y) {
+    out.push_back(cmd);
+    append_fixed(out, x, 1);
+    out.push_back(',');
+    append_fixed(out, y, 1);
+}
+}  // namespace
+
+const char* Timeline::series_color(size_t i) {
+    return kColors[i % (sizeof(kColors) / sizeof(kColors[0]))];
+}
+
+const std::vector<Timeline::Bucket>* Timeline::series(std::string_view name) const {
+    auto it = series_.find(name);
+    return it == series_.end() ? nullptr : &it->second;
+}
+
+void Timeline::fit(uint64_t span, uint64_t lo, uint64_t hi) {
+    uint64_t target = std::max(span, span_);
+    unsigned s = shift_between(span, target);
+    unsigned own = shift_between(span_, target);
+    uint64_t nlo = lo >> s;
+    uint64_t nhi = hi >> s;
+    if (!series_.empty()) {
+        nlo = std::min(nlo, lo_ >> own);
+        nhi = std::max(nhi, hi_ >> own);
+    }
+    while (nhi - nlo >= width_) {
+        target <<= 1;
+        ++own;
+        nlo >>= 1;
+        nhi >>= 1;
+    }
+    if (!series_.empty() && (own || nlo != lo_)) {
+        for (auto& kv : series_) {
+            std::vector<Bucket> moved(width_);
+            for (size_t j = 0; j < width_; ++j) {
+                if (has_data(kv.second[j])) combine(moved[((lo_ + j) >> own) - nlo], kv.second[j]);
+            }
+            kv.second.swap(moved);
+        }
+    }
+    span_ = target;
+    lo_ = nlo;
+    hi_ = nhi;
+}
+
+void Timeline::add(std::string_view name, uint64_t ts_ns, bool ok, double metric_ms) {
+    uint64_t idx = ts_ns / span_;
+    if (series_.empty() || idx < lo_ || idx > hi_) fit(span_, idx, idx);
+    auto it = series_.find(name);
+    if (it == series_.end())
+        it = series_.emplace(std::string(name), std::vector<Bucket>(width_)).first;
+    Bucket one;
+    if (ok) {
+        one.ok = 1;
+        one.min = one.max = metric_ms;
+        one.sum_us = static_cast<uint64_t>(std::llround(std::max(metric_ms, 0.0) * 1000));
+    } else {
+        one.failures = 1;
+    }
+    combine(it->second[ts_ns / span_ - lo_], one);
+}
+
+void Timeline::merge(const Timeline& o) {
+    if (o.series_.empty()) return;
+    fit(o.span_, o.lo_, o.hi_);
+    unsigned s = shift_between(o.span_, span_);
+    for (const auto& kv : o.series_) {
+        auto it = series_.find(kv.first);
+        if (it == series_.end()) it = series_.emplace(kv.first, std::vector<Bucket>(width_)).first;
+        for (size_t j = 0; j < kv.second.size(); ++j) {
+            if (has_data(kv.second[j]))
+                combine(it->second[((o.lo_ + j) >> s) - lo_], kv.second[j]);
+        }
+    }
+}
+
+void Timeline::save(std::string& out) const {
+    put_raw(out, static_cast<uint64_t>(width_));
+    put_raw(out, span_);
+    put_raw(out, lo_);
+    put_raw(out, hi_);
+    put_raw(out, static_cast<uint32_t>(series_.size()));
+    for (const auto& kv : series_) {
+        put_string(out, kv.first);
+        uint32_t used = 0;
+        for (const auto& b : kv.second) used += has_data(b);
+        put_raw(out, used);
+        for (size_t j = 0; j < kv.second.size(); ++j) {
+            const Bucket& b = kv.second[j];
+            if (!has_data(b)) continue;
+            put_raw(out, static_cast<uint32_t>(j));
+            put_raw(out, b.ok);
+            put_raw(out, b.failures);
+            put_raw(out, b.min);
+            put_raw(out, b.max);
+            put_raw(out, b.sum_us);
+        }
+    }
+}
+
+bool Timeline::load(ByteReader& in) {
+    *this = Timeline(width_);
+    auto width = in.raw<uint64_t>();
+    span_ = in.raw<uint64_t>();
+    lo_ = in.raw<uint64_t>();
+    hi_ = in.raw<uint64_t>();
+    auto count = in.raw<uint32_t>();
+    bool valid = in.ok && width == width_ && span_ >= kMinBucketNs &&
+                 span_ <= kMinBucketNs << 40 &&
+                 span_ == kMinBucketNs << shift_between(kMinBucketNs, span_) && hi_ >= lo_ &&
+                 hi_ - lo_ < width_;
+    for (uint32_t i = 0; valid && i < count; ++i) {
+        auto& buckets = series_[std::string(in.string())];
+        buckets.resize(width_);
+        auto used = in.raw<uint32_t>();
+        for (uint32_t k = 0; in.ok && k < used; ++k) {
+            auto j = in.raw<uint32_t>();
+            Bucket b;
+            b.ok = in.raw<uint32_t>();
+            b.failures = in.raw<uint32_t>();
+            b.min = in.raw<double>();
+            b.max = in.raw<double>();
+            b.sum_us = in.raw<uint64_t>();
+            if (j >= width_ || !has_data(b)) {
+                valid = false;
+                break;
+            }
+            buckets[j] = b;
+        }
+        valid = valid && in.ok;
+    }
+    if (valid) return true;
+    in.ok = false;
+    *this = Timeline(width_);
+    return false;
+}
+
+void Timeline::render_svg(std::string& out, int width, int height) const {
+    double ymax = 1.0;
+    for (const auto& kv : series_)
+        for (const auto& b : kv.second)
+            if (b.ok) ymax = std::max(ymax, b.max);
+    size_t n = static_cast<size_t>(hi_ - lo_) + 1;
+    auto x = [&](size_t j) {
+        return n > 1 ? static_cast<double>(j) * width / static_cast<double>(n - 1) : width / 2.0;
+    };
+    auto y = [&](double v) { return height - v / ymax * height; };
+
+    out += "<svg width='";
+    append_uint(out, static_cast<uint64_t>(width + 40));
+    out += "' height='";
+    append_uint(out, static_cast<uint64_t>(height + 40));
+    out += "'>";
+    std::string band, mean, fails;
+    size_t color = 0;
+    for (const auto& kv : series_) {
+        const auto& buckets = kv.second;
+        band.clear();
+        mean.clear();
+        fails.clear();
+        for (size_t j = 0; j < n; ++j) {
+            if (buckets[j].failures) {
+                append_point(fails, 'M', x(j), 0);
+                fails += "v8";
+            }
+            if (!buckets[j].ok) continue;
+            // A run of consecutive buckets with samples: band outline there and back.
+            size_t end = j;
+            while (end + 1 < n && buckets[end + 1].ok) ++end;
+            for (size_t k = j; k <= end; ++k) {
+                const auto& b = buckets[k];
+                append_point(band, k == j ? 'M' : 'L', x(k), y(b.max));
+                append_point(mean, k == j ? 'M' : 'L', x(k), y(b.sum_us / 1000.0 / b.ok));
+            }
+            for (size_t k = end + 1; k-- > j;) append_point(band, 'L', x(k), y(buckets[k].min));
+            band += 'Z';
+            for (size_t k = j + 1; k <= end; ++k) {
+                if (buckets[k].failures) {
+                    append_point(fails, 'M', x(k), 0);
+                    fails += "v8";
+                }
+            }
+            j = end;
+        }
+        const char* c = series_color(color++);
+        if (!band.empty()) {
+            out += "<path fill='";
+            out += c;
+            out += "' fill-opacity='0.2' stroke='";
+            out += c;
+            out += "' stroke-opacity='0.4' d='";
+            out += band;
+            out += "'/><path fill='none' stroke='";
+            out += c;
+            out += "' stroke-width='1.5' stroke-linecap='round' d='";
+            out += mean;
+            out += "'/>";
+        }
+        if (!fails.empty()) {
+            out += "<path stroke='";
+            out += c;
+            out += "' stroke-width='2' d='";
+            out += fails;
+            out += "'/>";
+        }
+    }
+    out += "</svg>";
+}
+}  // namespace irr
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../util/byte_io.hpp"
+
+namespace irr {
+// Streaming, downsampled latency timeline for the report chart. Samples land in at most
+// `width` time buckets per series (one per pixel), each keeping min, max, mean and the
+// failure count, so a spike survives as the bucket's max however many samples share its
+// pixel. Buckets are aligned to multiples of their span (1 ms doubled as often as needed to
+// fit the time range into `width` buckets), which makes the result independent of the order
+// the samples arrive in and lets per-thread timelines merge into exactly the serial one.
+// Memory is O(width) per series.
+class Timeline {
+   public:
+    static constexpr size_t kDefaultWidth = 600;
+    static constexpr uint64_t kMinBucketNs = 1000000;
+
+    struct Bucket {
+        uint32_t ok{0};
+        uint32_t failures{0};
+        double min{0};
+        double max{0};
+        uint64_t sum_us{0};  // integral so merged sums do not depend on order
+        bool operator==(const Bucket& o) const {
+            return ok == o.ok && failures == o.failures && min == o.min && max == o.max &&
+                   sum_us == o.sum_us;
+        }
+    };
+
+    explicit Timeline(size_t width = kDefaultWidth) : width_(width ? width : 1) {}
+
+    void add(std::string_view series, uint64_t ts_ns, bool ok, double metric_ms);
+    void merge(const Timeline& o);
+
+    bool empty() const {
+        return series_.empty();
+    }
+    size_t width() const {
+        return width_;
+    }
+    uint64_t bucket_ns() const {
+        return span_;
+    }
+    // Buckets from the earliest sample on; nullptr for an unknown series.
+    const std::vector<Bucket>* series(std::string_view name) const;
+    size_t series_count() const {
+        return series_.size();
+    }
+
+    // Appends an <svg> plotting into width x height: per series a translucent min..max band,
+    // a mean line and a tick at the top for every bucket with failures. Series are drawn in
+    // name order with series_color(i).
+    void render_svg(std::string& out, int width, int height) const;
+    static const char* series_color(size_t i);
+    // f(name, color) for every series, in render order.
+    template <typename F>
+    void for_each_series(F f) const {
+        size_t i = 0;
+        for (const auto& kv : series_) f(kv.first, series_color(i++));
+    }
+
+    // Binary state for checkpoints (non-empty buckets only). load() rejects input that does
+    // not fit this timeline's width and leaves it empty.
+    void save(std::string& out) const;
+    bool load(ByteReader& in);
+
+    bool operator==(const Timeline& o) const {
+        return width_ == o.width_ && span_ == o.span_ && lo_ == o.lo_ && hi_ == o.hi_ &&
+               series_ == o.series_;
+    }
+    bool operator!=(const Timeline& o) const {
+        return !(*this == o);
+    }
+
+   private:
+    size_t width_;
+    uint64_t span_{kMinBucketNs};
+    uint64_t lo_{0};  // bucket index (ts / span_) of slot 0, the earliest sample
+    uint64_t hi_{0};  // bucket index of the latest sample
+    std::map<std::string, std::vector<Bucket>, std::less<>> series_;
+
+    // Makes [lo, hi] (bucket indexes at span) fit, coarsening by powers of two as needed.
+    void fit(uint64_t span, uint64_t lo, uint64_t hi);
+};
+}  // namespace irr
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "byte_io writes host-order values");
+
+namespace irr {
+// Fixed-width binary encoding for small on-disk state such as report checkpoints. Values are
+// copied as-is (little-endian, like events.irrc); the reader is bounds-checked and sticky:
+// after the first short read ok is false and every later read returns zero.
+template <typename T>
+inline void put_raw(std::string& out, const T& v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+inline void put_string(std::string& out, std::string_view s) {
+    put_raw(out, static_cast<uint32_t>(s.size()));
+    out.append(s.data(), s.size());
+}
+
+struct ByteReader {
+    const char* p;
+    const char* end;
+    bool ok{true};
+
+    explicit ByteReader(std::string_view in) : p(in.data()), end(in.data() + in.size()) {}
+
+    template <typename T>
+    T raw() {
+        T v{};
+        if (!ok || static_cast<size_t>(end - p) < sizeof(T)) {
+            ok = false;
+            return v;
+        }
+        std::memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+        return v;
+    }
+
+    std::string_view string() {
+        auto n = raw<uint32_t>();
+        if (!ok || static_cast<size_t>(end - p) < n) {
+            ok = false;
+            return {};
+        }
+        std::string_view s(p, n);
+        p += n;
+        return s;
+    }
+};
+}  // namespace irr
@@ -0,0 +1,90 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace irr {
+// Allocation-free (amortised) text formatting into a reusable std::string buffer. Used by the
+// JSONL writer instead of iostreams.
+
+inline void append_uint(std::string& out, uint64_t v) {
+    char tmp[20];
+    int n = 0;
+    do {
+        tmp[n++] = static_cast<char>('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    while (n > 0) out.push_back(tmp[--n]);
+}
+
+inline void append_int(std::string& out, int64_t v) {
+    if (v < 0) {
+        out.push_back('-');
+        append_uint(out, static_cast<uint64_t>(0) - static_cast<uint64_t>(v));
+    } else {
+        append_uint(out, static_cast<uint64_t>(v));
+    }
+}
+
+// Fixed-point with up to `decimals` fractional digits (trailing zeros trimmed), so the output
+// only ever contains digits, '-' and '.'. Non-finite values are written as 0.
+inline void append_fixed(std::string& out, double v, int decimals = 3) {
+    if (!std::isfinite(v)) {
+        out.push_back('0');
+        return;
+    }
+    uint64_t scale = 1;
+    for (int i = 0; i < decimals; ++i) scale *= 10;
+    bool neg = v < 0;
+    double mag = std::fabs(v);
+    if (mag >= 1e15) mag = 1e15;  // keeps the scaled value inside uint64_t
+    auto scaled = static_cast<uint64_t>(std::llround(mag * static_cast<double>(scale)));
+    uint64_t whole = scaled / scale;
+    uint64_t frac = scaled % scale;
+    if (neg && scaled != 0) out.push_back('-');
+    append_uint(out, whole);
+    if (frac == 0) return;
+    char digits[20];
+    for (int i = decimals - 1; i >= 0; --i) {
+        digits[i] = static_cast<char>('0' + frac % 10);
+        frac /= 10;
+    }
+    int len = decimals;
+    while (len > 0 && digits[len - 1] == '0') --len;
+    out.push_back('.');
+    out.append(digits, static_cast<size_t>(len));
+}
+
+inline void append_json_escaped(std::string& out, std::string_view s) {
+    static const char* hex = "0123456789abcdef";
+    for (char c : s) {
+        switch (c) {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\r':
+                out += "\\r";
+                break;
+            case '\t':
+                out += "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    out += "\\u00";
+                    out.push_back(hex[(c >> 4) & 0xF]);
+                    out.push_back(hex[c & 0xF]);
+                } else {
+                    out.push_back(c);
+                }
+                break;
+        }
+    }
+}
+}  // namespace irr
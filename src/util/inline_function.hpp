@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace irr {
+template <typename Sig, size_t Capacity = 32>
+class InlineFunction;
+
+// Move-only std::function replacement that stores the callable in an inline buffer and never
+// allocates. Callables larger than Capacity fail to compile rather than falling back to the
+// heap, which keeps registration on hot paths (one per probe socket) allocation-free.
+template <typename R, typename... Args, size_t Capacity>
+class InlineFunction<R(Args...), Capacity> {
+   public:
+    InlineFunction() = default;
+    InlineFunction(std::nullptr_t) {}
+
+    template <typename F, typename D = std::decay_t<F>,
+              typename = std::enable_if_t<!std::is_same<D, InlineFunction>::value>>
+    InlineFunction(F&& f) {
+        static_assert(sizeof(D) <= Capacity, "callable too large for InlineFunction");
+        static_assert(alignof(D) <= alignof(std::max_align_t), "over-aligned callable");
+        static_assert(std::is_nothrow_move_constructible<D>::value, "callable must move");
+        ::new (static_cast<void*>(buf_)) D(std::forward<F>(f));
+        ops_ = &kOps<D>;
+    }
+
+    InlineFunction(InlineFunction&& o) noexcept {
+        move_from(o);
+    }
+    InlineFunction& operator=(InlineFunction&& o) noexcept {
+        if (this != &o) {
+            reset();
+            move_from(o);
+        }
+        return *this;
+    }
+    InlineFunction(const InlineFunction&) = delete;
+    InlineFunction& operator=(const InlineFunction&) = delete;
+    ~InlineFunction() {
+        reset();
+    }
+
+    R operator()(Args... args) {
+        return ops_->invoke(buf_, std::forward<Args>(args)...);
+    }
+    explicit operator bool() const {
+        return ops_ != nullptr;
+    }
+    void reset() {
+        if (ops_) ops_->destroy(buf_);
+        ops_ = nullptr;
+    }
+
+   private:
+    struct Ops {
+        R (*invoke)(void*, Args&&...);
+        void (*move)(void* dst, void* src);
+        void (*destroy)(void*);
+    };
+    template <typename D>
+    static constexpr Ops kOps = {
+        [](void* p, Args&&... args) -> R {
+            return (*static_cast<D*>(p))(std::forward<Args>(args)...);
+        },
+        [](void* dst, void* src) {
+            ::new (dst) D(std::move(*static_cast<D*>(src)));
+            static_cast<D*>(src)->~D();
+        },
+        [](void* p) { static_cast<D*>(p)->~D(); },
+    };
+
+    void move_from(InlineFunction& o) {
+        if (o.ops_) {
+            o.ops_->move(buf_, o.buf_);
+            ops_ = o.ops_;
+            o.ops_ = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char buf_[Capacity];
+    const Ops* ops_{nullptr};
+};
+}  // namespace irr
@@ -0,0 +1,259 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "byte_io.hpp"
+#include "percentile.hpp"
+
+namespace irr {
+// Mergeable quantile sketch with a relative-error bound (DDSketch). A sample x is counted in
+// bucket ceil(log_gamma(x)), gamma = (1 + a) / (1 - a), and a rank is answered with its
+// bucket's midpoint, which is within a factor (1 +- a) of the true sample at that rank. Memory
+// follows the range of the values, not their number: 1 us to 1000 s at a = 1% is about 1000
+// buckets. Past kMaxBuckets the lowest buckets are folded together, so only the fastest
+// samples lose precision. Estimates are clamped to the exact min and max. Merging sketches
+// with the same error adds bucket counts, so the result is independent of merge order.
+//
+// Exact mode keeps every sample instead and answers like percentile(). quantile() sorts those
+// samples lazily, so concurrent readers need external locking.
+class QuantileSketch {
+   public:
+    static constexpr double kDefaultRelativeError = 0.01;
+    static constexpr size_t kMaxBuckets = 4096;
+    // Samples at or below this count in a zero bucket (log() needs a positive value).
+    static constexpr double kMinValue = 1e-9;
+
+    explicit QuantileSketch(double relative_error = kDefaultRelativeError) {
+        set_error(relative_error);
+    }
+    static QuantileSketch exact() {
+        QuantileSketch s;
+        s.exact_ = true;
+        return s;
+    }
+    // An empty sketch in the same mode and with the same error.
+    QuantileSketch empty_like() const {
+        QuantileSketch s(alpha_);
+        s.exact_ = exact_;
+        return s;
+    }
+
+    void add(double v, uint64_t n = 1) {
+        if (n == 0 || std::isnan(v)) return;
+        count_ += n;
+        min_ = std::min(min_, v);
+        max_ = std::max(max_, v);
+        if (exact_) {
+            samples_.insert(samples_.end(), n, v);
+            sorted_ = false;
+        } else if (v <= kMinValue) {
+            zero_ += n;
+        } else {
+            bucket(index(v)) += n;
+        }
+    }
+
+    void merge(const QuantileSketch& o) {
+        if (o.count_ == 0) return;
+        if (exact_ && o.exact_) {
+            count_ += o.count_;
+            min_ = std::min(min_, o.min_);
+            max_ = std::max(max_, o.max_);
+            samples_.insert(samples_.end(), o.samples_.begin(), o.samples_.end());
+            sorted_ = false;
+            return;
+        }
+        if (exact_) to_sketch(o.alpha_);
+        if (o.exact_) {
+            for (double v : o.samples_) add(v);
+            return;
+        }
+        count_ += o.count_;
+        min_ = std::min(min_, o.min_);
+        max_ = std::max(max_, o.max_);
+        zero_ += o.zero_;
+        bool same = o.alpha_ == alpha_;
+        for (size_t j = 0; j < o.bins_.size(); ++j) {
+            if (!o.bins_[j]) continue;
+            int32_t i = o.offset_ + static_cast<int32_t>(j);
+            bucket(same ? i : index(o.bucket_value(i))) += o.bins_[j];
+        }
+    }
+
+    // p in [0, 100]; ranks are interpolated the same way as percentile().
+    double quantile(double p) const {
+        if (count_ == 0) return 0.0;
+        if (exact_) {
+            sort_samples();
+            return percentile_sorted(samples_, p);
+        }
+        double rank = (p / 100.0) * static_cast<double>(count_ - 1);
+        uint64_t lo = static_cast<uint64_t>(rank);
+        uint64_t hi = std::min(lo + 1, count_ - 1);
+        double vlo = value_at(lo);
+        double vhi = hi == lo ? vlo : value_at(hi);
+        return vlo + (vhi - vlo) * (rank - static_cast<double>(lo));
+    }
+
+    size_t size() const {
+        return static_cast<size_t>(count_);
+    }
+    bool empty() const {
+        return count_ == 0;
+    }
+    double min() const {
+        return count_ ? min_ : 0.0;
+    }
+    double max() const {
+        return count_ ? max_ : 0.0;
+    }
+    bool is_exact() const {
+        return exact_;
+    }
+    double relative_error() const {
+        return alpha_;
+    }
+    size_t bucket_count() const {
+        return bins_.size();
+    }
+
+    // Binary state for checkpoints. load() rejects inconsistent input and leaves *this empty.
+    void save(std::string& out) const {
+        put_raw(out, static_cast<uint8_t>(exact_));
+        put_raw(out, alpha_);
+        put_raw(out, count_);
+        put_raw(out, zero_);
+        put_raw(out, min_);
+        put_raw(out, max_);
+        put_raw(out, offset_);
+        put_raw(out, static_cast<uint32_t>(bins_.size()));
+        for (uint64_t b : bins_) put_raw(out, b);
+        put_raw(out, static_cast<uint64_t>(samples_.size()));
+        for (double v : samples_) put_raw(out, v);
+    }
+    bool load(ByteReader& in) {
+        bool exact = in.raw<uint8_t>() != 0;
+        *this = QuantileSketch(in.raw<double>());
+        exact_ = exact;
+        count_ = in.raw<uint64_t>();
+        zero_ = in.raw<uint64_t>();
+        min_ = in.raw<double>();
+        max_ = in.raw<double>();
+        offset_ = in.raw<int32_t>();
+        auto nbins = in.raw<uint32_t>();
+        if (!in.ok || nbins > kMaxBuckets) return fail(in);
+        uint64_t seen = zero_;
+        bins_.resize(nbins);
+        for (auto& b : bins_) {
+            b = in.raw<uint64_t>();
+            seen += b;
+        }
+        auto nsamples = in.raw<uint64_t>();
+        if (!in.ok || nsamples > static_cast<uint64_t>(in.end - in.p) / sizeof(double))
+            return fail(in);
+        samples_.resize(nsamples);
+        for (auto& v : samples_) v = in.raw<double>();
+        sorted_ = false;
+        if (!in.ok || (exact_ ? nsamples : seen) != count_) return fail(in);
+        return true;
+    }
+
+    bool operator==(const QuantileSketch& o) const {
+        if (exact_ != o.exact_ || alpha_ != o.alpha_ || count_ != o.count_) return false;
+        if (count_ == 0) return true;
+        if (min_ != o.min_ || max_ != o.max_) return false;
+        if (exact_) {
+            sort_samples();
+            o.sort_samples();
+            return samples_ == o.samples_;
+        }
+        return zero_ == o.zero_ && offset_ == o.offset_ && bins_ == o.bins_;
+    }
+    bool operator!=(const QuantileSketch& o) const {
+        return !(*this == o);
+    }
+
+   private:
+    double alpha_{0};
+    double gamma_{0};
+    double log_gamma_{0};
+    bool exact_{false};
+    uint64_t count_{0};
+    uint64_t zero_{0};
+    double min_{std::numeric_limits<double>::infinity()};
+    double max_{-std::numeric_limits<double>::infinity()};
+    int32_t offset_{0};  // bucket index of bins_[0]
+    std::vector<uint64_t> bins_;
+    mutable std::vector<double> samples_;  // exact mode only
+    mutable bool sorted_{true};
+
+    void set_error(double a) {
+        alpha_ = std::clamp(a, 1e-4, 0.5);
+        gamma_ = (1 + alpha_) / (1 - alpha_);
+        log_gamma_ = std::log(gamma_);
+    }
+
+    int32_t index(double v) const {
+        return static_cast<int32_t>(std::ceil(std::log(v) / log_gamma_));
+    }
+    double bucket_value(int32_t i) const {
+        return 2 * std::pow(gamma_, i) / (gamma_ + 1);
+    }
+
+    uint64_t& bucket(int32_t i) {
+        if (bins_.empty()) {
+            offset_ = i;
+            bins_.assign(1, 0);
+        } else if (i < offset_) {
+            bins_.insert(bins_.begin(), static_cast<size_t>(offset_ - i), 0);
+            offset_ = i;
+        } else if (i - offset_ >= static_cast<int32_t>(bins_.size())) {
+            bins_.resize(static_cast<size_t>(i - offset_) + 1, 0);
+        }
+        if (bins_.size() > kMaxBuckets) {
+            // Fold an eighth at a time so a steadily widening range does not shift every add.
+            size_t excess = bins_.size() - kMaxBuckets + kMaxBuckets / 8;
+            for (size_t j = 0; j < excess; ++j) bins_[excess] += bins_[j];
+            bins_.erase(bins_.begin(), bins_.begin() + static_cast<std::ptrdiff_t>(excess));
+            offset_ += static_cast<int32_t>(excess);
+        }
+        return bins_[static_cast<size_t>(std::max(i - offset_, 0))];
+    }
+
+    // The k-th smallest sample (0-based), as its bucket's midpoint.
+    double value_at(uint64_t k) const {
+        if (k == 0) return min_;
+        if (k + 1 == count_) return max_;
+        uint64_t seen = zero_;
+        if (k < seen) return std::clamp(0.0, min_, max_);
+        for (size_t j = 0; j < bins_.size(); ++j) {
+            seen += bins_[j];
+            if (k < seen)
+                return std::clamp(bucket_value(offset_ + static_cast<int32_t>(j)), min_, max_);
+        }
+        return max_;
+    }
+
+    void sort_samples() const {
+        if (sorted_) return;
+        std::sort(samples_.begin(), samples_.end());
+        sorted_ = true;
+    }
+
+    bool fail(ByteReader& in) {
+        in.ok = false;
+        *this = QuantileSketch(alpha_);
+        return false;
+    }
+
+    void to_sketch(double a) {
+        std::vector<double> samples;
+        samples.swap(samples_);
+        *this = QuantileSketch(a);
+        for (double v : samples) add(v);
+    }
+};
+}  // namespace irr
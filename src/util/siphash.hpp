@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace irr {
+// SipHash-2-4 (Aumasson & Bernstein): a keyed 64-bit MAC that is cheap on short inputs. Used to
+// authenticate state we hand to the network and read back, such as stateless echo payloads.
+struct SipKey {
+    uint64_t k0;
+    uint64_t k1;
+};
+
+namespace detail {
+inline uint64_t rotl(uint64_t x, int b) {
+    return (x << b) | (x >> (64 - b));
+}
+
+inline void sip_round(uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3) {
+    v0 += v1;
+    v1 = rotl(v1, 13);
+    v1 ^= v0;
+    v0 = rotl(v0, 32);
+    v2 += v3;
+    v3 = rotl(v3, 16);
+    v3 ^= v2;
+    v0 += v3;
+    v3 = rotl(v3, 21);
+    v3 ^= v0;
+    v2 += v1;
+    v1 = rotl(v1, 17);
+    v1 ^= v2;
+    v2 = rotl(v2, 32);
+}
+}  // namespace detail
+
+// Message words are read little-endian, as in the reference implementation.
+inline uint64_t siphash24(const SipKey& key, const void* data, size_t len) {
+    uint64_t v0 = 0x736f6d6570736575ULL ^ key.k0;
+    uint64_t v1 = 0x646f72616e646f6dULL ^ key.k1;
+    uint64_t v2 = 0x6c7967656e657261ULL ^ key.k0;
+    uint64_t v3 = 0x7465646279746573ULL ^ key.k1;
+    const auto* p = static_cast<const uint8_t*>(data);
+    auto load = [](const uint8_t* b, size_t n) {
+        uint64_t w = 0;
+        for (size_t i = 0; i < n; ++i) w |= static_cast<uint64_t>(b[i]) << (8 * i);
+        return w;
+    };
+    size_t full = len & ~size_t{7};
+    for (size_t i = 0; i < full; i += 8) {
+        uint64_t m = load(p + i, 8);
+        v3 ^= m;
+        detail::sip_round(v0, v1, v2, v3);
+        detail::sip_round(v0, v1, v2, v3);
+        v0 ^= m;
+    }
+    uint64_t last = (static_cast<uint64_t>(len) << 56) | load(p + full, len - full);
+    v3 ^= last;
+    detail::sip_round(v0, v1, v2, v3);
+    detail::sip_round(v0, v1, v2, v3);
+    v0 ^= last;
+    v2 ^= 0xff;
+    for (int i = 0; i < 4; ++i) detail::sip_round(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+}  // namespace irr
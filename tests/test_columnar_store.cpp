@@ -0,0 +1,119 @@
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "../src/core/store_columnar.hpp"
+#include "../src/report/report_gen.hpp"
+
+namespace {
+std::string read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+// Segments split across threads give the serial report, including when a segment in the
+// middle is corrupt and everything from it on must be ignored.
+int parallel_matches_serial() {
+    std::string dir = "/tmp/irr_columnar_parallel_test";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    std::string path = dir + "/events.irrc";
+    auto& syms = irr::symbols();
+    {
+        irr::ColumnarStore store(path, 16);
+        for (int i = 0; i < 1000; ++i) {
+            irr::Event ev;
+            ev.ts_monotonic_ns = 1000000000ULL * i;
+            ev.type = i % 3 ? irr::EventType::TcpConnect : irr::EventType::DnsResult;
+            ev.target_name = syms.intern("t" + std::to_string(i % 7));
+            ev.ok = i % 11 != 0;
+            ev.metric_ms = (i * 37) % 1009 * 0.25;
+            store.on_event(ev);
+        }
+    }
+    for (bool corrupt : {false, true}) {
+        if (corrupt) {
+            irr::ColumnarReader reader;
+            std::vector<size_t> offsets;
+            if (!reader.open(path)) return 20;
+            reader.segment_offsets(offsets);
+            if (offsets.size() != 63) return 21;
+            std::fstream f(path, std::ios::binary | std::ios::in | std::ios::out);
+            f.seekp(static_cast<std::streamoff>(offsets[41] - 1));  // footer magic of 40
+            f.put('X');
+        }
+        irr::ReportOptions opts;
+        opts.checkpoint = false;
+        opts.threads = 1;
+        irr::ReportStats serial;
+        if (!irr::generate_report(dir, dir + "/serial.html", serial, opts)) return 22;
+        if (serial.total != (corrupt ? 40u * 16 : 1000u)) return 23;
+        for (unsigned threads : {2u, 3u, 7u, 64u}) {
+            opts.threads = threads;
+            irr::ReportStats stats;
+            if (!irr::generate_report(dir, dir + "/parallel.html", stats, opts)) return 24;
+            if (stats.total != serial.total || stats.metrics != serial.metrics ||
+                stats.per_target != serial.per_target || stats.timeline != serial.timeline)
+                return 25;
+            if (read_file(dir + "/parallel.html") != read_file(dir + "/serial.html")) return 26;
+        }
+    }
+    return 0;
+}
+}  // namespace
+
+int main() {
+    if (int rc = parallel_matches_serial()) return rc;
+    std::string dir = "/tmp/irr_columnar_test";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    std::string path = dir + "/events.irrc";
+    auto& syms = irr::symbols();
+    {
+        irr::ColumnarStore store(path, 3);
+        for (int i = 0; i < 7; ++i) {
+            irr::Event ev;
+            ev.run_id = syms.intern("run");
+            ev.ts_monotonic_ns = 1000000000ULL * (i + 1);
+            ev.ts_wall_ns = 1700000000000000000ULL + 1000000000ULL * i;
+            ev.type = i == 6 ? irr::EventType::DnsTimeout : irr::EventType::TcpConnect;
+            ev.target_name = syms.intern(i % 2 ? "a" : "b");
+            ev.target_ip = syms.intern("10.0.0.1");
+            ev.target_family = syms.intern("inet");
+            ev.interval_ms = 1000;
+            ev.timeout_ms = 2000;
+            ev.ok = i != 6;
+            ev.metric_ms = 10.5 + i;
+            ev.error = ev.ok ? irr::ErrorCode::None : irr::ErrorCode::Timeout;
+            store.on_event(ev);
+        }
+    }
+    // A torn trailing write must not hide the complete segments before it.
+    {
+        std::ofstream tail(path, std::ios::app | std::ios::binary);
+        tail << "IRRS-torn";
+    }
+    irr::ColumnarReader reader;
+    if (!reader.open(path)) return 1;
+    std::vector<irr::ColumnarRecord> batch;
+    std::vector<irr::ColumnarRecord> all;
+    size_t offset = 0;
+    int segments = 0;
+    while (reader.next_segment(offset, batch)) {
+        ++segments;
+        all.insert(all.end(), batch.begin(), batch.end());
+    }
+    if (segments != 3 || all.size() != 7) return 2;
+    if (all[3].ts_monotonic_ns != 4000000000ULL || all[3].ts_wall_ms != 1700000003000ULL) return 3;
+    if (all[3].target_name != "a" || all[3].type != "probe.tcp.connect") return 4;
+    if (all[3].metric_ms != 13.5 || !all[3].ok || all[3].timeout_ms != 2000) return 5;
+    if (all[6].ok || all[6].error_category != "timeout") return 6;
+
+    irr::ReportStats stats;
+    if (!irr::generate_report(dir, dir + "/report.html", stats)) return 7;
+    if (stats.total != 7 || stats.failures != 1) return 8;
+    if (stats.per_target["a"].size() != 3) return 9;
+    return 0;
+}
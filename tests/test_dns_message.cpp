@@ -0,0 +1,102 @@
+#include <sys/socket.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "../src/probes/dns_message.hpp"
+
+namespace {
+using Bytes = std::vector<uint8_t>;
+
+void put16(Bytes& b, uint16_t v) {
+    b.push_back(static_cast<uint8_t>(v >> 8));
+    b.push_back(static_cast<uint8_t>(v & 0xff));
+}
+
+void put32(Bytes& b, uint32_t v) {
+    put16(b, static_cast<uint16_t>(v >> 16));
+    put16(b, static_cast<uint16_t>(v & 0xffff));
+}
+
+Bytes header(uint16_t flags, uint16_t qd, uint16_t an, uint16_t ns, uint16_t ar) {
+    Bytes b;
+    put16(b, 0xbeef);
+    put16(b, flags);
+    put16(b, qd);
+    put16(b, an);
+    put16(b, ns);
+    put16(b, ar);
+    return b;
+}
+
+// www.example.com A IN, starting at offset 12.
+void question(Bytes& b) {
+    const char name[] = "\3www\7example\3com";
+    b.insert(b.end(), name, name + sizeof(name));
+    put16(b, 1);
+    put16(b, 1);
+}
+
+void record(Bytes& b, uint16_t name_ptr, uint16_t type, uint32_t ttl, const Bytes& rdata) {
+    put16(b, static_cast<uint16_t>(0xc000 | name_ptr));
+    put16(b, type);
+    put16(b, 1);
+    put32(b, ttl);
+    put16(b, static_cast<uint16_t>(rdata.size()));
+    b.insert(b.end(), rdata.begin(), rdata.end());
+}
+}  // namespace
+
+int main() {
+    // CNAME chain with compression: www -> cdn.example.com (pointer into the question), then
+    // two A records owned by the CNAME target, then an EDNS0 OPT with extended RCODE bits.
+    Bytes m = header(0x8180, 1, 3, 0, 1);
+    question(m);
+    size_t cname_at = m.size() + 12;  // rdata of the first record
+    record(m, 12, 5, 600, {3, 'c', 'd', 'n', 0xc0, 16});
+    record(m, static_cast<uint16_t>(cname_at), 1, 120, {192, 0, 2, 1});
+    record(m, static_cast<uint16_t>(cname_at), 1, 90, {192, 0, 2, 2});
+    m.insert(m.end(), {0, 0, 41, 0x04, 0xd0, 0x01, 0, 0, 0, 0, 0});  // OPT, ext rcode 1
+    irr::DnsMessage msg;
+    if (!irr::parse_dns_message(m.data(), m.size(), msg)) return 1;
+    if (!msg.response || msg.truncated || msg.id != 0xbeef) return 2;
+    if (msg.addr_count != 2 || msg.addr_family[1] != AF_INET || msg.addrs[1][3] != 2) return 3;
+    if (msg.min_ttl != 90 || !msg.edns || msg.udp_size != 1232 || msg.rcode != 16) return 4;
+    if (msg.question_off != 12 || msg.question_len != 21) return 5;
+
+    // Every truncation of a valid message fails cleanly (and never reads past the end).
+    for (size_t n = 0; n < m.size(); ++n) {
+        Bytes cut(m.begin(), m.begin() + static_cast<long>(n));
+        if (irr::parse_dns_message(cut.data(), cut.size(), msg)) return 6;
+    }
+
+    // NXDOMAIN: negative TTL is min(SOA TTL, SOA MINIMUM).
+    Bytes nx = header(0x8183, 1, 0, 1, 0);
+    question(nx);
+    Bytes soa = {2, 'n', 's', 0xc0, 16, 4, 'h', 'o', 's', 't', 0xc0, 16};
+    for (uint32_t v : {1u, 7200u, 900u, 1209600u, 60u}) put32(soa, v);  // MINIMUM 60
+    record(nx, 16, 6, 3600, soa);
+    if (!irr::parse_dns_message(nx.data(), nx.size(), msg)) return 7;
+    if (msg.rcode != 3 || msg.addr_count != 0 || msg.min_ttl != 60) return 8;
+
+    // An authority SOA with a bad RDLENGTH is skipped; the answer is still reported.
+    Bytes bad = header(0x8180, 1, 1, 1, 0);
+    question(bad);
+    record(bad, 12, 1, 300, {192, 0, 2, 9});
+    record(bad, 16, 6, 3600, Bytes(soa.begin(), soa.end() - 4));
+    if (!irr::parse_dns_message(bad.data(), bad.size(), msg)) return 11;
+    if (msg.addr_count != 1 || msg.addrs[0][3] != 9 || msg.min_ttl != 300) return 12;
+
+    // A pointer to itself (or forwards) is rejected rather than followed.
+    Bytes loop = header(0x8180, 1, 0, 0, 0);
+    put16(loop, 0xc00c);
+    put16(loop, 1);
+    put16(loop, 1);
+    if (irr::parse_dns_message(loop.data(), loop.size(), msg)) return 9;
+
+    // TC set: the header is still reported even though the body is cut short.
+    Bytes tc = header(0x8380, 1, 1, 0, 0);
+    question(tc);
+    if (irr::parse_dns_message(tc.data(), tc.size(), msg) || !msg.truncated) return 10;
+    return 0;
+}
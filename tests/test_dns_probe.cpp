@@ -0,0 +1,258 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../src/core/event_bus.hpp"
+#include "../src/core/reactor.hpp"
+#include "../src/probes/dns_probe.hpp"
+#include "test_support.hpp"
+
+namespace {
+struct Query {
+    uint8_t buf[512];
+    size_t len;
+    sockaddr_in from;
+};
+
+int udp_socket(sockaddr_in& addr, uint32_t ip = INADDR_LOOPBACK, uint16_t port = 0) {
+    int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(ip);
+    addr.sin_port = htons(port);
+    socklen_t len = sizeof(addr);
+    ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    ::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len);
+    timeval tv{1, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+enum ReplyFlags { kAnswer = 1, kTruncated = 2 };
+
+// Answers q with the given txid and rcode, optionally replacing the first qname letter. With
+// kAnswer one A record (TTL 300, 192.0.2.7) goes in ahead of the echoed EDNS0 OPT record;
+// kTruncated sets TC.
+void reply(int fd, const Query& q, uint16_t id, int rcode, char first_letter = 0, int flags = 0) {
+    static const uint8_t kRecord[] = {0xc0, 0x0c, 0, 1, 0, 1, 0, 0, 0x01, 0x2c, 0, 4, 192, 0, 2, 7};
+    constexpr size_t kOpt = 11;
+    uint8_t out[512];
+    size_t len = q.len - kOpt;
+    std::memcpy(out, q.buf, len);
+    if (flags & kAnswer) {
+        out[7] = 1;  // ANCOUNT
+        std::memcpy(out + len, kRecord, sizeof(kRecord));
+        len += sizeof(kRecord);
+    }
+    std::memcpy(out + len, q.buf + q.len - kOpt, kOpt);
+    len += kOpt;
+    out[0] = id >> 8;
+    out[1] = id & 0xff;
+    out[2] |= 0x80;
+    if (flags & kTruncated) out[2] |= 0x02;
+    out[3] = static_cast<uint8_t>(rcode);
+    if (first_letter) out[13] = static_cast<uint8_t>(first_letter);
+    ::sendto(fd, out, len, 0, reinterpret_cast<const sockaddr*>(&q.from), sizeof(q.from));
+}
+
+uint16_t txid(const Query& q) {
+    return static_cast<uint16_t>((q.buf[0] << 8) | q.buf[1]);
+}
+
+// TCP side of the fake resolver, run on the probe's own reactor. Once the fallbacks for "c"
+// (sent early, on TC) and "d" and "e" (sent on timeout) have arrived it answers d (SERVFAIL)
+// then c in one write, exactly once, and leaves e unanswered.
+struct TcpServer {
+    irr::Reactor& reactor;
+    int listener{-1};
+    int conn{-1};
+    int accepts{0};
+    bool answered{false};
+    std::vector<uint8_t> in{};
+    std::vector<Query> queries{};
+
+    void on_accept() {
+        int fd = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+        ++accepts;
+        conn = fd;
+        reactor.add_fd(fd, EPOLLIN, [this](uint32_t) { on_read(); });
+    }
+
+    void on_read() {
+        uint8_t buf[2048];
+        ssize_t n;
+        while ((n = ::recv(conn, buf, sizeof(buf), 0)) > 0) in.insert(in.end(), buf, buf + n);
+        while (in.size() >= 2 && in.size() >= 2u + ((in[0] << 8) | in[1])) {
+            Query q{};
+            q.len = static_cast<size_t>((in[0] << 8) | in[1]);
+            std::memcpy(q.buf, in.data() + 2, q.len);
+            in.erase(in.begin(), in.begin() + 2 + static_cast<long>(q.len));
+            queries.push_back(q);
+        }
+        if (queries.size() != 3 || answered) return;
+        answered = true;
+        std::vector<uint8_t> out;
+        for (char name : {'d', 'c'}) {
+            for (auto& q : queries) {
+                if (q.buf[13] != name) continue;
+                q.buf[2] |= 0x80;
+                q.buf[3] = name == 'd' ? 2 : 0;
+                out.push_back(static_cast<uint8_t>(q.len >> 8));
+                out.push_back(static_cast<uint8_t>(q.len & 0xff));
+                out.insert(out.end(), q.buf, q.buf + q.len);
+            }
+        }
+        ::send(conn, out.data(), out.size(), MSG_NOSIGNAL);
+    }
+};
+
+// Two resolvers on one port: the probe asks both from the same pooled socket and reports the
+// first NOERROR as probe.dns.first_answer.
+int multi_resolver() {
+    sockaddr_in a_addr{}, b_addr{};
+    int a = udp_socket(a_addr);
+    int b = udp_socket(b_addr, INADDR_LOOPBACK + 1, ntohs(a_addr.sin_port));
+    if (b_addr.sin_port != a_addr.sin_port) return 20;
+
+    irr::EventBus bus;
+    irr::test::Collect sink;
+    bus.add_sink(&sink);
+    irr::Reactor reactor;
+    irr::DnsProbe probe(bus, "test");
+    probe.set_resolvers({"127.0.0.1", "127.0.0.2", "127.0.0.1"}, ntohs(a_addr.sin_port));
+    probe.start(reactor, {{"m", "m.example", 0, 500}});
+    if (probe.resolver_count() != 2) return 21;  // the duplicate is dropped
+    probe.fire(0);
+    reactor.loop_once(0);
+
+    Query qa{}, qb{};
+    socklen_t flen = sizeof(qa.from);
+    ssize_t na = ::recvfrom(a, qa.buf, sizeof(qa.buf), 0,
+                            reinterpret_cast<sockaddr*>(&qa.from), &flen);
+    flen = sizeof(qb.from);
+    ssize_t nb = ::recvfrom(b, qb.buf, sizeof(qb.buf), 0,
+                            reinterpret_cast<sockaddr*>(&qb.from), &flen);
+    if (na < 12 || nb < 12) return 22;
+    qa.len = static_cast<size_t>(na);
+    qb.len = static_cast<size_t>(nb);
+    if (qa.from.sin_port != qb.from.sin_port) return 23;  // one shared socket
+    // b answers first. The same txid from a is not b's answer (unless it happens to be a's
+    // own), and a then fails with SERVFAIL.
+    bool cross = txid(qa) != txid(qb);
+    reply(b, qb, txid(qb), 0, 0, kAnswer);
+    if (cross) reply(a, qb, txid(qb), 0);
+    reply(a, qa, txid(qa), 2);
+
+    irr::test::run_until(reactor, sink, 3, 100);
+    probe.stop();
+    ::close(a);
+    ::close(b);
+
+    if (sink.events.size() != 3) return 24;
+    int firsts = 0;
+    for (const auto& ev : sink.events) {
+        if (ev.type != irr::EventType::DnsFirstAnswer) continue;
+        ++firsts;
+        if (!ev.ok || irr::symbols().name(ev.target_ip) != "127.0.0.2" || ev.answer_count != 1)
+            return 25;
+    }
+    if (firsts != 1 || probe.rejected() != (cross ? 1u : 0u)) return 26;
+    const auto& sa = probe.resolver_stats(0);
+    const auto& sb = probe.resolver_stats(1);
+    if (sa.sent != 1 || sa.failed != 1 || sb.answered != 1 || sb.first != 1) return 27;
+    return 0;
+}
+}  // namespace
+
+int main() {
+    if (int rc = multi_resolver()) return rc;
+    sockaddr_in server_addr{}, other_addr{};
+    int server = udp_socket(server_addr);
+    int other = udp_socket(other_addr);
+
+    irr::EventBus bus;
+    irr::test::Collect sink;
+    bus.add_sink(&sink);
+    irr::Reactor reactor;
+
+    TcpServer tcp{reactor};
+    tcp.listener = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (::bind(tcp.listener, reinterpret_cast<sockaddr*>(&server_addr), sizeof(server_addr)) < 0 ||
+        ::listen(tcp.listener, 8) < 0)
+        return 10;
+    reactor.add_fd(tcp.listener, EPOLLIN, [&tcp](uint32_t) { tcp.on_accept(); });
+
+    irr::DnsProbe probe(bus, "test");
+    probe.set_resolver("127.0.0.1", ntohs(server_addr.sin_port));
+    probe.set_kernel_timestamps(true);
+    probe.start(reactor, {{"a", "a.example", 0, 100},
+                          {"b", "b.example", 0, 100},
+                          {"c", "c.example", 0, 1000},
+                          {"d", "d.example", 0, 100},
+                          {"e", "e.example", 0, 100}});
+    probe.tick();
+    reactor.loop_once(0);  // flushes the queued queries in one batch
+
+    std::vector<Query> queries(5);
+    for (auto& q : queries) {
+        socklen_t flen = sizeof(q.from);
+        ssize_t n = ::recvfrom(server, q.buf, sizeof(q.buf), 0,
+                               reinterpret_cast<sockaddr*>(&q.from), &flen);
+        if (n < 12) return 1;
+        q.len = static_cast<size_t>(n);
+    }
+    for (auto& q : queries) {
+        // "c" is truncated and goes straight to TCP, where it outlives the UDP timeouts that
+        // send "d" and "e" after it.
+        if (q.buf[13] == 'c') reply(server, q, txid(q), 0, 0, kTruncated);
+        // Answers for "a" and "b".
+        if (q.buf[13] != 'a' && q.buf[13] != 'b') continue;
+        // Wrong source port, wrong txid and a different question are all dropped...
+        reply(other, q, txid(q), 0);
+        reply(server, q, static_cast<uint16_t>(txid(q) + 1), 0);
+        reply(server, q, txid(q), 0, 'z');
+        // ...before the genuine answer, which still matches (names are case-insensitive).
+        if (q.buf[13] == 'a')
+            reply(server, q, txid(q), 0, 'A', kAnswer);
+        else
+            reply(server, q, txid(q), 3);
+    }
+
+    irr::test::run_until(reactor, sink, 5, 200);
+    probe.stop();
+    ::close(server);
+    ::close(other);
+    ::close(tcp.listener);
+    if (tcp.conn >= 0) ::close(tcp.conn);
+
+    if (sink.events.size() != 5) return 2;
+    if (probe.rejected() != 6) return 3;
+    // All three fallbacks were pipelined on a single connection.
+    if (tcp.accepts != 1 || tcp.queries.size() != 3) return 7;
+    for (const auto& ev : sink.events) {
+        const std::string& name = irr::symbols().name(ev.target_name);
+        if (name == "a" && !(ev.ok && ev.type == irr::EventType::DnsResult)) return 4;
+        char ip[64];
+        if (name == "a" && (ev.answer_count != 1 || ev.min_ttl != 300 ||
+                            std::string(ip, irr::format_answer_ip(ev, ip, sizeof(ip))) !=
+                                "192.0.2.7"))
+            return 13;
+        // The kernel stamp excludes the time the reply sat waiting for the reactor.
+        if (name == "a" && (ev.kernel_ms < 0 || ev.kernel_ms > ev.metric_ms)) return 11;
+        if (name == "c" && ev.kernel_ms >= 0) return 12;  // TCP fallback: not measured
+        if (name == "b" && (ev.ok || ev.error != irr::ErrorCode::DnsRcode || ev.error_detail != 3))
+            return 5;
+        if (name == "c" && !(ev.ok && ev.error == irr::ErrorCode::TcpFallbackSuccess)) return 6;
+        if (name == "d" && (ev.ok || ev.error != irr::ErrorCode::DnsRcode || ev.error_detail != 2))
+            return 8;
+        if (name == "e" && (ev.ok || ev.error != irr::ErrorCode::Timeout)) return 9;
+    }
+    return 0;
+}
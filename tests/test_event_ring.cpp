@@ -0,0 +1,65 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "../src/core/event_bus.hpp"
+#include "../src/core/event_ring.hpp"
+
+namespace {
+struct CountingSink : irr::EventSink {
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+    void on_event(const irr::Event& ev) override {
+        count.fetch_add(1);
+        sum.fetch_add(ev.ts_monotonic_ns);
+    }
+};
+
+irr::Event make(uint64_t ts) {
+    irr::Event ev;
+    ev.ts_monotonic_ns = ts;
+    return ev;
+}
+}  // namespace
+
+int main() {
+    {
+        irr::EventRing ring(4, irr::OverflowPolicy::DropNewest);
+        for (uint64_t i = 0; i < 4; ++i)
+            if (!ring.push(make(i))) return 1;
+        if (ring.push(make(99))) return 2;
+        auto st = ring.stats();
+        if (st.depth != 4 || st.dropped != 1 || st.max_depth != 4) return 3;
+        irr::Event out;
+        if (!ring.try_pop(out) || out.ts_monotonic_ns != 0) return 4;
+    }
+    {
+        irr::EventRing ring(4, irr::OverflowPolicy::DropOldest);
+        for (uint64_t i = 0; i < 6; ++i) ring.push(make(i));
+        if (ring.stats().dropped != 2) return 5;
+        irr::Event out;
+        if (!ring.try_pop(out) || out.ts_monotonic_ns != 2) return 6;
+    }
+    {
+        CountingSink sink;
+        irr::EventBus bus;
+        bus.add_sink(&sink);
+        irr::AsyncBusOptions opts;
+        opts.capacity = 64;
+        opts.overflow = irr::OverflowPolicy::Block;
+        if (!bus.start_async(opts)) return 7;
+        const uint64_t per_thread = 20000;
+        std::vector<std::thread> producers;
+        for (int t = 0; t < 4; ++t) {
+            producers.emplace_back([&bus]() {
+                for (uint64_t i = 1; i <= per_thread; ++i) bus.emit(make(i));
+            });
+        }
+        for (auto& p : producers) p.join();
+        bus.stop_async();
+        if (sink.count != 4 * per_thread) return 8;
+        if (sink.sum != 4 * (per_thread * (per_thread + 1) / 2)) return 9;
+        if (bus.stats().dropped != 0) return 10;
+    }
+    return 0;
+}
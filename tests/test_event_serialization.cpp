@@ -1,3 +1,4 @@
+#include <filesystem>
 #include <fstream>
 #include <string>
 
@@ -6,25 +7,54 @@
 
 int main() {
     std::string path = "/tmp/irr_test_events.jsonl";
+    std::filesystem::remove(path);
     {
         irr::JsonlStore store(path);
-        irr::Event ev{"run",
-                      123,
-                      "2023-01-01T00:00:00Z",
-                      "probe.tcp.connect",
-                      "t",
-                      "1.1.1.1",
-                      "inet",
-                      1000,
-                      2000,
-                      true,
-                      12.3,
-                      ""};
+        auto& syms = irr::symbols();
+        irr::Event ev;
+        ev.run_id = syms.intern("run");
+        ev.ts_monotonic_ns = 123;
+        ev.ts_wall_ns = 1672531200ULL * 1000000000ULL;
+        ev.type = irr::EventType::TcpConnect;
+        ev.target_name = syms.intern("t");
+        ev.target_ip = syms.intern("1.1.1.1");
+        ev.target_family = syms.intern("inet");
+        ev.interval_ms = 1000;
+        ev.timeout_ms = 2000;
+        ev.ok = false;
+        ev.metric_ms = 12.3;
+        ev.error = irr::ErrorCode::SoError;
+        ev.error_detail = 111;
         store.on_event(ev);
     }
     std::ifstream in(path);
     std::string line;
     std::getline(in, line);
-    bool ok = line.find("probe.tcp.connect") != std::string::npos;
-    return ok ? 0 : 1;
+    bool ok = line.find("probe.tcp.connect") != std::string::npos &&
+              line.find("\"ts_wall\":\"2023-01-01T00:00:00Z\"") != std::string::npos &&
+              line.find("\"name\":\"t\"") != std::string::npos &&
+              line.find("\"error_category\":\"so_error_111\"") != std::string::npos;
+    if (!ok) return 1;
+
+    // Batched writes with a group-commit threshold; everything lands by destruction.
+    std::filesystem::remove(path);
+    {
+        irr::CommitPolicy policy;
+        policy.max_events = 2;
+        irr::JsonlStore store(path, policy);
+        irr::Event evs[3];
+        evs[0].metric_ms = 1500;
+        evs[1].metric_ms = 0.25;
+        evs[2].metric_ms = 12.3456;
+        store.on_events({evs, 3});
+        store.on_event(evs[0]);
+    }
+    std::ifstream batch(path);
+    int lines = 0;
+    bool formatted = false;
+    while (std::getline(batch, line)) {
+        ++lines;
+        if (line.find("\"metric_ms\":12.346,") != std::string::npos) formatted = true;
+    }
+    return lines == 4 && formatted ? 0 : 2;
 }
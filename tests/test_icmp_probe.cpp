@@ -0,0 +1,41 @@
+#include "../src/core/event_bus.hpp"
+#include "../src/core/reactor.hpp"
+#include "../src/probes/icmp_probe.hpp"
+#include "test_support.hpp"
+
+int main() {
+    irr::EventBus bus;
+    irr::test::Collect sink;
+    bus.add_sink(&sink);
+    irr::Reactor reactor;
+
+    irr::IcmpProbe probe(bus, "test");
+    if (!probe.can_run()) return 0;  // no ping sockets and no CAP_NET_RAW: nothing to test
+    probe.set_stateless(true);
+    probe.set_payload_size(1000);
+    probe.set_kernel_timestamps(true);
+    probe.start(reactor, {{"v4", "127.0.0.1", 1000, 500}, {"v6", "::1", 1000, 500}});
+    // Two pings to v4 before any reply is read: the first loses its slot and is reported
+    // lost, and its reply is then dropped as stale.
+    probe.fire(0);
+    probe.fire(0);
+    probe.fire(1);
+    irr::test::run_until(reactor, sink, 3, 100);
+    for (int i = 0; i < 5; ++i) reactor.loop_once(10);  // nothing else may arrive
+    probe.stop();
+
+    if (sink.events.size() != 3) return 1;
+    int lost = 0, ok = 0;
+    for (const auto& ev : sink.events) {
+        if (ev.type == irr::EventType::IcmpTimeout) {
+            if (ev.error != irr::ErrorCode::Timeout) return 2;
+            if (irr::symbols().name(ev.target_name) != "v4") return 3;
+            ++lost;
+        } else if (ev.type == irr::EventType::IcmpRtt && ev.ok) {
+            if (ev.metric_ms < 0 || ev.metric_ms > 500) return 4;
+            if (ev.kernel_ms > ev.metric_ms) return 5;
+            ++ok;
+        }
+    }
+    return lost == 1 && ok == 2 ? 0 : 6;
+}
@@ -0,0 +1,96 @@
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../src/core/event.hpp"
+#include "../src/core/store_jsonl.hpp"
+#include "../src/core/symbols.hpp"
+#include "../src/report/jsonl_scan.hpp"
+
+namespace {
+struct Expect {
+    std::string line;
+    bool valid;
+    std::string type;
+    std::string name;
+    bool ok;
+    double metric;
+    uint64_t ts{0};
+};
+
+int check_all(const std::vector<Expect>& cases) {
+    std::string scratch;
+    irr::JsonlFields f;
+    for (size_t i = 0; i < cases.size(); ++i) {
+        const Expect& c = cases[i];
+        if (irr::scan_event_line(c.line, f, scratch) != c.valid) return 1;
+        if (!c.valid) continue;
+        if (f.type != c.type || f.target_name != c.name) return 2;
+        if (!f.has_ok || f.ok != c.ok || f.metric_ms != c.metric) return 3;
+        if (f.ts_monotonic_ns != c.ts) return 4;
+    }
+    return 0;
+}
+}  // namespace
+
+int main() {
+    // A real line from the writer, including a name that needs escaping.
+    std::string path = "/tmp/irr_jsonl_scan_test.jsonl";
+    ::unlink(path.c_str());
+    {
+        irr::JsonlStore store(path, irr::CommitPolicy{});
+        irr::Event ev;
+        ev.run_id = irr::symbols().intern("run");
+        ev.type = irr::EventType::TcpConnect;
+        ev.ts_monotonic_ns = 18446744073709551615ULL;
+        ev.target_name = irr::symbols().intern("we\"ird\\name\x01");
+        ev.target_ip = irr::symbols().intern("192.0.2.1");
+        ev.target_family = irr::symbols().intern("inet");
+        ev.ok = true;
+        ev.metric_ms = 12.25;
+        store.on_event(ev);
+        ev.ok = false;
+        ev.metric_ms = 0;
+        ev.error = irr::ErrorCode::Timeout;
+        store.on_event(ev);
+    }
+    irr::JsonlFileReader reader;
+    if (!reader.open(path)) return 10;
+    std::vector<std::string> lines;
+    std::string_view line;
+    while (reader.next(line)) lines.emplace_back(line);
+    if (lines.size() != 2) return 11;
+
+    std::string pad(70, 'x');  // pushes the escapes across a 64-byte block boundary
+    std::vector<Expect> cases = {
+        {lines[0], true, "probe.tcp.connect", "we\"ird\\name\x01", true, 12.25,
+         18446744073709551615ULL},
+        {lines[1], true, "probe.tcp.connect", "we\"ird\\name\x01", false, 0,
+         18446744073709551615ULL},
+        {"{\"type\":\"probe.dns.result\",\"target\":{\"name\":\"t\"},\"result\":{\"ok\":true,"
+         "\"metric_ms\":-1.5e1}}",
+         true, "probe.dns.result", "t", true, -15},
+        // "name" and "ok" outside their objects are ignored; spaces are tolerated.
+        {"{ \"name\": \"no\", \"ok\": false, \"type\": \"x\", \"ts_monotonic_ns\": 42, "
+         "\"target\": { \"name\": \"caf\\u00e9\" }, "
+         "\"result\": { \"ok\": true, \"metric_ms\": 3 } }",
+         true, "x", "caf\xc3\xa9", true, 3, 42},
+        {"{\"type\":\"x\",\"target\":{\"name\":\"" + pad + "a\\\\\\\"b\\\\\"},\"result\":{\"ok\":"
+         "true,\"metric_ms\":1}}",
+         true, "x", pad + "a\\\"b\\", true, 1},
+        {"{\"type\":\"x\",\"result\":{\"ok\":true}}", false, "", "", false, 0},
+        {"{\"type\":\"x\",\"result\":{\"ok\":true,\"metric_ms\":1x}}", false, "", "", false, 0},
+        {"{\"type\":\"unterminated", false, "", "", false, 0},
+        {"", false, "", "", false, 0},
+    };
+    // Every classifier the CPU has must agree.
+    for (auto isa : {irr::JsonlScanIsa::Scalar, irr::JsonlScanIsa::Sse2, irr::JsonlScanIsa::Avx2}) {
+        if (!irr::set_jsonl_scan_isa(isa)) continue;
+        if (int rc = check_all(cases)) return rc + 20 * (static_cast<int>(isa) + 1);
+    }
+    ::unlink(path.c_str());
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../src/core/event_bus.hpp"
+#include "../src/probes/netlink_monitor.hpp"
+#include "test_support.hpp"
+
+namespace {
+void add_attr(std::vector<char>& buf, unsigned short type, const void* data, size_t len) {
+    rtattr a{};
+    a.rta_type = type;
+    a.rta_len = static_cast<unsigned short>(RTA_LENGTH(len));
+    size_t off = buf.size();
+    buf.resize(off + RTA_SPACE(len));
+    std::memcpy(buf.data() + off, &a, sizeof(a));
+    std::memcpy(buf.data() + off + RTA_LENGTH(0), data, len);
+}
+
+// Appends one complete message (header + body + attributes) to out.
+void append_msg(std::vector<char>& out, unsigned short type, const void* body, size_t body_len,
+                const std::vector<char>& attrs) {
+    nlmsghdr nh{};
+    nh.nlmsg_type = type;
+    nh.nlmsg_len = static_cast<uint32_t>(NLMSG_LENGTH(NLMSG_ALIGN(body_len) + attrs.size()));
+    size_t off = out.size();
+    out.resize(off + NLMSG_ALIGN(nh.nlmsg_len));
+    std::memcpy(out.data() + off, &nh, sizeof(nh));
+    std::memcpy(out.data() + off + NLMSG_HDRLEN, body, body_len);
+    std::memcpy(out.data() + off + NLMSG_HDRLEN + NLMSG_ALIGN(body_len), attrs.data(),
+                attrs.size());
+}
+
+void append_route(std::vector<char>& out, unsigned short type, const char* dst, int dst_len,
+                  const char* gw, int oif) {
+    rtmsg rtm{};
+    rtm.rtm_family = AF_INET;
+    rtm.rtm_dst_len = static_cast<unsigned char>(dst_len);
+    std::vector<char> attrs;
+    in_addr a;
+    ::inet_pton(AF_INET, dst, &a);
+    add_attr(attrs, RTA_DST, &a, sizeof(a));
+    ::inet_pton(AF_INET, gw, &a);
+    add_attr(attrs, RTA_GATEWAY, &a, sizeof(a));
+    add_attr(attrs, RTA_OIF, &oif, sizeof(oif));
+    append_msg(out, type, &rtm, sizeof(rtm), attrs);
+}
+}  // namespace
+
+int main() {
+    // Decoding: a link going down, by name and MTU.
+    std::vector<char> link;
+    ifinfomsg ifi{};
+    ifi.ifi_index = 42;
+    ifi.ifi_flags = IFF_UP;  // up but not running: carrier lost
+    std::vector<char> attrs;
+    add_attr(attrs, IFLA_IFNAME, "wlan9", 6);
+    uint32_t mtu = 1492;
+    add_attr(attrs, IFLA_MTU, &mtu, sizeof(mtu));
+    append_msg(link, RTM_NEWLINK, &ifi, sizeof(ifi), attrs);
+    irr::NetlinkChange c;
+    if (!irr::parse_netlink_change(reinterpret_cast<const nlmsghdr*>(link.data()), c)) return 1;
+    if (c.kind != irr::ErrorCode::LinkDown || c.ifindex != 42 || c.mtu != 1492) return 2;
+    if (std::string(c.ifname) != "wlan9") return 3;
+
+    // Coalescing: the link event and 19 route adds in one batch, then 5 deletes.
+    irr::EventBus bus;
+    irr::test::Collect sink;
+    bus.add_sink(&sink);
+    irr::NetlinkMonitor mon(bus, "test");
+    int batches = 0;
+    mon.set_change_handler([&batches]() { ++batches; });
+    std::vector<char> storm = link;
+    for (int i = 0; i < 19; ++i) {
+        std::string dst = "10.0." + std::to_string(i) + ".0";
+        append_route(storm, RTM_NEWROUTE, dst.c_str(), 24, "192.0.2.1", 42);
+    }
+    mon.feed(storm.data(), storm.size());
+    std::vector<char> dels;
+    for (int i = 0; i < 5; ++i) append_route(dels, RTM_DELROUTE, "10.1.0.0", 16, "192.0.2.1", 42);
+    mon.feed(dels.data(), dels.size());
+    mon.stop();  // no reactor: the window closes here
+
+    if (batches != 2) return 4;
+    const size_t burst = irr::NetlinkMonitor::kBurst;
+    if (sink.events.size() != burst + 2) return 5;
+    const irr::Event& first = sink.events[1];  // the first route, rendered in full
+    if (first.type != irr::EventType::RouteChange || first.error != irr::ErrorCode::RouteAdd ||
+        irr::symbols().name(first.target_name) != "wlan9" ||
+        irr::symbols().name(first.target_ip) != "10.0.0.0/24 via 192.0.2.1")
+        return 6;
+    double adds = 0, dels_seen = 0;
+    for (size_t i = burst; i < sink.events.size(); ++i) {
+        const irr::Event& ev = sink.events[i];
+        if (irr::symbols().name(ev.target_name) != "coalesced") return 7;
+        if (ev.error == irr::ErrorCode::RouteAdd) adds = ev.metric_ms;
+        if (ev.error == irr::ErrorCode::RouteDel) dels_seen = ev.metric_ms;
+    }
+    // 1 link + 7 routes went out individually; 12 adds and 5 deletes were counted.
+    return adds == 12 && dels_seen == 5 ? 0 : 8;
+}
@@ -0,0 +1,38 @@
+#include "../src/core/event_bus.hpp"
+#include "../src/core/reactor.hpp"
+#include "../src/probes/pmtu_probe.hpp"
+#include "../src/probes/resolver_cache.hpp"
+#include "test_support.hpp"
+
+int main() {
+    irr::EventBus bus;
+    irr::test::Collect sink;
+    bus.add_sink(&sink);
+    irr::Reactor reactor;
+    irr::ResolverCache resolver(bus, "test");
+    irr::PmtuProbe probe(bus, "test");
+    // Port 9 on loopback is closed, so each probe is answered with a port unreachable.
+    probe.start(reactor, resolver, {{"lo", "127.0.0.1", 9}});
+    resolver.start(reactor);
+
+    probe.fire(0);
+    probe.fire(0);  // already running: ignored
+    irr::test::run_until(reactor, sink, 1);
+    if (sink.events.size() != 1) return 1;
+    const irr::Event& ev = sink.events[0];
+    // The whole loopback route MTU fits, confirmed by the destination itself.
+    if (!ev.ok || ev.metric_ms < 1280 || ev.error != irr::ErrorCode::ConfidenceHigh) return 2;
+
+    probe.fire(0);  // cached: no new search
+    for (int i = 0; i < 5; ++i) reactor.loop_once(10);
+    if (sink.events.size() != 1) return 3;
+
+    probe.invalidate();  // e.g. a netlink route change
+    probe.fire(0);
+    irr::test::run_until(reactor, sink, 2);
+    if (sink.events.size() != 2 || sink.events[1].metric_ms != ev.metric_ms) return 4;
+
+    probe.stop();
+    resolver.stop();
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../src/core/latency_sink.hpp"
+#include "../src/util/percentile.hpp"
+#include "../src/util/quantile_sketch.hpp"
+
+namespace {
+// Deterministic, heavy-tailed latencies between roughly 0.5 ms and 2 s.
+std::vector<double> latencies(size_t n) {
+    std::vector<double> out;
+    uint64_t x = 88172645463325252ULL;
+    for (size_t i = 0; i < n; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        double u = static_cast<double>(x >> 11) / 9007199254740992.0;
+        out.push_back(0.5 * std::exp(u * u * 8.3));
+    }
+    return out;
+}
+}  // namespace
+
+int main() {
+    using irr::QuantileSketch;
+    auto samples = latencies(100000);
+    auto sorted = samples;
+    std::sort(sorted.begin(), sorted.end());
+    const double ps[] = {0, 1, 10, 25, 50, 75, 90, 95, 99, 99.9, 100};
+
+    // Every estimate is within the relative error of the exact answer.
+    for (double alpha : {0.01, 0.002}) {
+        QuantileSketch sketch(alpha);
+        for (double v : samples) sketch.add(v);
+        if (sketch.size() != samples.size()) return 1;
+        for (double p : ps) {
+            double exact = irr::percentile_sorted(sorted, p);
+            if (std::fabs(sketch.quantile(p) - exact) > alpha * exact + 1e-12) return 2;
+        }
+        // The extremes are the exact min and max.
+        if (sketch.quantile(0) != sketch.min() || sketch.quantile(100) != sketch.max()) return 3;
+        // Memory follows the value range, not the sample count.
+        double gamma = (1 + alpha) / (1 - alpha);
+        if (sketch.bucket_count() > std::log(sketch.max() / sketch.min()) / std::log(gamma) + 2)
+            return 4;
+    }
+
+    // Merging partial sketches gives exactly the single-pass sketch, in either mode.
+    for (bool exact : {false, true}) {
+        QuantileSketch whole = exact ? QuantileSketch::exact() : QuantileSketch();
+        QuantileSketch parts[3] = {whole.empty_like(), whole.empty_like(), whole.empty_like()};
+        for (size_t i = 0; i < samples.size(); ++i) {
+            whole.add(samples[i]);
+            parts[i * 3 / samples.size()].add(samples[i]);
+        }
+        QuantileSketch merged = whole.empty_like();
+        for (const auto& p : parts) merged.merge(p);
+        if (merged != whole || merged.quantile(99) != whole.quantile(99)) return 5;
+    }
+
+    // Exact mode answers like percentile().
+    QuantileSketch exact = QuantileSketch::exact();
+    for (double v : samples) exact.add(v);
+    for (double p : ps)
+        if (exact.quantile(p) != irr::percentile_sorted(sorted, p)) return 6;
+
+    // An exact sketch merged into an approximate one (and the reverse) becomes approximate.
+    QuantileSketch mixed(0.01);
+    mixed.merge(exact);
+    exact.merge(QuantileSketch(0.01));
+    QuantileSketch approx(0.01);
+    approx.add(1.0);
+    exact.merge(approx);
+    if (mixed.is_exact() || exact.is_exact() || exact.size() != samples.size() + 1) return 7;
+    double median = irr::percentile_sorted(sorted, 50);
+    if (std::fabs(mixed.quantile(50) - median) > 0.01 * median) return 8;
+
+    // Estimates never leave [min, max]; zeros have their own bucket.
+    QuantileSketch one;
+    one.add(7.3);
+    if (one.quantile(50) != 7.3 || one.quantile(99) != 7.3) return 9;
+    QuantileSketch zeros;
+    zeros.add(0.0, 3);
+    zeros.add(5.0);
+    if (zeros.quantile(50) != 0.0 || zeros.size() != 4) return 10;
+
+    // Memory is bounded by kMaxBuckets even for absurd ranges at a tight error.
+    // Only the lowest values lose precision.
+    QuantileSketch wide(0.0005);
+    std::vector<double> wide_samples;
+    for (double v = 1e-6; v < 1e9; v *= 1.001) wide_samples.push_back(v);
+    for (double v : wide_samples) wide.add(v);
+    if (wide.bucket_count() > QuantileSketch::kMaxBuckets) return 11;
+    double p99 = irr::percentile(wide_samples, 99);
+    if (std::fabs(wide.quantile(99) - p99) > 0.0005 * p99) return 12;
+
+    // The live sink keeps one sketch per target for successful latency results only.
+    irr::LatencySink sink;
+    irr::Event ev;
+    ev.type = irr::EventType::TcpConnect;
+    ev.target_name = irr::symbols().intern("b");
+    ev.ok = true;
+    for (int i = 1; i <= 100; ++i) {
+        ev.metric_ms = i;
+        sink.on_event(ev);
+    }
+    ev.ok = false;
+    sink.on_event(ev);
+    ev.ok = true;
+    ev.type = irr::EventType::PmtuResult;
+    sink.on_event(ev);
+    ev.type = irr::EventType::DnsResult;
+    ev.target_name = irr::symbols().intern("a");
+    sink.on_events({&ev, 1});
+    auto snap = sink.snapshot();
+    if (snap.size() != 2 || snap[0].first != "a" || snap[1].second.size() != 100) return 13;
+    if (std::fabs(snap[1].second.quantile(50) - 50.5) > 0.01 * 50.5) return 14;
+    return 0;
+}
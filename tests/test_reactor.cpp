@@ -0,0 +1,169 @@
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../src/core/reactor.hpp"
+#include "../src/util/inline_function.hpp"
+
+namespace {
+int readable_fd() {
+    return ::eventfd(1, EFD_CLOEXEC | EFD_NONBLOCK);
+}
+
+void drain(int fd) {
+    uint64_t v;
+    (void)::read(fd, &v, sizeof(v));
+}
+
+// Two fds are ready in the same batch. Whichever handler runs first closes the other fd and
+// registers a fresh one, which the kernel gives the same number: the other fd's event, already
+// in the batch, must reach neither its old handler nor the new registration.
+struct ReuseState {
+    irr::Reactor* reactor;
+    int fds[2];
+    int calls[2];
+    int closed;
+    int reused;
+    int reused_calls;
+};
+
+int stale_event_after_reuse(irr::ReactorBackend backend) {
+    irr::Reactor reactor(irr::Reactor::kDefaultBatch, backend);
+    ReuseState st{&reactor, {readable_fd(), readable_fd()}, {0, 0}, -1, -1, 0};
+    ReuseState* s = &st;
+    for (int i = 0; i < 2; ++i) {
+        reactor.add_fd(st.fds[i], EPOLLIN, [s, i](uint32_t) {
+            ++s->calls[i];
+            drain(s->fds[i]);
+            if (s->reused >= 0) return;
+            s->closed = s->fds[1 - i];
+            s->reactor->del_fd(s->closed);
+            ::close(s->closed);
+            s->fds[1 - i] = -1;
+            s->reused = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+            s->reactor->add_fd(s->reused, EPOLLIN, [s](uint32_t) { ++s->reused_calls; });
+        });
+    }
+    reactor.loop_once(100);
+    int first = st.calls[0] ? 0 : 1;
+    if (st.reused < 0 || st.reused != st.closed) return 1;  // lowest free number is reused
+    if (st.calls[first] != 1 || st.calls[1 - first] != 0 || st.reused_calls != 0) return 2;
+    reactor.loop_once(0);
+    if (st.reused_calls != 0) return 3;  // the new eventfd is not readable
+    reactor.del_fd(st.reused);
+    ::close(st.reused);
+    for (int fd : st.fds)
+        if (fd >= 0) {
+            reactor.del_fd(fd);
+            ::close(fd);
+        }
+    return 0;
+}
+
+// A handler that registers enough fds to grow the handler slab keeps running on intact state.
+struct GrowState {
+    irr::Reactor* reactor;
+    int fd;
+    std::vector<int> added;
+    int fired;
+    uint64_t tag_seen;
+};
+
+int add_fd_from_handler(irr::ReactorBackend backend) {
+    irr::Reactor reactor(irr::Reactor::kDefaultBatch, backend);
+    GrowState st{&reactor, readable_fd(), {}, 0, 0};
+    GrowState* s = &st;
+    const uint64_t tag = 0x5eed5eed5eed5eedULL;
+    reactor.add_fd(st.fd, EPOLLIN, [s, tag](uint32_t) {
+        drain(s->fd);
+        for (int i = 0; i < 300; ++i) {
+            int nfd = readable_fd();
+            s->added.push_back(nfd);
+            s->reactor->add_fd(nfd, EPOLLIN, [s, nfd](uint32_t) {
+                drain(nfd);
+                ++s->fired;
+            });
+        }
+        s->tag_seen = tag;  // read from the running handler's own capture after the growth
+    });
+    reactor.loop_once(100);
+    if (st.tag_seen != tag || st.added.size() != 300) return 10;
+    for (int i = 0; i < 20 && st.fired < 300; ++i) reactor.loop_once(10);
+    if (st.fired != 300) return 11;
+    for (int nfd : st.added) {
+        reactor.del_fd(nfd);
+        ::close(nfd);
+    }
+    reactor.del_fd(st.fd);
+    ::close(st.fd);
+    return 0;
+}
+
+// io_uring: an fd whose polls keep failing is reported as broken more than once and polled
+// again after the backoff, so it works again once the number refers to a live file.
+struct BrokenState {
+    int fd;
+    int errors;
+    int reads;
+};
+
+int broken_fd_is_retried() {
+    irr::Reactor reactor(irr::Reactor::kDefaultBatch, irr::ReactorBackend::IoUring);
+    if (reactor.backend() != irr::ReactorBackend::IoUring) return 0;  // kernel without it
+    BrokenState st{::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK), 0, 0};
+    BrokenState* s = &st;
+    reactor.add_fd(st.fd, EPOLLIN, [s](uint32_t ev) {
+        if (ev & EPOLLERR) {
+            ++s->errors;
+            return;
+        }
+        drain(s->fd);
+        ++s->reads;
+    });
+    ::close(st.fd);  // still registered: every POLL_ADD now fails with EBADF
+    for (int i = 0; i < 100 && st.errors < 3; ++i) reactor.loop_once(10);
+    if (st.errors < 3 || st.reads != 0) return 30;
+    if (::eventfd(1, EFD_CLOEXEC | EFD_NONBLOCK) != st.fd) return 31;
+    for (int i = 0; i < 200 && st.reads == 0; ++i) reactor.loop_once(10);
+    if (st.reads != 1) return 32;
+    reactor.del_fd(st.fd);
+    ::close(st.fd);
+    return 0;
+}
+
+// Non-trivial captures are moved, not copied, and destroyed exactly once.
+int inline_function_lifetime() {
+    using Fn = irr::InlineFunction<size_t(size_t), 32>;
+    auto owned = std::make_shared<std::string>(100, 'x');
+    {
+        Fn f = [owned](size_t n) { return owned->size() + n; };
+        if (owned.use_count() != 2 || f(1) != 101) return 20;
+        Fn g(std::move(f));
+        if (f || !g || owned.use_count() != 2 || g(2) != 102) return 21;
+        auto other = std::make_shared<std::string>("y");
+        Fn h = [other](size_t n) { return other->size() + n; };
+        h = std::move(g);  // destroys the callable that held `other`
+        if (other.use_count() != 1 || owned.use_count() != 2 || g || h(0) != 100) return 22;
+        h.reset();
+        if (h || owned.use_count() != 1) return 23;
+        Fn k = [owned](size_t) { return owned.use_count(); };
+        if (owned.use_count() != 2) return 24;
+    }
+    if (owned.use_count() != 1) return 25;  // k's capture released by its destructor
+    return 0;
+}
+}  // namespace
+
+int main() {
+    for (auto backend : {irr::ReactorBackend::Epoll, irr::ReactorBackend::IoUring}) {
+        if (int rc = stale_event_after_reuse(backend)) return rc;
+        if (int rc = add_fd_from_handler(backend)) return rc;
+    }
+    if (int rc = broken_fd_is_retried()) return rc;
+    if (int rc = inline_function_lifetime()) return rc;
+    return 0;
+}
@@ -1,10 +1,59 @@
 #include <filesystem>
 #include <fstream>
+#include <iterator>
 #include <string>
 
 #include "../src/report/report_gen.hpp"
 
+namespace {
+std::string read_file(const std::string& path) {
+    std::ifstream in(path);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+// Chunked aggregation must give the same stats and the same bytes as the serial pass, whatever
+// the chunk boundaries (the last line has no '\n').
+int parallel_matches_serial() {
+    std::string dir = "/tmp/irr_report_parallel_test";
+    std::filesystem::create_directories(dir);
+    std::ofstream ev(dir + "/events.jsonl");
+    const char* types[] = {"probe.tcp.connect", "probe.dns.result", "probe.icmp.rtt",
+                           "net.route.change"};
+    for (int i = 0; i < 3000; ++i) {
+        if (i) ev << "\n";
+        ev << "{\"run_id\":\"r\",\"ts_monotonic_ns\":" << i * 1000000000ULL << ",\"type\":\""
+           << types[i % 4] << "\",\"target\":{\"name\":\"t" << (i * 7) % 13
+           << "\"},\"result\":{\"ok\":" << (i % 11 ? "true" : "false")
+           << ",\"metric_ms\":" << (i * 37) % 1009 * 0.25 << "}}";
+    }
+    ev.close();
+    for (bool exact : {false, true}) {
+        irr::ReportStats serial;
+        irr::ReportOptions opts;
+        opts.exact = exact;
+        opts.threads = 1;
+        opts.checkpoint = false;
+        if (!irr::generate_report(dir, dir + "/serial.html", serial, opts)) return 10;
+        if (serial.total != 2250 || serial.metrics.is_exact() != exact) return 14;
+        std::string expected = read_file(dir + "/serial.html");
+        for (unsigned threads : {2u, 3u, 7u, 64u}) {
+            irr::ReportStats stats;
+            opts.threads = threads;
+            if (!irr::generate_report(dir, dir + "/parallel.html", stats, opts)) return 11;
+            if (stats.total != serial.total || stats.failures != serial.failures ||
+                stats.timeline != serial.timeline || stats.metrics != serial.metrics ||
+                stats.per_target != serial.per_target ||
+                stats.per_target_fail != serial.per_target_fail)
+                return 12;
+            if (read_file(dir + "/parallel.html") != expected) return 13;
+        }
+    }
+    return 0;
+}
+}  // namespace
+
 int main() {
+    if (int rc = parallel_matches_serial()) return rc;
     std::string dir = "/tmp/irr_report_test";
     std::filesystem::create_directories(dir);
     std::ofstream ev(dir + "/events.jsonl");
@@ -28,8 +77,7 @@ int main() {
     if (stats.total != 4) return 2;
     if (stats.failures != 1) return 3;
     if (stats.per_target["t1"].size() != 1) return 4;
-    std::ifstream html(dir + "/report.html");
-    std::string contents((std::istreambuf_iterator<char>(html)), std::istreambuf_iterator<char>());
+    std::string contents = read_file(dir + "/report.html");
     if (contents.find("<script") != std::string::npos) return 5;
     if (contents.find("&lt;img src=x onerror=alert(1)&gt;") == std::string::npos) return 6;
     return 0;
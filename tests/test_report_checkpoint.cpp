@@ -0,0 +1,191 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "../src/core/store_columnar.hpp"
+#include "../src/report/checkpoint.hpp"
+#include "../src/report/report_gen.hpp"
+
+namespace {
+const std::string kDir = "/tmp/irr_report_checkpoint_test";
+
+std::string read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+void write_file(const std::string& path, const std::string& data) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << data;
+}
+
+// One event line; every field has a fixed width so lines can be edited in place.
+std::string line(int i) {
+    char buf[256];
+    std::snprintf(buf, sizeof(buf),
+                  "{\"run_id\":\"r\",\"ts_monotonic_ns\":%12llu,\"type\":\"probe.tcp.connect\","
+                  "\"target\":{\"name\":\"t%d\"},\"result\":{\"ok\":%s,\"metric_ms\":%7.2f}}\n",
+                  static_cast<unsigned long long>(i) * 1000000000ULL, i % 5,
+                  i % 9 ? "true " : "false", (i * 37) % 1009 * 0.25);
+    return buf;
+}
+
+std::string lines(int from, int to) {
+    std::string out;
+    for (int i = from; i < to; ++i) out += line(i);
+    return out;
+}
+
+// The report for the current events.jsonl, with or without the checkpoint.
+std::string report(bool checkpoint, irr::ReportStats& stats, bool exact = false) {
+    irr::ReportOptions opts;
+    opts.checkpoint = checkpoint;
+    opts.exact = exact;
+    std::string out = kDir + (checkpoint ? "/incremental.html" : "/full.html");
+    if (!irr::generate_report(kDir, out, stats, opts)) return "";
+    return read_file(out);
+}
+
+bool same_as_full_scan(bool exact = false) {
+    irr::ReportStats inc, full;
+    std::string a = report(true, inc, exact);
+    std::string b = report(false, full, exact);
+    return !a.empty() && a == b && inc.total == full.total && inc.metrics == full.metrics &&
+           inc.per_target == full.per_target && inc.timeline == full.timeline;
+}
+
+uint64_t checkpoint_offset(const std::string& dir = kDir) {
+    irr::ReportCheckpoint ck;
+    if (!irr::load_checkpoint(dir + "/" + irr::kCheckpointFile, irr::ReportOptions{}, ck))
+        return 0;
+    return ck.offset;
+}
+
+// A --columnar bundle: events.irrc holds only the sealed segments, events.jsonl everything.
+int columnar_bundle() {
+    const std::string dir = kDir + "_columnar";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    std::string data = lines(0, 300);
+    write_file(dir + "/events.jsonl", data);
+    {
+        irr::ColumnarStore store(dir + "/events.irrc", 64);
+        auto& syms = irr::symbols();
+        for (int i = 0; i < 256; ++i) {
+            irr::Event ev;
+            ev.ts_monotonic_ns = static_cast<uint64_t>(i) * 1000000000ULL;
+            ev.type = irr::EventType::TcpConnect;
+            ev.target_name = syms.intern("t" + std::to_string(i % 5));
+            ev.ok = true;
+            ev.metric_ms = 1.0;
+            store.on_event(ev);
+        }
+    }
+    // Both runs go through the checkpoint and see the events not yet sealed into events.irrc.
+    irr::ReportOptions opts;
+    irr::ReportStats first, second;
+    if (!irr::generate_report(dir, dir + "/a.html", first, opts)) return 30;
+    if (first.total != 300 || checkpoint_offset(dir) != data.size()) return 31;
+    if (!irr::generate_report(dir, dir + "/b.html", second, opts)) return 32;
+    if (second.total != 300 || second.metrics != first.metrics ||
+        read_file(dir + "/a.html") != read_file(dir + "/b.html"))
+        return 33;
+    // Without the checkpoint the columnar store is read instead.
+    opts.checkpoint = false;
+    irr::ReportStats columnar;
+    if (!irr::generate_report(dir, dir + "/c.html", columnar, opts)) return 34;
+    if (columnar.total != 256) return 35;
+    return 0;
+}
+}  // namespace
+
+int main() {
+    std::filesystem::remove_all(kDir);
+    std::filesystem::create_directories(kDir);
+    const std::string events = kDir + "/events.jsonl";
+    const std::string ckpt = kDir + "/" + irr::kCheckpointFile;
+
+    // The first run is a full scan that leaves a checkpoint behind.
+    std::string data = lines(0, 400);
+    write_file(events, data);
+    if (!same_as_full_scan()) return 1;
+    if (checkpoint_offset() != data.size()) return 2;
+
+    // Appended lines, the last one still being written, are added to the checkpointed state.
+    std::string torn = line(450);
+    data += lines(400, 450) + torn.substr(0, 40);
+    {
+        std::ofstream out(events, std::ios::binary | std::ios::app);
+        out << lines(400, 450) << torn.substr(0, 40);
+    }
+    if (!same_as_full_scan()) return 3;
+    if (checkpoint_offset() != data.size() - 40) return 4;
+
+    // Only the tail is parsed: an in-place edit between the hashed head and tail goes unseen.
+    const std::string key = "\"ok\":true ,\"metric_ms\":";
+    size_t mid = data.find(key, data.size() / 2) + key.size();
+    {
+        std::fstream out(events, std::ios::binary | std::ios::in | std::ios::out);
+        out.seekp(static_cast<std::streamoff>(mid));
+        out << "9999.99";
+    }
+    irr::ReportStats inc, full;
+    report(true, inc);
+    report(false, full);
+    if (inc.metrics.max() == full.metrics.max() || full.metrics.max() != 9999.99) return 5;
+    write_file(events, data);  // same inode, original bytes again
+    if (!same_as_full_scan()) return 6;
+
+    // Completing the torn line.
+    {
+        std::ofstream out(events, std::ios::binary | std::ios::app);
+        out << torn.substr(40) << lines(451, 500);
+    }
+    data += torn.substr(40) + lines(451, 500);
+    if (!same_as_full_scan()) return 7;
+    if (checkpoint_offset() != data.size()) return 8;
+
+    // Truncation and rewrites near the checkpoint force a full rescan.
+    write_file(events, lines(0, 100));
+    if (!same_as_full_scan()) return 9;
+    write_file(events, lines(0, 99) + line(999));
+    if (!same_as_full_scan()) return 10;
+
+    // Rotation: a new file under the same name.
+    write_file(events + ".new", lines(0, 100) + lines(200, 300));
+    std::filesystem::rename(events + ".new", events);
+    if (!same_as_full_scan()) return 11;
+
+    // A checkpoint built with other sketch options is not reused.
+    if (!same_as_full_scan(true)) return 12;
+    if (!same_as_full_scan(false)) return 13;
+
+    // A corrupt checkpoint is ignored and replaced.
+    std::string state = read_file(ckpt);
+    state[state.size() / 2] ^= 0x5a;
+    write_file(ckpt, state);
+    irr::ReportCheckpoint ck;
+    if (irr::load_checkpoint(ckpt, irr::ReportOptions{}, ck)) return 14;
+    if (!same_as_full_scan()) return 15;
+    if (!irr::load_checkpoint(ckpt, irr::ReportOptions{}, ck)) return 16;
+    write_file(ckpt, state.substr(0, 20));
+    if (!same_as_full_scan()) return 17;
+
+    // Options are compared as the sketch applies them, so errors that clamp alike match.
+    irr::ReportOptions tight;
+    tight.relative_error = 1e-6;
+    irr::ReportStats clamped;
+    if (!irr::generate_report(kDir, kDir + "/tight.html", clamped, tight)) return 19;
+    tight.relative_error = 2e-6;
+    if (!irr::load_checkpoint(ckpt, tight, ck)) return 20;
+    if (irr::load_checkpoint(ckpt, irr::ReportOptions{}, ck)) return 21;
+
+    // With --no-checkpoint nothing is written.
+    std::filesystem::remove(ckpt);
+    irr::ReportStats stats;
+    report(false, stats);
+    if (std::filesystem::exists(ckpt)) return 18;
+    return columnar_bundle();
+}
@@ -0,0 +1,40 @@
+#include <netinet/in.h>
+
+#include <string>
+
+#include "../src/core/event_bus.hpp"
+#include "../src/core/reactor.hpp"
+#include "../src/probes/resolver_cache.hpp"
+#include "test_support.hpp"
+
+int main() {
+    irr::EventBus bus;
+    irr::test::Collect sink;
+    bus.add_sink(&sink);
+    irr::Reactor reactor;
+    irr::ResolverCache cache(bus, "test", 50, 50);
+
+    // Literals resolve in add() without an event; repeated hosts share an entry.
+    auto lit = cache.add("127.0.0.1", 443);
+    if (cache.state(lit) != irr::ResolverCache::State::Ok || cache.addrs(lit).size() != 1)
+        return 1;
+    auto host = cache.add("localhost", 80);
+    if (cache.add("localhost", 80) != host || cache.add("localhost", 81) == host) return 2;
+    if (cache.state(host) != irr::ResolverCache::State::Pending) return 3;
+
+    // Names resolve off the reactor thread and are refreshed after the TTL.
+    if (!cache.start(reactor)) return 4;
+    irr::test::run_until(reactor, sink, 4);
+    cache.stop();
+
+    if (cache.state(host) != irr::ResolverCache::State::Ok || cache.addrs(host).empty()) return 5;
+    const auto& a = cache.addrs(host).front();
+    if (a.len == 0 || irr::symbols().name(a.ip).empty()) return 6;
+    // First lookups of localhost:80 and localhost:81, then at least one refresh.
+    if (sink.events.size() < 3) return 7;
+    for (const auto& ev : sink.events) {
+        if (ev.type != irr::EventType::ResolveResult || !ev.ok) return 8;
+        if (irr::symbols().name(ev.target_name) != "localhost") return 9;
+    }
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../src/core/scheduler_timerfd.hpp"
+
+namespace {
+constexpr uint64_t kMs = 1000000ULL;
+constexpr uint64_t kOrigin = 1000 * kMs;
+}  // namespace
+
+int main() {
+    {
+        // 1000 jobs on the same interval are spread across it, not bunched at the start.
+        irr::PeriodicScheduler s(kOrigin);
+        std::vector<int> runs(1000, 0);
+        for (size_t i = 0; i < runs.size(); ++i)
+            s.add("tcp/target-" + std::to_string(i), 1000, [&runs, i]() { ++runs[i]; });
+        int buckets[10] = {};
+        for (uint64_t t = 0; t < 1000; ++t) buckets[t / 100] += s.run_due(kOrigin + t * kMs);
+        for (int b : buckets)
+            if (b < 50 || b > 150) return 1;
+        for (int r : runs)
+            if (r != 1) return 2;
+        // Second period: every job runs exactly once more, on the same phase.
+        for (uint64_t t = 1000; t < 2000; ++t) s.run_due(kOrigin + t * kMs);
+        for (int r : runs)
+            if (r != 2) return 3;
+    }
+    {
+        // Phases depend only on the key, so the schedule repeats across runs.
+        irr::PeriodicScheduler a(kOrigin), b(kOrigin);
+        int fired_b = 0;
+        a.add("dns/root", 5000, nullptr);
+        b.add("icmp/other", 5000, nullptr);
+        b.add("dns/root", 5000, [&]() { ++fired_b; });
+        uint64_t due = a.next_due_ns();
+        if (due < kOrigin || due >= kOrigin + 5000 * kMs) return 4;
+        b.run_due(due - 1);
+        if (fired_b != 0) return 5;
+        b.run_due(due);
+        if (fired_b != 1) return 5;
+    }
+    {
+        // A late run records lag and skipped periods and stays on its grid afterwards.
+        irr::PeriodicScheduler s(kOrigin);
+        int runs = 0;
+        irr::JobId id = s.add("job", 100, [&]() { ++runs; });
+        uint64_t due = s.next_due_ns();
+        s.run_due(due + 250 * kMs);
+        const auto& st = s.stats(id);
+        if (runs != 1 || st.missed != 2 || st.lag_max_ns != 250 * kMs) return 6;
+        if (s.next_due_ns() != due + 300 * kMs) return 7;
+        s.cancel(id);
+        s.run_due(due + 1000 * kMs);
+        if (runs != 1) return 8;
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/core/event_ring.hpp"
+#include "../src/core/sink_worker.hpp"
+#include "../src/probes/probe_shard.hpp"
+#include "test_support.hpp"
+
+namespace {
+irr::ShardTargets all_targets() {
+    irr::ShardTargets all;
+    for (int i = 0; i < 7; ++i)
+        all.tcp.push_back({"tcp" + std::to_string(i), "127.0.0.1", 80, 1000, 500});
+    for (int i = 0; i < 5; ++i) all.dns.push_back({"dns" + std::to_string(i), "a.test", 1000, 500});
+    for (int i = 0; i < 3; ++i) all.icmp.push_back({"icmp" + std::to_string(i), "::1", 1000, 500});
+    for (int i = 0; i < 2; ++i) all.pmtu.push_back({"pmtu" + std::to_string(i), "127.0.0.1", 9});
+    all.netlink = true;
+    return all;
+}
+
+template <typename T>
+void tally(const std::vector<T>& targets, std::map<std::string, int>& seen) {
+    for (const auto& t : targets) ++seen[t.name];
+}
+
+// Every target lands on exactly one shard, the per-kind counts differ by at most one between
+// shards, and the host-wide monitors stay on shard 0.
+int partition(size_t shards) {
+    irr::ShardTargets all = all_targets();
+    std::vector<irr::ShardTargets> parts = irr::partition_targets(all, shards);
+    if (parts.size() != (shards ? shards : 1)) return 1;
+    std::map<std::string, int> seen;
+    size_t min_tcp = SIZE_MAX, max_tcp = 0;
+    for (size_t s = 0; s < parts.size(); ++s) {
+        const irr::ShardTargets& p = parts[s];
+        tally(p.tcp, seen);
+        tally(p.dns, seen);
+        tally(p.icmp, seen);
+        tally(p.pmtu, seen);
+        min_tcp = std::min(min_tcp, p.tcp.size());
+        max_tcp = std::max(max_tcp, p.tcp.size());
+        if (s > 0 && (!p.pmtu.empty() || p.netlink)) return 2;
+    }
+    if (!parts[0].netlink || parts[0].pmtu.size() != all.pmtu.size()) return 3;
+    if (seen.size() != all.tcp.size() + all.dns.size() + all.icmp.size() + all.pmtu.size())
+        return 4;
+    for (const auto& kv : seen)
+        if (kv.second != 1) return 5;
+    if (max_tcp - min_tcp > 1) return 6;
+    return 0;
+}
+
+// Events pushed concurrently into N rings all reach every sink, in per-ring order.
+int fan_in(size_t rings_n) {
+    const uint64_t per_ring = 5000;
+    std::vector<std::unique_ptr<irr::EventRing>> rings;
+    std::vector<irr::EventRing*> ring_ptrs;
+    for (size_t r = 0; r < rings_n; ++r) {
+        rings.push_back(std::make_unique<irr::EventRing>(64));
+        ring_ptrs.push_back(rings.back().get());
+    }
+    irr::test::Collect a, b;
+    irr::SinkWorker worker(ring_ptrs, {&a, &b});
+    if (!worker.start()) return 10;
+    std::vector<std::thread> producers;
+    for (size_t r = 0; r < rings_n; ++r) {
+        producers.emplace_back([&rings, r, per_ring]() {
+            for (uint64_t i = 0; i < per_ring; ++i) {
+                irr::Event ev;
+                ev.ts_monotonic_ns = (static_cast<uint64_t>(r) << 32) | i;
+                rings[r]->push(ev);
+            }
+        });
+    }
+    for (auto& p : producers) p.join();
+    worker.stop();
+    for (const irr::test::Collect* sink : {&a, &b}) {
+        if (sink->events.size() != rings_n * per_ring) return 11;
+        std::vector<uint64_t> next(rings_n, 0);
+        for (const auto& ev : sink->events) {
+            size_t r = static_cast<size_t>(ev.ts_monotonic_ns >> 32);
+            if (r >= rings_n || (ev.ts_monotonic_ns & 0xffffffffULL) != next[r]++) return 12;
+        }
+    }
+    for (const auto& ring : rings)
+        if (ring->stats().dropped != 0 || !ring->empty()) return 13;
+    return 0;
+}
+}  // namespace
+
+int main() {
+    for (size_t shards : {0, 1, 2, 3, 4, 8, 20})
+        if (int rc = partition(shards)) return rc;
+    for (size_t rings : {1, 3, 4})
+        if (int rc = fan_in(rings)) return rc;
+    return 0;
+}
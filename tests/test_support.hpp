@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+#include "../src/core/event_bus.hpp"
+#include "../src/core/reactor.hpp"
+
+namespace irr::test {
+// Keeps every event it is handed, in delivery order.
+struct Collect : EventSink {
+    std::vector<Event> events;
+    void on_event(const Event& ev) override {
+        events.push_back(ev);
+    }
+};
+
+// Polls the reactor in 10 ms steps until sink holds `want` events or `steps` polls have run.
+inline void run_until(Reactor& reactor, const Collect& sink, size_t want, int steps = 300) {
+    for (int i = 0; i < steps && sink.events.size() < want; ++i) reactor.loop_once(10);
+}
+}  // namespace irr::test
@@ -0,0 +1,94 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+#include "../src/core/event_bus.hpp"
+#include "../src/core/reactor.hpp"
+#include "../src/probes/resolver_cache.hpp"
+#include "../src/probes/tcp_connect.hpp"
+#include "test_support.hpp"
+
+namespace {
+// Listens on 127.0.0.1 with an ephemeral port; 127.0.0.2 on the same port stays closed.
+int listen_loopback(int& port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in sa{};
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(sa);
+    if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&sa), len) < 0 || ::listen(fd, 8) < 0 ||
+        ::getsockname(fd, reinterpret_cast<sockaddr*>(&sa), &len) < 0)
+        return -1;
+    port = ntohs(sa.sin_port);
+    return fd;
+}
+
+size_t count(const irr::test::Collect& sink, size_t from, irr::EventType type) {
+    size_t n = 0;
+    for (size_t i = from; i < sink.events.size(); ++i) n += sink.events[i].type == type;
+    return n;
+}
+}  // namespace
+
+int main() {
+    int port = 0;
+    int listener = listen_loopback(port);
+    if (listener < 0) return 1;
+
+    irr::EventBus bus;
+    irr::test::Collect sink;
+    bus.add_sink(&sink);
+    irr::Reactor reactor;
+    irr::ResolverCache resolver(bus, "test");
+    irr::TcpConnectProbe probe(bus, "test");
+    irr::TcpTarget target{"he", "he.test", port, 1000, 1000, true};
+    resolver.pin("he.test", port, {"127.0.0.2", "127.0.0.1"});
+    probe.start(reactor, resolver, {target});
+    resolver.start(reactor);
+    const irr::SymbolId open_ip = irr::symbols().intern("127.0.0.1");
+    const irr::SymbolId closed_ip = irr::symbols().intern("127.0.0.2");
+
+    // One address answers: one connect event per address and a single successful
+    // first_success for the listening one, even once the closed address has reported.
+    probe.fire(0);
+    irr::test::run_until(reactor, sink, 3);
+    for (int i = 0; i < 10; ++i) reactor.loop_once(10);
+    if (sink.events.size() != 3) return 2;
+    if (count(sink, 0, irr::EventType::TcpConnect) != 2 ||
+        count(sink, 0, irr::EventType::TcpFirstSuccess) != 1)
+        return 3;
+    for (const auto& ev : sink.events) {
+        if (ev.type == irr::EventType::TcpFirstSuccess && (!ev.ok || ev.target_ip != open_ip))
+            return 4;
+        if (ev.type == irr::EventType::TcpConnect && ev.ok != (ev.target_ip == open_ip))
+            return 5;
+        if (ev.type == irr::EventType::TcpConnect && ev.target_ip != open_ip &&
+            ev.target_ip != closed_ip)
+            return 6;
+    }
+
+    // Every address refused: the round ends with one failed first_success that carries the
+    // error of the address that failed last.
+    ::close(listener);
+    size_t before = sink.events.size();
+    probe.fire(0);
+    irr::test::run_until(reactor, sink, before + 3);
+    for (int i = 0; i < 10; ++i) reactor.loop_once(10);
+    if (sink.events.size() != before + 3) return 7;
+    if (count(sink, before, irr::EventType::TcpConnect) != 2 ||
+        count(sink, before, irr::EventType::TcpFirstSuccess) != 1)
+        return 8;
+    const irr::Event& last = sink.events[before + 1];
+    const irr::Event& round = sink.events[before + 2];
+    if (round.type != irr::EventType::TcpFirstSuccess || round.ok) return 9;
+    if (last.type != irr::EventType::TcpConnect || last.ok || round.error != last.error ||
+        round.error_detail != last.error_detail || round.error_detail != ECONNREFUSED)
+        return 10;
+
+    probe.stop();
+    resolver.stop();
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../src/report/timeline.hpp"
+
+namespace {
+struct Sample {
+    const char* series;
+    uint64_t ts;
+    bool ok;
+    double ms;
+};
+
+// Ten days at 1 Hz for two targets, with one 900 ms spike and a few failures.
+std::vector<Sample> ten_days() {
+    std::vector<Sample> out;
+    const uint64_t kSec = 1000000000ULL;
+    for (uint64_t t = 0; t < 10 * 86400; ++t) {
+        uint64_t ts = 5 * kSec + t * kSec;
+        out.push_back({"alpha", ts, t % 10007 != 0, 20.0 + static_cast<double>(t % 7)});
+        out.push_back({"beta", ts + kSec / 2, true, t == 400000 ? 900.0 : 40.0});
+    }
+    return out;
+}
+
+uint64_t total(const irr::Timeline& tl, const char* name, bool failures) {
+    uint64_t n = 0;
+    for (const auto& b : *tl.series(name)) n += failures ? b.failures : b.ok;
+    return n;
+}
+}  // namespace
+
+int main() {
+    auto samples = ten_days();
+    irr::Timeline whole;
+    for (const auto& s : samples) whole.add(s.series, s.ts, s.ok, s.ms);
+
+    // O(width) memory: 600 buckets per series, each the smallest power-of-two multiple of
+    // 1 ms that fits the range, and nothing is lost in the counts.
+    if (whole.series_count() != 2 || whole.series("alpha")->size() != 600) return 1;
+    uint64_t range = samples.back().ts - samples.front().ts;
+    if (whole.bucket_ns() * 600 < range || whole.bucket_ns() * 300 >= range) return 2;
+    if (total(whole, "alpha", false) != 864000 - 87 || total(whole, "alpha", true) != 87) return 3;
+    if (total(whole, "beta", false) != 864000) return 4;
+
+    // The spike survives as its bucket's max; the mean and min do not hide it.
+    double peak = 0, floor = 1e9;
+    for (const auto& b : *whole.series("beta")) {
+        if (!b.ok) continue;
+        peak = std::max(peak, b.max);
+        floor = std::min(floor, b.min);
+    }
+    if (peak != 900.0 || floor != 40.0) return 5;
+
+    // Chunked (as the parallel report does), reversed and interleaved inputs all give the
+    // identical timeline.
+    irr::Timeline merged;
+    size_t chunk = samples.size() / 7 + 1;
+    for (size_t at = 0; at < samples.size(); at += chunk) {
+        irr::Timeline part;
+        for (size_t i = at; i < std::min(samples.size(), at + chunk); ++i)
+            part.add(samples[i].series, samples[i].ts, samples[i].ok, samples[i].ms);
+        merged.merge(part);
+    }
+    if (merged != whole) return 6;
+    irr::Timeline reversed;
+    for (size_t i = samples.size(); i-- > 0;)
+        reversed.add(samples[i].series, samples[i].ts, samples[i].ok, samples[i].ms);
+    if (reversed != whole) return 7;
+    irr::Timeline odd, even;
+    for (size_t i = 0; i < samples.size(); ++i)
+        (i % 2 ? odd : even).add(samples[i].series, samples[i].ts, samples[i].ok, samples[i].ms);
+    even.merge(odd);
+    if (even != whole) return 8;
+
+    // The chart stays small: two series at 600 buckets, not 1.7M points.
+    std::string svg;
+    whole.render_svg(svg, 600, 160);
+    if (svg.size() > 64 * 1024 || svg.compare(0, 4, "<svg") != 0) return 9;
+    if (std::count(svg.begin(), svg.end(), 'Z') != 2) return 10;  // one band run per series
+    std::vector<std::string> names;
+    whole.for_each_series([&](const std::string& name, const char*) { names.push_back(name); });
+    if (names != std::vector<std::string>{"alpha", "beta"}) return 11;
+
+    // A single sample still draws a point.
+    irr::Timeline one;
+    one.add("x", 123, true, 5);
+    svg.clear();
+    one.render_svg(svg, 600, 160);
+    if (svg.find("M300,0") == std::string::npos) return 12;
+    return 0;
+}
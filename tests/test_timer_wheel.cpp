@@ -0,0 +1,84 @@
+#include <cstdint>
+#include <vector>
+
+#include "../src/core/timer_wheel.hpp"
+
+namespace {
+constexpr uint64_t kMs = 1000000ULL;
+}
+
+int main() {
+    {
+        // Fires on the first advance at or past its deadline, never before.
+        irr::TimerWheel w(0);
+        int fired = 0;
+        w.arm(5 * kMs, [&]() { ++fired; });
+        if (w.next_deadline_ns() != 5 * kMs) return 1;
+        w.advance(4 * kMs);
+        if (fired != 0) return 2;
+        w.advance(5 * kMs);
+        if (fired != 1 || w.size() != 0) return 3;
+        if (w.next_deadline_ns() != UINT64_MAX) return 4;
+    }
+    {
+        // Cancel before expiry; stale ids are rejected.
+        irr::TimerWheel w(0);
+        int fired = 0;
+        auto id = w.arm(10 * kMs, [&]() { ++fired; });
+        if (!w.cancel(id)) return 5;
+        if (w.cancel(id)) return 6;
+        auto id2 = w.arm(10 * kMs, [&]() { ++fired; });
+        if (w.cancel(id)) return 7;  // slot reused, generation differs
+        w.advance(20 * kMs);
+        if (fired != 1 || w.cancel(id2)) return 8;
+    }
+    {
+        // Long timers cascade down through the levels and fire on the right tick.
+        irr::TimerWheel w(3 * kMs);
+        std::vector<uint64_t> deadlines = {70, 4095, 4096, 5000, 300000, 20000000};
+        std::vector<uint64_t> fired_at;
+        for (uint64_t d : deadlines) w.arm(d * kMs, [&, d]() { fired_at.push_back(d); });
+        uint64_t now = 3;
+        size_t total = 0;
+        while (w.size() > 0 && now < 30000000) {
+            uint64_t next = w.next_deadline_ns();
+            if (next < now * kMs) return 9;
+            now = next / kMs;
+            w.advance(now * kMs);
+            for (uint64_t d : fired_at)
+                if (d != now) return 10;
+            total += fired_at.size();
+            fired_at.clear();
+        }
+        if (w.size() != 0 || total != deadlines.size()) return 11;
+    }
+    {
+        // Callbacks may arm new timers and cancel ones due in the same tick.
+        irr::TimerWheel w(0);
+        int first = 0, rearmed = 0;
+        irr::TimerId ida = 0, idb = 0;
+        ida = w.arm(1 * kMs, [&]() {
+            ++first;
+            w.cancel(idb);
+            w.arm(2 * kMs, [&]() { ++rearmed; });
+        });
+        idb = w.arm(1 * kMs, [&]() {
+            ++first;
+            w.cancel(ida);
+            w.arm(2 * kMs, [&]() { ++rearmed; });
+        });
+        w.advance(1 * kMs);
+        if (first != 1 || w.size() != 1) return 12;
+        w.advance(2 * kMs);
+        if (rearmed != 1 || w.size() != 0) return 13;
+    }
+    {
+        // Deadlines already in the past fire on the next advance.
+        irr::TimerWheel w(100 * kMs);
+        int fired = 0;
+        w.arm(50 * kMs, [&]() { ++fired; });
+        w.advance(100 * kMs);
+        if (fired != 1) return 14;
+    }
+    return 0;
+}